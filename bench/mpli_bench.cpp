@@ -0,0 +1,755 @@
+/*
+ * Benchmarks of the interpreter pipeline: scanner, parser, AST builder,
+ * loading of cached ASTs and interpreter are timed separately on generated
+ * Mini-PL programs. Some workloads are also lowered to IR at -O2 and run on
+ * the IR backend, whose output must match the interpreter's. The int_conv
+ * workload times the int conversions of int_conv.hpp against libc.
+ *
+ *   mpli_bench [--json] [--scale=N] [--reps=N] [--warmup=N] [--filter=NAME]
+ *              [--int-only] [--check-allocations]
+ *
+ * Every workload grows linearly with --scale. Times and allocations are
+ * per repetition, after warmup repetitions that are not counted. With
+ * --check-allocations the run fails if any statement other than a
+ * declaration allocates in one more run of a workload. Variables and
+ * buffers keep their capacity between runs, so in this steady state no
+ * stored value grows and string statements must not allocate either.
+ */
+#include "scanner.hpp"
+#include "parser.hpp"
+#include "ast.hpp"
+#include "interpreter.hpp"
+#include "ir_builder.hpp"
+#include "ir_passes.hpp"
+#include "stats.hpp"
+#include "int_conv.hpp"
+#include "program_generator.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+using namespace mpli;
+
+struct Workload {
+	const char *name;
+	/* Mini-PL source and the input it reads */
+	std::string source;
+	std::string input;
+	/* output the program must print, empty if not known */
+	std::string expect;
+	/* only int and bool code, execution must not allocate */
+	int int_only;
+	/* also lowered to IR and run on the IR backend */
+	int ir;
+};
+
+struct Result {
+	std::string workload;
+	std::string phase;
+	/* microseconds of every repetition, sorted */
+	std::vector<double> times;
+	/* size of the work: tokens, nodes or statements */
+	unsigned long long items;
+	/* heap allocations of all measured repetitions */
+	unsigned long long allocations;
+};
+
+/* n times scale, at least 1 */
+static int scaled(int n, double scale)
+{
+	int r = (int)(n * scale);
+	return r > 0 ? r : 1;
+}
+
+static std::string number(long long n)
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%lld", n);
+	return buf;
+}
+
+/* statements with expressions nested depth deep */
+static Workload deep_expressions(double scale)
+{
+	Workload w;
+	w.name = "deep_expr";
+	w.int_only = 1;
+	w.ir = 0;
+	const int depth = 48;
+	w.source = "var x : int := 1;\nvar y : int := 2;\n";
+	for (int s=0; s < scaled(100, scale); ++s) {
+		std::string expr = "x";
+		for (int d=0; d < depth; d += 2) {
+			/* values stay small, one level multiplies and divides */
+			if (d % 6 == 4) {
+				expr = "((" + expr + " * y) / y)";
+			} else {
+				expr = "((" + expr + " + " + number(d % 7 + 1) + ") - y)";
+			}
+		}
+		w.source += "x := " + expr + ";\n";
+	}
+	w.source += "print x;\n";
+	return w;
+}
+
+/* a few statements with expressions nested 20000 levels deep, which are
+ * parsed, built and evaluated without recursion */
+static Workload nested_expressions(double scale)
+{
+	Workload w;
+	w.name = "nested_expr";
+	w.int_only = 1;
+	w.ir = 0;
+	const int depth = scaled(20000, scale);
+	const char *ops[] = { ") + 3", ") - y", ") * y", ") / y" };
+	w.source = "var x : int := 1;\nvar y : int := 2;\nvar b : bool;\n";
+	/* left-deep: ((((x + 1) + 3) - y) * y) ... */
+	w.source += "x := " + std::string(depth - 1, '(') + "x + 1";
+	for (int d=1; d < depth; ++d) {
+		w.source += ops[d % 4];
+	}
+	w.source += ";\n";
+	/* right-deep: (1 < y) & ((x < y) & (... & (1 < y))) */
+	w.source += "b := ";
+	for (int d=1; d < depth; ++d) {
+		w.source += d % 2 ? "(1 < y) & (" : "(x < y) & (";
+	}
+	w.source += "1 < y" + std::string(depth - 1, ')') + ";\n";
+	w.source += "print " + std::string(depth - 1, '(') + "x";
+	for (int d=1; d < depth; ++d) {
+		w.source += ") - 1";
+	}
+	w.source += ";\n";
+	return w;
+}
+
+/* long list of assignments without control flow */
+static Workload straight_line(double scale)
+{
+	Workload w;
+	w.name = "straight_line";
+	w.int_only = 1;
+	w.ir = 1;
+	const int vars = 16;
+	for (int v=0; v < vars; ++v) {
+		w.source += "var v" + number(v) + " : int := " + number(v) + ";\n";
+	}
+	for (int s=0; s < scaled(5000, scale); ++s) {
+		int a = s % vars;
+		int b = (s * 7 + 3) % vars;
+		w.source += "v" + number(a) + " := (v" + number(b) + " + " + number(s % 100) + ") / 2;\n";
+	}
+	w.source += "print v0;\n";
+	return w;
+}
+
+/* three nested loops with integer and boolean work in the innermost one */
+static Workload nested_loops(double scale)
+{
+	Workload w;
+	w.name = "nested_loops";
+	w.int_only = 1;
+	w.ir = 1;
+	w.source =
+		"var i : int;\nvar j : int;\nvar k : int;\n"
+		"var s : int := 0;\nvar b : bool;\n"
+		"for i in 1.." + number(scaled(10, scale)) + " do\n"
+		"  for j in 1..100 do\n"
+		"    for k in 1..100 do\n"
+		"      s := (s + (i * j)) - k;\n"
+		"      b := s < k;\n"
+		"    end for;\n"
+		"  end for;\n"
+		"end for;\n"
+		"print s;\n";
+	return w;
+}
+
+/* strings built by concatenation in a loop */
+static Workload string_building(double scale)
+{
+	Workload w;
+	w.name = "string_build";
+	w.int_only = 0;
+	w.ir = 1;
+	w.source =
+		"var i : int;\nvar s : string := \"\";\nvar t : string;\n"
+		"for i in 1.." + number(scaled(2000, scale)) + " do\n"
+		"  t := \"ab\" + \"cd\";\n"
+		"  s := s + t;\n"
+		"end for;\n"
+		"print s;\n";
+	return w;
+}
+
+/* concatenation, comparison, copies and printing of strings longer than
+ * the small string buffer, whose values do not grow from one iteration to
+ * the next */
+static Workload string_operations(double scale)
+{
+	Workload w;
+	w.name = "string_ops";
+	w.int_only = 0;
+	w.ir = 1;
+	w.source =
+		"var i : int;\nvar s : string;\nvar t : string;\nvar u : string;\nvar b : bool;\n"
+		"for i in 1.." + number(scaled(2000, scale)) + " do\n"
+		"  t := \"abcdefghijklmnopqrstuvwxyz\" + i;\n"
+		"  u := t + \"0123456789\";\n"
+		"  b := t = u;\n"
+		"  b := !(u = (t + \"0123456789\"));\n"
+		"  s := u;\n"
+		"  print (s + \" \") + t; print \"\\n\";\n"
+		"end for;\n";
+	return w;
+}
+
+/* 10^5 distinct variables, each declared from one declared before it */
+static Workload many_variables(double scale)
+{
+	Workload w;
+	w.name = "many_vars";
+	w.int_only = 1;
+	w.ir = 0;
+	int n = scaled(100000, scale);
+	w.source = "var v0 : int := 1;\n";
+	for (int v=1; v < n; ++v) {
+		w.source += "var v" + number(v) + " : int := v" + number((v * 7919LL) % v) + ";\n";
+	}
+	w.source += "print v" + number(n - 1) + ";\n";
+	return w;
+}
+
+/* values read from input and printed back with text */
+static Workload print_read(double scale)
+{
+	Workload w;
+	w.name = "print_read";
+	w.int_only = 0;
+	w.ir = 0;
+	int n = scaled(2000, scale);
+	w.source =
+		"var i : int;\nvar x : int;\nvar s : string;\n"
+		"for i in 1.." + number(n) + " do\n"
+		"  read x;\n"
+		"  read s;\n"
+		"  print \"value \"; print x * 2; print \" \"; print s; print \"\\n\";\n"
+		"end for;\n";
+	for (int i=1; i <= n; ++i) {
+		w.input += number(i * 37 % 1000) + " word" + number(i % 10) + "\n";
+	}
+	return w;
+}
+
+/* program of mpli_gen with 5000 statements in loops nested two deep, which
+ * lowers to thousands of blocks */
+static Workload generated(double scale)
+{
+	Workload w;
+	w.name = "generated";
+	w.int_only = 0;
+	w.ir = 1;
+	mpli_gen::Options options;
+	options.statements = scaled(5000, scale);
+	options.bytes = 0;
+	options.depth = 2;
+	options.expr_depth = 3;
+	options.vars = 8;
+	options.string_percent = 30;
+	options.max_iterations = 3;
+	options.seed = 9;
+	char *source = NULL, *expect = NULL;
+	size_t source_size = 0, expect_size = 0;
+	FILE *out = open_memstream(&source, &source_size);
+	FILE *expect_out = open_memstream(&expect, &expect_size);
+	mpli_gen::Generator generator(options, out, expect_out);
+	generator.run();
+	fclose(out);
+	fclose(expect_out);
+	w.source.assign(source, source_size);
+	w.expect.assign(expect, expect_size);
+	free(source);
+	free(expect);
+	return w;
+}
+
+/* time and allocations of a measured region */
+class Span {
+private:
+	unsigned long long _allocations;
+	std::chrono::steady_clock::time_point _start;
+public:
+	Span() : _allocations(Stats::now().allocations), _start(std::chrono::steady_clock::now()) { }
+	/* returns microseconds since construction */
+	double stop(unsigned long long *allocations)
+	{
+		double us = std::chrono::duration<double, std::micro>(
+			std::chrono::steady_clock::now() - _start).count();
+		*allocations = Stats::now().allocations - _allocations;
+		return us;
+	}
+};
+
+/* Time phase of workload, each repetition is one call of run(), which
+ * returns the microseconds it measured and sets items and allocations. */
+template <typename F>
+static Result measure(const Workload &w, const char *phase, int warmup, int reps, F run)
+{
+	Result r;
+	r.workload = w.name;
+	r.phase = phase;
+	r.items = 0;
+	r.allocations = 0;
+	unsigned long long allocations;
+	for (int i=0; i < warmup; ++i) {
+		run(&r.items, &allocations);
+	}
+	for (int i=0; i < reps; ++i) {
+		r.times.push_back(run(&r.items, &allocations));
+		r.allocations += allocations;
+	}
+	std::sort(r.times.begin(), r.times.end());
+	return r;
+}
+
+/* nearest-rank percentile of sorted times */
+static double percentile(const std::vector<double> &times, double p)
+{
+	if (times.empty()) {
+		return 0;
+	}
+	size_t rank = (size_t)(p / 100.0 * times.size() + 0.999999);
+	if (rank < 1) {
+		rank = 1;
+	}
+	if (rank > times.size()) {
+		rank = times.size();
+	}
+	return times[rank - 1];
+}
+
+static double median(const std::vector<double> &times)
+{
+	size_t n = times.size();
+	if (n == 0) {
+		return 0;
+	}
+	return n % 2 ? times[n / 2] : (times[n / 2 - 1] + times[n / 2]) / 2;
+}
+
+static int parse(const Workload &w, Parser &parser, Scanner &scanner)
+{
+	scanner.open_input_string(w.source);
+	parser.set_scanner(&scanner);
+	parser.start();
+	if (parser.number_of_errors() > 0) {
+		fprintf(stderr, "%s: parse errors\n%s", w.name, parser.errors().c_str());
+		return 1;
+	}
+	return 0;
+}
+
+/* Execute once more with allocations counted per kind of statement.
+ * Returns 0 if only declarations allocated, their symbols are created
+ * anew by every run. Output goes into output, which keeps its capacity. */
+static int check_allocations(const Workload &w, Interpreter &interpreter, const AST &ast,
+	std::string &output)
+{
+	unsigned long long bytes[ASTNode::CONSTANT + 1], counts[ASTNode::CONSTANT + 1];
+	for (int type=0; type <= ASTNode::CONSTANT; ++type) {
+		Stats::tagged_allocations(1 + type, &bytes[type], &counts[type]);
+	}
+	output.clear();
+	interpreter.set_allocation_tags(1);
+	interpreter.set_input_data(w.input.data(), w.input.size());
+	interpreter.execute(&ast);
+	interpreter.set_allocation_tags(0);
+	int r = 0;
+	for (int type=0; type <= ASTNode::CONSTANT; ++type) {
+		unsigned long long b, n;
+		Stats::tagged_allocations(1 + type, &b, &n);
+		if (type != ASTNode::VAR_INIT && n > counts[type]) {
+			fprintf(stderr, "%s: %s statements allocated %llu times, %llu bytes\n", w.name,
+				type_name((ASTNode::TYPE)type), n - counts[type], b - bytes[type]);
+			r = 1;
+		}
+	}
+	return r;
+}
+
+/* Run all phases of workload into results, and check its allocations if
+ * asked to. Returns 0 on success. */
+static int bench(const Workload &w, int warmup, int reps, int check, std::vector<Result> &results)
+{
+	results.push_back(measure(w, "scan", warmup, reps, [&](unsigned long long *items, unsigned long long *allocations) {
+		Scanner scanner;
+		scanner.open_input_string(w.source);
+		Span span;
+		while (scanner.next_token().type != Token::END_OF_FILE) {
+		}
+		double us = span.stop(allocations);
+		*items = scanner.n_tokens();
+		return us;
+	}));
+
+	/* parsing pulls tokens from the scanner, so scanning is included */
+	results.push_back(measure(w, "parse", warmup, reps, [&](unsigned long long *items, unsigned long long *allocations) {
+		Scanner scanner;
+		Parser parser;
+		Span span;
+		parse(w, parser, scanner);
+		double us = span.stop(allocations);
+		*items = parser.number_of_nodes();
+		return us;
+	}));
+
+	/* every AST is built from the same parse tree, which is only read */
+	Scanner scanner;
+	Parser parser;
+	if (parse(w, parser, scanner) != 0) {
+		return 1;
+	}
+	results.push_back(measure(w, "ast", warmup, reps, [&](unsigned long long *items, unsigned long long *allocations) {
+		AST ast;
+		Span span;
+		parser.create_ast(&ast);
+		double us = span.stop(allocations);
+		*items = count_nodes(ast.root());
+		return us;
+	}));
+
+	AST ast;
+	parser.create_ast(&ast);
+	if (ast.number_of_errors() > 0) {
+		fprintf(stderr, "%s: semantic errors\n%s", w.name, ast.errors().c_str());
+		return 1;
+	}
+
+	/* the flat AST that the program cache stores instead of the source */
+	std::string image;
+	ast.serialize(image);
+	results.push_back(measure(w, "load", warmup, reps, [&](unsigned long long *items, unsigned long long *allocations) {
+		AST loaded;
+		Span span;
+		loaded.load(image.data(), image.size());
+		double us = span.stop(allocations);
+		*items = count_nodes(loaded.root());
+		return us;
+	}));
+
+	Interpreter interpreter;
+	std::string output;
+	interpreter.capture_output(&output);
+	int status = 0;
+	results.push_back(measure(w, "execute", warmup, reps, [&](unsigned long long *items, unsigned long long *allocations) {
+		output.clear();
+		interpreter.set_input_data(w.input.data(), w.input.size());
+		Span span;
+		status |= interpreter.execute(&ast);
+		double us = span.stop(allocations);
+		*items = interpreter.steps();
+		return us;
+	}));
+	if (status != 0) {
+		fprintf(stderr, "%s: execution failed\n%s", w.name, output.c_str());
+		return 1;
+	}
+	if (!w.expect.empty() && output != w.expect) {
+		fprintf(stderr, "%s: wrong output\n", w.name);
+		return 1;
+	}
+	if (w.ir) {
+		std::string interpreted = output;
+		IRFunction *fn = NULL;
+		std::string error;
+		results.push_back(measure(w, "lower", warmup, reps, [&](unsigned long long *items, unsigned long long *allocations) {
+			delete fn;
+			IRBuilder builder;
+			PassManager passes;
+			passes.add_level(PassManager::MAX_LEVEL);
+			Span span;
+			fn = builder.build(ast.root());
+			if (fn) {
+				passes.run(*fn);
+			}
+			double us = span.stop(allocations);
+			*items = fn ? fn->n_insns() : 0;
+			error = builder.error();
+			return us;
+		}));
+		if (!fn) {
+			/* left to the interpreter, like mpli -O does */
+			fprintf(stderr, "%s: not lowered, %s\n", w.name, error.c_str());
+		} else {
+			results.push_back(measure(w, "execute_ir", warmup, reps, [&](unsigned long long *items, unsigned long long *allocations) {
+				output.clear();
+				interpreter.set_input_data(w.input.data(), w.input.size());
+				Span span;
+				status |= interpreter.execute_ir(*fn);
+				double us = span.stop(allocations);
+				*items = fn->n_insns();
+				return us;
+			}));
+			delete fn;
+			if (status != 0 || output != interpreted) {
+				fprintf(stderr, "%s: IR output differs from the interpreter's\n", w.name);
+				return 1;
+			}
+		}
+	}
+	if (check) {
+		return check_allocations(w, interpreter, ast, output);
+	}
+	return 0;
+}
+
+/* Time the int conversions of int_conv.hpp, in format, append and parse
+ * rows, against snprintf and strtol in libc_* rows, on the same values of
+ * every length. Fails if they disagree, or with check if format, append or
+ * parse allocates. */
+static int bench_int_conv(double scale, int warmup, int reps, int check,
+	std::vector<Result> &results)
+{
+	Workload w;
+	w.name = "int_conv";
+	std::vector<int> values(scaled(100000, scale));
+	unsigned int x = 12345;
+	for (size_t i=0; i < values.size(); ++i) {
+		x = x * 1103515245 + 12345;
+		int shift = i % 31;
+		values[i] = i % 2 ? (int)(x >> shift) : -(int)(x >> (shift + 1));
+	}
+	/* text of the values separated by spaces, parsed by both */
+	std::string text;
+	std::vector<size_t> ends(values.size());
+	for (size_t i=0; i < values.size(); ++i) {
+		append_int(text, values[i]);
+		ends[i] = text.size();
+		text += ' ';
+	}
+	size_t first = results.size();
+
+	unsigned long long format_sum = 0, libc_format_sum = 0;
+	results.push_back(measure(w, "format", warmup, reps, [&](unsigned long long *items, unsigned long long *allocations) {
+		char buf[INT_CONV_MAX_CHARS];
+		unsigned long long sum = 0;
+		Span span;
+		for (size_t i=0; i < values.size(); ++i) {
+			char *end = format_int(values[i], buf);
+			sum += (end - buf) + (unsigned char)end[-1];
+		}
+		double us = span.stop(allocations);
+		format_sum = sum;
+		*items = values.size();
+		return us;
+	}));
+	results.push_back(measure(w, "libc_fmt", warmup, reps, [&](unsigned long long *items, unsigned long long *allocations) {
+		char buf[16];
+		unsigned long long sum = 0;
+		Span span;
+		for (size_t i=0; i < values.size(); ++i) {
+			int n = snprintf(buf, sizeof(buf), "%d", values[i]);
+			sum += n + (unsigned char)buf[n - 1];
+		}
+		double us = span.stop(allocations);
+		libc_format_sum = sum;
+		*items = values.size();
+		return us;
+	}));
+
+	/* appended into strings that keep their capacity, as the interpreter
+	 * does */
+	std::string appended, libc_appended;
+	appended.reserve(text.size());
+	libc_appended.reserve(text.size());
+	results.push_back(measure(w, "append", warmup, reps, [&](unsigned long long *items, unsigned long long *allocations) {
+		appended.clear();
+		Span span;
+		for (size_t i=0; i < values.size(); ++i) {
+			append_int(appended, values[i]);
+		}
+		double us = span.stop(allocations);
+		*items = values.size();
+		return us;
+	}));
+	results.push_back(measure(w, "libc_app", warmup, reps, [&](unsigned long long *items, unsigned long long *allocations) {
+		libc_appended.clear();
+		char buf[16];
+		Span span;
+		for (size_t i=0; i < values.size(); ++i) {
+			libc_appended.append(buf, snprintf(buf, sizeof(buf), "%d", values[i]));
+		}
+		double us = span.stop(allocations);
+		*items = values.size();
+		return us;
+	}));
+
+	unsigned long long parse_sum = 0, libc_parse_sum = 0;
+	results.push_back(measure(w, "parse", warmup, reps, [&](unsigned long long *items, unsigned long long *allocations) {
+		const char *p = text.data();
+		unsigned long long sum = 0;
+		Span span;
+		for (size_t i=0; i < ends.size(); ++i) {
+			int val = 0;
+			parse_int(p, text.data() + ends[i], &val);
+			sum += (unsigned int)val;
+			p = text.data() + ends[i] + 1;
+		}
+		double us = span.stop(allocations);
+		parse_sum = sum;
+		*items = values.size();
+		return us;
+	}));
+	results.push_back(measure(w, "libc_parse", warmup, reps, [&](unsigned long long *items, unsigned long long *allocations) {
+		const char *p = text.c_str();
+		unsigned long long sum = 0;
+		Span span;
+		for (size_t i=0; i < ends.size(); ++i) {
+			char *end;
+			sum += (unsigned int)(int)strtol(p, &end, 10);
+			p = end + 1;
+		}
+		double us = span.stop(allocations);
+		libc_parse_sum = sum;
+		*items = values.size();
+		return us;
+	}));
+
+	unsigned long long value_sum = 0;
+	for (size_t i=0; i < values.size(); ++i) {
+		value_sum += (unsigned int)values[i];
+	}
+	if (format_sum != libc_format_sum || appended != libc_appended ||
+		parse_sum != value_sum || libc_parse_sum != value_sum) {
+		fprintf(stderr, "int_conv: results differ from libc\n");
+		return 1;
+	}
+	int r = 0;
+	for (size_t i=first; check && i < results.size(); ++i) {
+		if (results[i].allocations > 0 && results[i].phase.compare(0, 5, "libc_") != 0) {
+			fprintf(stderr, "int_conv: %s allocated %llu times\n", results[i].phase.c_str(),
+				results[i].allocations);
+			r = 1;
+		}
+	}
+	return r;
+}
+
+static double allocations_per_rep(const Result &r)
+{
+	return r.times.empty() ? 0 : (double)r.allocations / r.times.size();
+}
+
+static void report_text(const std::vector<Result> &results)
+{
+	printf("%-14s %-10s %12s %12s %12s %12s %12s %12s %12s\n", "workload", "phase", "items",
+		"min us", "median us", "p90 us", "p99 us", "ns/item", "allocs/rep");
+	for (size_t i=0; i < results.size(); ++i) {
+		const Result &r = results[i];
+		double med = median(r.times);
+		printf("%-14s %-10s %12llu %12.1f %12.1f %12.1f %12.1f %12.2f %12.1f\n", r.workload.c_str(),
+			r.phase.c_str(), r.items, r.times.empty() ? 0 : r.times[0], med,
+			percentile(r.times, 90), percentile(r.times, 99),
+			r.items > 0 ? med * 1000 / r.items : 0, allocations_per_rep(r));
+	}
+}
+
+static void report_json(const std::vector<Result> &results, double scale, int warmup, int reps)
+{
+	printf("{\"schema\": \"mpli-bench\", \"version\": 1, \"scale\": %g, \"warmup\": %d, "
+		"\"reps\": %d,\n \"results\": [", scale, warmup, reps);
+	for (size_t i=0; i < results.size(); ++i) {
+		const Result &r = results[i];
+		printf("%s\n  {\"workload\": \"%s\", \"phase\": \"%s\", \"items\": %llu, "
+			"\"min_us\": %.3f, \"median_us\": %.3f, \"p90_us\": %.3f, \"p99_us\": %.3f, "
+			"\"max_us\": %.3f, \"allocations_per_rep\": %.1f}", i > 0 ? "," : "",
+			r.workload.c_str(), r.phase.c_str(), r.items, r.times.empty() ? 0 : r.times[0],
+			median(r.times), percentile(r.times, 90), percentile(r.times, 99),
+			r.times.empty() ? 0 : r.times.back(), allocations_per_rep(r));
+	}
+	printf("]}\n");
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [--json] [--scale=N] [--reps=N] [--warmup=N] [--filter=NAME]\n"
+		"       [--int-only] [--check-allocations]\n"
+		"  --json         print results as JSON, for comparing runs\n"
+		"  --scale=N      size of generated programs, 1 by default, e.g. 0.1\n"
+		"  --reps=N       measured repetitions of every phase, 21 by default\n"
+		"  --warmup=N     repetitions run before measuring, 3 by default\n"
+		"  --filter=NAME  run only workloads whose name contains NAME\n"
+		"  --int-only     run only workloads of int and bool code\n"
+		"  --check-allocations\n"
+		"                 fail if statements other than declarations allocate when\n"
+		"                 a workload is run again\n"
+		"Workloads: deep_expr, nested_expr, straight_line, nested_loops, string_build,\n"
+		"           string_ops, many_vars, print_read, generated, int_conv\n",
+		prog);
+}
+
+int main(int argc, char *argv[])
+{
+	int json = 0;
+	double scale = 1;
+	int reps = 21;
+	int warmup = 3;
+	const char *filter = NULL;
+	int int_only = 0;
+	int check = 0;
+	for (int i=1; i < argc; ++i) {
+		if (strcmp(argv[i], "--json") == 0) {
+			json = 1;
+		} else if (strncmp(argv[i], "--scale=", 8) == 0 && atof(argv[i] + 8) > 0) {
+			scale = atof(argv[i] + 8);
+		} else if (strncmp(argv[i], "--reps=", 7) == 0 && atoi(argv[i] + 7) > 0) {
+			reps = atoi(argv[i] + 7);
+		} else if (strncmp(argv[i], "--warmup=", 9) == 0 && atoi(argv[i] + 9) >= 0) {
+			warmup = atoi(argv[i] + 9);
+		} else if (strncmp(argv[i], "--filter=", 9) == 0) {
+			filter = argv[i] + 9;
+		} else if (strcmp(argv[i], "--int-only") == 0) {
+			int_only = 1;
+		} else if (strcmp(argv[i], "--check-allocations") == 0) {
+			check = 1;
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	Workload (*generators[])(double) = { deep_expressions, nested_expressions, straight_line, nested_loops,
+		string_building, string_operations, many_variables, print_read, generated };
+	Stats::enable_allocation_counting();
+	std::vector<Result> results;
+	int failed = 0;
+	for (size_t i=0; i < sizeof(generators) / sizeof(generators[0]); ++i) {
+		Workload w = generators[i](scale);
+		if ((filter && strstr(w.name, filter) == NULL) || (int_only && !w.int_only)) {
+			continue;
+		}
+		if (!json) {
+			fprintf(stderr, "%s: %zu bytes of source\n", w.name, w.source.size());
+		}
+		if (bench(w, warmup, reps, check, results) != 0) {
+			failed = 1;
+		}
+	}
+	if (!filter || strstr("int_conv", filter) != NULL) {
+		if (bench_int_conv(scale, warmup, reps, check, results) != 0) {
+			failed = 1;
+		}
+	}
+	if (json) {
+		report_json(results, scale, warmup, reps);
+	} else {
+		report_text(results);
+	}
+	return failed;
+}
@@ -0,0 +1,140 @@
+/*
+ * Generator of large, valid and deterministic Mini-PL programs for stress
+ * and scaling tests, see program_generator.hpp. The output of the program
+ * is written along with it:
+ *
+ *   mpli_gen --bytes=100M -o big.mpl --expect=big.out
+ *   mpli big.mpl | tail -n +3 | head -n -2 | cmp - big.out
+ */
+#include "program_generator.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace mpli_gen;
+
+namespace {
+
+/* parse count with optional K, M or G suffix, returns 0 on success */
+int parse_size(const char *str, unsigned long long *size)
+{
+	char *end;
+	unsigned long long n = strtoull(str, &end, 10);
+	if (end == str) {
+		return 1;
+	}
+	if (*end == 'K' || *end == 'k') {
+		n <<= 10;
+		++end;
+	} else if (*end == 'M' || *end == 'm') {
+		n <<= 20;
+		++end;
+	} else if (*end == 'G' || *end == 'g') {
+		n <<= 30;
+		++end;
+	}
+	if (*end != '\0') {
+		return 1;
+	}
+	*size = n;
+	return 0;
+}
+
+/* parse int option value within min..max, returns 0 on success */
+int parse_int(const char *str, int min, int max, int *value)
+{
+	char *end;
+	long n = strtol(str, &end, 10);
+	if (end == str || *end != '\0' || n < min || n > max) {
+		return 1;
+	}
+	*value = n;
+	return 0;
+}
+
+void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [options]\n"
+		"  --statements=N  stop after about N statements, 1000 by default\n"
+		"  --bytes=N[K|M|G] stop after about N bytes of source instead\n"
+		"  --depth=N       loops nest up to N deep, 2 by default\n"
+		"  --expr-depth=N  expressions nest up to N deep, 3 by default\n"
+		"  --vars=N        number of int, string and bool variables each, 8 by default\n"
+		"  --strings=P     percent of statements on strings, 30 by default\n"
+		"  --iterations=N  loops run 1..N times, 3 by default\n"
+		"  --seed=N        seed, the same options and seed give the same program\n"
+		"  -o FILE         write program into FILE instead of stdout\n"
+		"  --expect=FILE   write output of the program into FILE\n", prog);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	Options options;
+	options.statements = 1000;
+	options.bytes = 0;
+	options.depth = 2;
+	options.expr_depth = 3;
+	options.vars = 8;
+	options.string_percent = 30;
+	options.max_iterations = 3;
+	options.seed = 1;
+	const char *out_path = NULL;
+	const char *expect_path = NULL;
+	for (int i=1; i < argc; ++i) {
+		const char *arg = argv[i];
+		int bad = 0;
+		if (strncmp(arg, "--statements=", 13) == 0) {
+			bad = parse_size(arg + 13, &options.statements);
+			options.bytes = 0;
+		} else if (strncmp(arg, "--bytes=", 8) == 0) {
+			bad = parse_size(arg + 8, &options.bytes);
+			options.statements = 0;
+		} else if (strncmp(arg, "--depth=", 8) == 0) {
+			bad = parse_int(arg + 8, 0, 100, &options.depth);
+		} else if (strncmp(arg, "--expr-depth=", 13) == 0) {
+			bad = parse_int(arg + 13, 0, 20, &options.expr_depth);
+		} else if (strncmp(arg, "--vars=", 7) == 0) {
+			bad = parse_int(arg + 7, 1, 100000, &options.vars);
+		} else if (strncmp(arg, "--strings=", 10) == 0) {
+			bad = parse_int(arg + 10, 0, 100, &options.string_percent);
+		} else if (strncmp(arg, "--iterations=", 13) == 0) {
+			bad = parse_int(arg + 13, 1, 1000, &options.max_iterations);
+		} else if (strncmp(arg, "--seed=", 7) == 0) {
+			bad = parse_size(arg + 7, &options.seed);
+		} else if (strcmp(arg, "-o") == 0 && i + 1 < argc) {
+			out_path = argv[++i];
+		} else if (strncmp(arg, "--expect=", 9) == 0) {
+			expect_path = arg + 9;
+		} else {
+			bad = 1;
+		}
+		if (bad) {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	FILE *out = stdout;
+	if (out_path && (out = fopen(out_path, "w")) == NULL) {
+		fprintf(stderr, "Cannot write %s\n", out_path);
+		return 1;
+	}
+	FILE *expect = NULL;
+	if (expect_path && (expect = fopen(expect_path, "w")) == NULL) {
+		fprintf(stderr, "Cannot write %s\n", expect_path);
+		return 1;
+	}
+	Generator generator(options, out, expect);
+	generator.run();
+	int r = 0;
+	if (out != stdout && fclose(out) != 0) {
+		r = 1;
+	}
+	if (expect && fclose(expect) != 0) {
+		r = 1;
+	}
+	return r;
+}
@@ -0,0 +1,516 @@
+/*
+ * Generator of large, valid and deterministic Mini-PL programs, used by
+ * mpli_gen and mpli_bench. The generator runs every statement it writes
+ * on a model of the program state, so the output of the program is known.
+ *
+ * Values are kept in range by construction: integer expressions only
+ * multiply and divide by small constants, and every assignment divides by
+ * the largest value its expression can reach over the variable bound, so
+ * no loop iteration can overflow. String expressions contain at most one
+ * variable, strings grow by literals only and are reset when long.
+ */
+#ifndef MPLI_PROGRAM_GENERATOR_HPP_
+#define MPLI_PROGRAM_GENERATOR_HPP_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace mpli_gen {
+
+struct Options {
+	/* stop after this many statements or bytes of source, 0 = no limit */
+	unsigned long long statements;
+	unsigned long long bytes;
+	/* loop nesting and expression nesting */
+	int depth;
+	int expr_depth;
+	/* number of int, string and bool variables each */
+	int vars;
+	/* percent of statements on strings */
+	int string_percent;
+	/* iterations of a loop are 1..max_iterations */
+	int max_iterations;
+	unsigned long long seed;
+};
+
+/* largest absolute value of an int variable */
+const long long VALUE_BOUND = 100000;
+/* largest intermediate value of an int expression */
+const long long EXPR_BOUND = 1LL << 30;
+/* string variables longer than this are reset at top level */
+const size_t STRING_RESET = 64;
+
+/* xorshift64*, the same sequence on every platform */
+class Random {
+private:
+	unsigned long long _state;
+public:
+	Random(unsigned long long seed) : _state(seed * 2685821657736338717ULL + 1) { }
+	unsigned long long next()
+	{
+		_state ^= _state >> 12;
+		_state ^= _state << 25;
+		_state ^= _state >> 27;
+		return _state * 2685821657736338717ULL;
+	}
+	/* 0..n-1 */
+	int below(int n)
+	{
+		return (int)((next() >> 33) % n);
+	}
+	int percent(int p)
+	{
+		return below(100) < p;
+	}
+};
+
+struct Expr {
+	enum KIND { INT_CONST, INT_VAR, LOOP_VAR, ADD, SUBTRACT, MULTIPLY, DIVIDE,
+		STRING_CONST, STRING_VAR, CONCAT };
+	KIND kind;
+	/* constant, or index of variable */
+	long long value;
+	std::string text;
+	int left;
+	int right;
+	/* largest absolute value, or length of strings */
+	long long bound;
+};
+
+struct Stmt {
+	enum KIND { INT_ASSIGN, STRING_ASSIGN, BOOL_ASSIGN, PRINT_INT, PRINT_STRING, FOR };
+	KIND kind;
+	/* assigned variable, or nesting level of loop */
+	int var;
+	int expr;
+	/* FOR: 1..iterations, body statement indices */
+	int iterations;
+	std::vector<int> body;
+	/* BOOL_ASSIGN: source of the expression, which is never printed */
+	std::string text;
+};
+
+class Generator {
+private:
+	Options _options;
+	Random _random;
+	FILE *_out;
+	FILE *_expect;
+
+	/* state of the program */
+	std::vector<long long> _ints;
+	std::vector<std::string> _strings;
+	std::vector<long long> _loop_values;
+
+	/* tree of the top-level statement being generated */
+	std::vector<Expr> _exprs;
+	std::vector<Stmt> _stmts;
+
+	std::string _source;
+	std::string _output;
+	unsigned long long _n_bytes;
+	unsigned long long _n_statements;
+
+	int add_expr(Expr::KIND kind, long long value, int left, int right, long long bound)
+	{
+		Expr e;
+		e.kind = kind;
+		e.value = value;
+		e.left = left;
+		e.right = right;
+		e.bound = bound;
+		_exprs.push_back(e);
+		return _exprs.size() - 1;
+	}
+
+	std::string literal()
+	{
+		std::string s;
+		int n = 1 + _random.below(6);
+		for (int i=0; i < n; ++i) {
+			s += (char)('a' + _random.below(26));
+		}
+		return s;
+	}
+
+	/* integer expression reading loop variables of levels < loops */
+	int int_expr(int depth, int loops)
+	{
+		if (depth == 0 || _random.below(3) == 0) {
+			int leaf = _random.below(loops > 0 ? 3 : 2);
+			if (leaf == 0) {
+				long long c = 1 + _random.below(99);
+				return add_expr(Expr::INT_CONST, c, -1, -1, c);
+			} else if (leaf == 1) {
+				return add_expr(Expr::INT_VAR, _random.below(_options.vars), -1, -1, VALUE_BOUND);
+			}
+			return add_expr(Expr::LOOP_VAR, _random.below(loops), -1, -1, _options.max_iterations);
+		}
+		int op = _random.below(4);
+		int left = int_expr(depth - 1, loops);
+		if (op >= 2) {
+			/* multiply and divide only by small constants */
+			long long c = 1 + _random.below(9);
+			int right = add_expr(Expr::INT_CONST, c, -1, -1, c);
+			long long bound = _exprs[left].bound;
+			if (op == 2) {
+				bound *= c;
+				if (bound > EXPR_BOUND) {
+					return left;
+				}
+				return add_expr(Expr::MULTIPLY, 0, left, right, bound);
+			}
+			return add_expr(Expr::DIVIDE, 0, left, right, bound / c + 1);
+		}
+		int right = int_expr(depth - 1, loops);
+		long long bound = _exprs[left].bound + _exprs[right].bound;
+		if (bound > EXPR_BOUND) {
+			return left;
+		}
+		return add_expr(op == 0 ? Expr::ADD : Expr::SUBTRACT, 0, left, right, bound);
+	}
+
+	/* int expression whose value is within VALUE_BOUND */
+	int bounded_int_expr(int loops)
+	{
+		int e = int_expr(_options.expr_depth, loops);
+		long long bound = _exprs[e].bound;
+		if (bound <= VALUE_BOUND) {
+			return e;
+		}
+		long long divisor = (bound + VALUE_BOUND - 1) / VALUE_BOUND;
+		int right = add_expr(Expr::INT_CONST, divisor, -1, -1, divisor);
+		return add_expr(Expr::DIVIDE, 0, e, right, VALUE_BOUND);
+	}
+
+	/* concatenation of literals, at most one of its leaves is a variable */
+	int string_expr(int depth, int *vars_left)
+	{
+		if (depth == 0 || _random.below(3) == 0) {
+			if (*vars_left > 0 && _random.below(2) == 0) {
+				--*vars_left;
+				return add_expr(Expr::STRING_VAR, _random.below(_options.vars), -1, -1, 0);
+			}
+			int e = add_expr(Expr::STRING_CONST, 0, -1, -1, 0);
+			_exprs[e].text = literal();
+			return e;
+		}
+		int left = string_expr(depth - 1, vars_left);
+		int right = string_expr(depth - 1, vars_left);
+		return add_expr(Expr::CONCAT, 0, left, right, 0);
+	}
+
+	long long eval_int(int e)
+	{
+		const Expr &x = _exprs[e];
+		switch (x.kind) {
+		case Expr::INT_CONST:
+			return x.value;
+		case Expr::INT_VAR:
+			return _ints[x.value];
+		case Expr::LOOP_VAR:
+			return _loop_values[x.value];
+		case Expr::ADD:
+			return eval_int(x.left) + eval_int(x.right);
+		case Expr::SUBTRACT:
+			return eval_int(x.left) - eval_int(x.right);
+		case Expr::MULTIPLY:
+			return eval_int(x.left) * eval_int(x.right);
+		default:
+			return eval_int(x.left) / eval_int(x.right);
+		}
+	}
+
+	void eval_string(int e, std::string &out)
+	{
+		const Expr &x = _exprs[e];
+		if (x.kind == Expr::STRING_CONST) {
+			out += x.text;
+		} else if (x.kind == Expr::STRING_VAR) {
+			out += _strings[x.value];
+		} else {
+			eval_string(x.left, out);
+			eval_string(x.right, out);
+		}
+	}
+
+	/* operand: binary expressions in parentheses */
+	void render_operand(int e, std::string &out)
+	{
+		const Expr &x = _exprs[e];
+		if (x.left >= 0) {
+			out += '(';
+			render(e, out);
+			out += ')';
+		} else {
+			render(e, out);
+		}
+	}
+
+	void render(int e, std::string &out)
+	{
+		const Expr &x = _exprs[e];
+		char buf[32];
+		switch (x.kind) {
+		case Expr::INT_CONST:
+			snprintf(buf, sizeof(buf), "%lld", x.value);
+			out += buf;
+			return;
+		case Expr::INT_VAR:
+			snprintf(buf, sizeof(buf), "i%lld", x.value);
+			out += buf;
+			return;
+		case Expr::LOOP_VAR:
+			snprintf(buf, sizeof(buf), "l%lld", x.value);
+			out += buf;
+			return;
+		case Expr::STRING_CONST:
+			out += '"';
+			out += x.text;
+			out += '"';
+			return;
+		case Expr::STRING_VAR:
+			snprintf(buf, sizeof(buf), "s%lld", x.value);
+			out += buf;
+			return;
+		default:
+			break;
+		}
+		static const char *ops[] = { " + ", " - ", " * ", " / " };
+		render_operand(x.left, out);
+		out += (x.kind == Expr::CONCAT ? " + " : ops[x.kind - Expr::ADD]);
+		render_operand(x.right, out);
+	}
+
+	std::string bool_expr(int loops)
+	{
+		std::string out;
+		int b = _random.below(_options.vars);
+		char buf[32];
+		switch (_random.below(3)) {
+		case 0:
+			render_operand(int_expr(1, loops), out);
+			out += " < ";
+			render_operand(int_expr(1, loops), out);
+			break;
+		case 1:
+			snprintf(buf, sizeof(buf), "b%d & (", b);
+			out += buf;
+			render_operand(int_expr(1, loops), out);
+			out += " = ";
+			render_operand(int_expr(1, loops), out);
+			out += ')';
+			break;
+		default:
+			snprintf(buf, sizeof(buf), "!b%d", b);
+			out += buf;
+			break;
+		}
+		return out;
+	}
+
+	/* statement inside loops of levels < loops */
+	int statement(int loops)
+	{
+		Stmt s;
+		s.var = _random.below(_options.vars);
+		s.expr = -1;
+		s.iterations = 0;
+		int kind = _random.below(100);
+		if (loops < _options.depth && kind < 15) {
+			s.kind = Stmt::FOR;
+			s.var = loops;
+			s.iterations = 1 + _random.below(_options.max_iterations);
+			_stmts.push_back(s);
+			/* body statements are added after the loop, refer to it by index */
+			int index = _stmts.size() - 1;
+			int n = 1 + _random.below(4);
+			for (int i=0; i < n; ++i) {
+				int stmt = statement(loops + 1);
+				_stmts[index].body.push_back(stmt);
+			}
+			return index;
+		}
+		int on_strings = _random.percent(_options.string_percent);
+		int printing = _random.below(10) == 0;
+		if (on_strings) {
+			int vars_left = 1;
+			s.kind = printing ? Stmt::PRINT_STRING : Stmt::STRING_ASSIGN;
+			s.expr = string_expr(_options.expr_depth, &vars_left);
+		} else if (printing) {
+			s.kind = Stmt::PRINT_INT;
+			s.expr = bounded_int_expr(loops);
+		} else if (_random.below(8) == 0) {
+			s.kind = Stmt::BOOL_ASSIGN;
+			s.text = bool_expr(loops);
+		} else {
+			s.kind = Stmt::INT_ASSIGN;
+			s.expr = bounded_int_expr(loops);
+		}
+		_stmts.push_back(s);
+		return _stmts.size() - 1;
+	}
+
+	void indent(int level, std::string &out)
+	{
+		out.append(2 * level, ' ');
+	}
+
+	void render_stmt(int index, int level, std::string &out)
+	{
+		const Stmt &s = _stmts[index];
+		char buf[64];
+		indent(level, out);
+		++_n_statements;
+		switch (s.kind) {
+		case Stmt::INT_ASSIGN:
+			snprintf(buf, sizeof(buf), "i%d := ", s.var);
+			out += buf;
+			render(s.expr, out);
+			break;
+		case Stmt::STRING_ASSIGN:
+			snprintf(buf, sizeof(buf), "s%d := ", s.var);
+			out += buf;
+			render(s.expr, out);
+			break;
+		case Stmt::BOOL_ASSIGN:
+			snprintf(buf, sizeof(buf), "b%d := ", s.var);
+			out += buf;
+			out += s.text;
+			break;
+		case Stmt::PRINT_INT:
+		case Stmt::PRINT_STRING:
+			out += "print ";
+			render(s.expr, out);
+			/* string literals have no escapes, the newline is in the source */
+			out += "; print \"\n\"";
+			++_n_statements;
+			break;
+		case Stmt::FOR:
+			snprintf(buf, sizeof(buf), "for l%d in 1..%d do\n", s.var, s.iterations);
+			out += buf;
+			for (size_t i=0; i < s.body.size(); ++i) {
+				render_stmt(s.body[i], level + 1, out);
+			}
+			indent(level, out);
+			out += "end for";
+			break;
+		}
+		out += ";\n";
+	}
+
+	void execute(int index)
+	{
+		const Stmt &s = _stmts[index];
+		switch (s.kind) {
+		case Stmt::INT_ASSIGN:
+			_ints[s.var] = eval_int(s.expr);
+			break;
+		case Stmt::STRING_ASSIGN: {
+			std::string value;
+			eval_string(s.expr, value);
+			_strings[s.var] = value;
+			break;
+		}
+		case Stmt::BOOL_ASSIGN:
+			break;
+		case Stmt::PRINT_INT: {
+			char buf[32];
+			snprintf(buf, sizeof(buf), "%lld\n", eval_int(s.expr));
+			_output += buf;
+			break;
+		}
+		case Stmt::PRINT_STRING:
+			eval_string(s.expr, _output);
+			_output += '\n';
+			break;
+		case Stmt::FOR:
+			for (int i=1; i <= s.iterations; ++i) {
+				_loop_values[s.var] = i;
+				for (size_t j=0; j < s.body.size(); ++j) {
+					execute(s.body[j]);
+				}
+			}
+			break;
+		}
+	}
+
+	/* write out pending source and output */
+	void flush()
+	{
+		fwrite(_source.data(), 1, _source.size(), _out);
+		_n_bytes += _source.size();
+		_source.clear();
+		if (_expect) {
+			fwrite(_output.data(), 1, _output.size(), _expect);
+		}
+		_output.clear();
+	}
+
+	int done()
+	{
+		return (_options.statements > 0 && _n_statements >= _options.statements) ||
+			(_options.bytes > 0 && _n_bytes + _source.size() >= _options.bytes);
+	}
+
+public:
+	Generator(const Options &options, FILE *out, FILE *expect)
+		: _options(options), _random(options.seed), _out(out), _expect(expect)
+	{
+		_n_bytes = 0;
+		_n_statements = 0;
+	}
+
+	void run()
+	{
+		char buf[128];
+		for (int l=0; l < _options.depth; ++l) {
+			snprintf(buf, sizeof(buf), "var l%d : int;\n", l);
+			_source += buf;
+			_loop_values.push_back(0);
+		}
+		for (int v=0; v < _options.vars; ++v) {
+			_ints.push_back(_random.below(1000));
+			_strings.push_back(literal());
+			snprintf(buf, sizeof(buf), "var i%d : int := %lld;\nvar s%d : string := \"%s\";\n"
+				"var b%d : bool := %d < %d;\n", v, _ints[v], v, _strings[v].c_str(), v,
+				_random.below(10), _random.below(10));
+			_source += buf;
+		}
+		_n_statements += 3 * _options.vars + _options.depth;
+
+		while (!done()) {
+			_exprs.clear();
+			_stmts.clear();
+			int top = statement(0);
+			render_stmt(top, 0, _source);
+			execute(top);
+			for (int v=0; v < _options.vars; ++v) {
+				if (_strings[v].size() > STRING_RESET) {
+					_strings[v] = literal();
+					snprintf(buf, sizeof(buf), "s%d := \"%s\";\n", v, _strings[v].c_str());
+					_source += buf;
+					++_n_statements;
+				}
+			}
+			if (_source.size() >= 1 << 20) {
+				flush();
+			}
+		}
+
+		/* final values make the output depend on every variable */
+		for (int v=0; v < _options.vars; ++v) {
+			snprintf(buf, sizeof(buf), "print i%d; print \" \"; print s%d; print \"\n\";\n", v, v);
+			_source += buf;
+			snprintf(buf, sizeof(buf), "%lld ", _ints[v]);
+			_output += buf;
+			_output += _strings[v];
+			_output += '\n';
+		}
+		flush();
+	}
+};
+
+} // namespace mpli_gen
+#endif // MPLI_PROGRAM_GENERATOR_HPP_
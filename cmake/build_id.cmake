@@ -0,0 +1,33 @@
+# Writes OUTPUT, a header defining MPLI_BUILD_ID: the project VERSION, the
+# git commit of SOURCE_DIR and a hash of the interpreter sources, so that
+# uncommitted changes give a new identifier too. OUTPUT is only rewritten
+# when the identifier changes.
+
+execute_process(COMMAND git rev-parse --short=12 HEAD
+	WORKING_DIRECTORY ${SOURCE_DIR}
+	OUTPUT_VARIABLE commit
+	OUTPUT_STRIP_TRAILING_WHITESPACE
+	RESULT_VARIABLE git_result
+	ERROR_QUIET)
+if(NOT git_result EQUAL 0 OR commit STREQUAL "")
+	set(commit "nogit")
+endif()
+
+file(GLOB sources ${SOURCE_DIR}/src/*.cpp ${SOURCE_DIR}/src/*.hpp)
+list(SORT sources)
+set(contents "")
+foreach(source ${sources})
+	file(SHA1 ${source} source_hash)
+	set(contents "${contents}${source_hash}")
+endforeach()
+string(SHA1 sources_hash "${contents}")
+string(SUBSTRING ${sources_hash} 0 12 sources_hash)
+
+set(id "${VERSION}-${commit}-${sources_hash}")
+set(header "/* generated by cmake/build_id.cmake */\n#define MPLI_BUILD_ID \"${id}\"\n")
+if(EXISTS ${OUTPUT})
+	file(READ ${OUTPUT} old_header)
+endif()
+if(NOT old_header STREQUAL header)
+	file(WRITE ${OUTPUT} "${header}")
+endif()
@@ -0,0 +1,24 @@
+/*
+ * Replacement of the global operator new counting allocations into Stats,
+ * see Stats::count_allocation. Linked into the mpli and mpli_bench
+ * executables only, programs embedding libmpli keep their own allocator.
+ */
+#include "stats.hpp"
+
+#include <cstdlib>
+#include <new>
+
+void *operator new(size_t size)
+{
+	mpli::Stats::count_allocation(size);
+	void *p = malloc(size > 0 ? size : 1);
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
@@ -1,34 +1,64 @@
 #include "ast.hpp"
+#include "int_conv.hpp"
 
 #include <cstdio>
+#include <cstring>
+#include <atomic>
 
 namespace mpli {
 
+ASTNode::ASTNode()
+{
+	operator_type = ASTOperator::ADD;
+	variable_type = ASTVariable::UNKNOWN;
+	int_value = 0;
+	symbol = -1;
+	slot = -1;
+	line = 0;
+	column = 0;
+	cache_slot = -1;
+	cache_scope = -1;
+	height = 1;
+}
+
+static std::atomic<unsigned long long> next_serial(1);
+
+/* set position of node to that of the first token under parse tree node */
+static void set_position(ASTNode *node, Node *from)
+{
+	while (from->type != Node::TOKEN && !from->children.empty()) {
+		from = from->children[0];
+	}
+	node->line = from->token.line;
+	node->column = from->token.column;
+}
+
 AST::AST()
 {
 	_number_of_errors = 0;
     _root = NULL;
+	for (int i=0; i < 4; ++i) {
+		_frame_top[i] = 0;
+		_frame_size[i] = 0;
+	}
+	_serial = next_serial.fetch_add(1);
 }
 
 AST::~AST()
 {
-    if (_root) {
-        delete_node_r(_root);
-    }
-}
-
-void AST::delete_node_r(ASTNode *node)
-{
-    for(int i=(node->children.size()-1); i >= 0; --i) {
-        delete_node_r(node->children[i]);
+    if (_root && _pool.empty()) {
+        std::vector<ASTNode*> nodes;
+        preorder(_root, nodes);
+        for (size_t i=0; i < nodes.size(); ++i) {
+            delete nodes[i];
+        }
     }
-    delete node;   
 }
 
 void AST::report_error(std::string str)
 {
 	_number_of_errors++;
-	printf("ERROR: %s\n", str.c_str());
+	_errors += "ERROR: " + str + "\n";
 }
 
 int AST::number_of_errors()
@@ -36,12 +66,12 @@ int AST::number_of_errors()
 	return _number_of_errors;
 }
 
-void AST::debug_print()
+const std::string &AST::errors()
 {
-	debug_print_r(_root, 1);
+	return _errors;
 }
 
-void AST::debug_print_r(ASTNode *node, int level)
+void AST::debug_print() const
 {
 	const char* nodetypes[] = {
 		"ROOT",
@@ -58,26 +88,207 @@ void AST::debug_print_r(ASTNode *node, int level)
 		"VAR_INIT",
 		"CONSTANT"
 		};
-	
-    printf("DEBUG: ASTNode level %d: %s %s\n", level, nodetypes[node->type], node->value.c_str());
-	
-	for (int i=0; i < node->children.size(); ++i) {
-		debug_print_r(node->children[i], level+1);
+
+	/* nodes still to print with their levels, the next one last */
+	std::vector<std::pair<ASTNode*, int> > stack;
+	stack.push_back(std::make_pair(_root, 1));
+	while (!stack.empty()) {
+		ASTNode *node = stack.back().first;
+		int level = stack.back().second;
+		stack.pop_back();
+		printf("DEBUG: ASTNode level %d: %s %s\n", level, nodetypes[node->type], node->value.c_str());
+		for (int i=(int)node->children.size()-1; i >= 0; --i) {
+			stack.push_back(std::make_pair(node->children[i], level+1));
+		}
 	}
 }
 
-ASTNode *AST::root()
+ASTNode *AST::root() const
 {
 	return _root;
 }
 
+unsigned long long AST::serial() const
+{
+	return _serial;
+}
+
+const Identifiers &AST::identifiers() const
+{
+	return _identifiers;
+}
+
+int AST::frame_size(Symbol::TYPE type) const
+{
+	return _frame_size[type];
+}
+
+/* symbol type of variables declared with given type */
+static Symbol::TYPE symbol_type(ASTVariable::TYPE type)
+{
+	switch (type) {
+		case ASTVariable::INTEGER:
+			return Symbol::VARIABLE_INT;
+		case ASTVariable::STRING:
+			return Symbol::VARIABLE_STRING;
+		case ASTVariable::BOOLEAN:
+			return Symbol::VARIABLE_BOOL;
+		default:
+			return Symbol::UNDEFINED;
+	}
+}
+
+ASTNode *AST::new_id_node(const Token &token)
+{
+	ASTNode *id_node = new ASTNode;
+	id_node->type = ASTNode::VAR_ID;
+	id_node->value = token.str;
+	id_node->symbol = _identifiers.intern(token.str, token.hash);
+	id_node->line = token.line;
+	id_node->column = token.column;
+	return id_node;
+}
+
 void AST::create(Node *root)
 {
     _root = new ASTNode;
     _root->type = ASTNode::ROOT;
-    build(_root, root);    
+    build(_root, root);
+    std::vector<ASTNode*> nodes;
+    preorder(_root, nodes);
+    set_heights(nodes);
 };
 
+void AST::set_heights(const std::vector<ASTNode*> &nodes)
+{
+	/* children follow their parent in preorder */
+	for (size_t i=nodes.size(); i-- > 0; ) {
+		ASTNode *node = nodes[i];
+		node->height = 1;
+		for (size_t j=0; j < node->children.size(); ++j) {
+			if (node->children[j]->height >= node->height) {
+				node->height = node->children[j]->height + 1;
+			}
+		}
+	}
+}
+
+void AST::serialize(std::string &out) const
+{
+	std::vector<ASTNode*> tree;
+	preorder(_root, tree);
+	std::vector<FlatNode> nodes(tree.size());
+	std::string strings;
+	for (size_t i=0; i < tree.size(); ++i) {
+		ASTNode *node = tree[i];
+		FlatNode &flat = nodes[i];
+		flat.type = node->type;
+		flat.operator_type = node->operator_type;
+		flat.variable_type = node->variable_type;
+		flat.int_value = node->int_value;
+		flat.n_children = node->children.size();
+		flat.line = node->line;
+		flat.column = node->column;
+		flat.slot = node->slot;
+		flat.value_offset = strings.size();
+		flat.value_length = node->value.size();
+		strings.append(node->value);
+	}
+
+	FlatHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "MPLIAST", 8);
+	header.version = IMAGE_VERSION;
+	header.n_nodes = nodes.size();
+	header.strings_size = strings.size();
+	out.append((const char*)&header, sizeof(header));
+	out.append((const char*)&nodes[0], nodes.size() * sizeof(FlatNode));
+	out.append(strings);
+}
+
+int AST::load(const char *data, size_t size)
+{
+	FlatHeader header;
+	if (_root || size < sizeof(header)) {
+		return 1;
+	}
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, "MPLIAST", 8) != 0 || header.version != IMAGE_VERSION ||
+		header.n_nodes == 0 || header.n_nodes > size / sizeof(FlatNode) ||
+		size != sizeof(header) + (size_t)header.n_nodes * sizeof(FlatNode) + header.strings_size) {
+		return 1;
+	}
+	const char *records = data + sizeof(header);
+	const char *strings = records + (size_t)header.n_nodes * sizeof(FlatNode);
+
+	/* pointers into the pool stay valid, it is never resized */
+	_pool.resize(header.n_nodes);
+	/* nodes whose children are still being read, with the number of
+	 * children they are missing, innermost last */
+	std::vector<std::pair<ASTNode*, int> > open;
+	std::vector<ASTNode*> nodes(header.n_nodes);
+	for (unsigned int i=0; i < header.n_nodes; ++i) {
+		FlatNode flat;
+		memcpy(&flat, records + (size_t)i * sizeof(FlatNode), sizeof(flat));
+		ASTNode *node = &_pool[i];
+		nodes[i] = node;
+		/* every node but the root is the next child of an open node */
+		if ((i > 0) == open.empty() || flat.n_children < 0 ||
+			(unsigned int)flat.n_children > header.n_nodes - i - 1 || flat.slot >= (int)header.n_nodes ||
+			load_node(node, flat, strings, header.strings_size) != 0) {
+			_pool.clear();
+			return 1;
+		}
+		if (!open.empty()) {
+			open.back().first->children.push_back(node);
+			if (--open.back().second == 0) {
+				open.pop_back();
+			}
+		}
+		if (flat.n_children > 0) {
+			node->children.reserve(flat.n_children);
+			open.push_back(std::make_pair(node, flat.n_children));
+		}
+	}
+	if (!open.empty() || _pool[0].type != ASTNode::ROOT) {
+		_pool.clear();
+		return 1;
+	}
+	set_heights(nodes);
+	_root = &_pool[0];
+	return 0;
+}
+
+int AST::load_node(ASTNode *node, const FlatNode &flat, const char *strings,
+	unsigned int strings_size)
+{
+	if (flat.type < ASTNode::ROOT || flat.type > ASTNode::CONSTANT ||
+		flat.operator_type < ASTOperator::ADD || flat.operator_type > ASTOperator::NOT ||
+		flat.variable_type < ASTVariable::STRING || flat.variable_type > ASTVariable::UNKNOWN ||
+		flat.slot < -1 ||
+		flat.value_offset > strings_size || flat.value_length > strings_size - flat.value_offset) {
+		return 1;
+	}
+	node->type = (ASTNode::TYPE)flat.type;
+	node->operator_type = (ASTOperator::TYPE)flat.operator_type;
+	node->variable_type = (ASTVariable::TYPE)flat.variable_type;
+	node->int_value = flat.int_value;
+	node->line = flat.line;
+	node->column = flat.column;
+	node->slot = flat.slot;
+	if (node->type == ASTNode::VAR_INIT && node->slot >= 0) {
+		Symbol::TYPE t = symbol_type(node->variable_type);
+		if (t != Symbol::UNDEFINED && node->slot >= _frame_size[t]) {
+			_frame_size[t] = node->slot + 1;
+		}
+	}
+	node->value.assign(strings + flat.value_offset, flat.value_length);
+	if (node->type == ASTNode::VAR_ID) {
+		node->symbol = _identifiers.intern(node->value);
+	}
+	return 0;
+}
+
 void AST::build(ASTNode *parent, Node *node)
 {
     std::vector<Node*>::iterator it;
@@ -96,6 +307,7 @@ void AST::build(ASTNode *parent, Node *node)
                 /* Do nothing. Correct location has been checked in parser. */
                 break;
             }
+            /* fall through */
         default:
 			std::string e_str = "AST::build - Invalid node location in parse tree for node type ";
             report_error(e_str.append(node->type_str()));
@@ -134,6 +346,7 @@ void AST::build_var_init(ASTNode *parent, Node *stmt_node)
     /* initialization node */
     ASTNode *var_init_node = new ASTNode;
     var_init_node->type = ASTNode::VAR_INIT;
+    set_position(var_init_node, stmt_node);
     
     ASTVariable::TYPE var_type;
 	Symbol::TYPE s_type;
@@ -154,20 +367,31 @@ void AST::build_var_init(ASTNode *parent, Node *stmt_node)
 			std::string e_str = "AST::build_var_init - Cannot resolve variable type for token type ";
             report_error(e_str.append(stmt_node->children[3]->token.type_str()));
             var_type = ASTVariable::UNKNOWN;
+			s_type = Symbol::UNDEFINED;
     }
     var_init_node->variable_type = var_type;
+	/* next free slot of the current frame */
+	if (s_type != Symbol::UNDEFINED) {
+		var_init_node->slot = _frame_top[s_type]++;
+		if (_frame_top[s_type] > _frame_size[s_type]) {
+			_frame_size[s_type] = _frame_top[s_type];
+		}
+	}
 
     /* identifier node */
-    ASTNode *id_node = new ASTNode;
-    id_node->type = ASTNode::VAR_ID;
-    id_node->value = stmt_node->children[1]->token.str;
+    ASTNode *id_node = new_id_node(stmt_node->children[1]->token);
     id_node->variable_type = var_type;
     var_init_node->children.push_back(id_node);
 	
-	/* add id to symbol table */
+	/* add id to symbol table, in scope until the end of the block */
+	Declaration d;
+	d.symbol = id_node->symbol;
+	d.hidden = _symbol_table.find(id_node->symbol);
+	_declarations.push_back(d);
 	Symbol s;
 	s.type = s_type;
-	_symbol_table.push(id_node->value, s);
+	s.location = var_init_node->slot;
+	_symbol_table.push(id_node->symbol, s);
 
     /* set initialization node to be children of parent */
     parent->children.push_back(var_init_node);
@@ -176,12 +400,15 @@ void AST::build_var_init(ASTNode *parent, Node *stmt_node)
         /* insert node */
         ASTNode *insert_node = new ASTNode;
         insert_node->type = ASTNode::INSERT;
+        set_position(insert_node, stmt_node);
 
         /* identifier node 2 */
         ASTNode *id_node2 = new ASTNode;
         id_node2->type = id_node->type;
         id_node2->value = id_node->value;
+        id_node2->symbol = id_node->symbol;
         id_node2->variable_type = id_node->variable_type;
+        set_position(id_node2, stmt_node->children[1]);
         insert_node->children.push_back(id_node2);
 		
 		parent->children.push_back(insert_node);
@@ -197,14 +424,13 @@ void AST::build_insert(ASTNode *parent, Node *stmt_node)
     /* insert node */
     ASTNode *insert_node = new ASTNode;
     insert_node->type = ASTNode::INSERT;
+    set_position(insert_node, stmt_node);
 
     /* identifier node */
-    ASTNode *id_node = new ASTNode;
-    id_node->type = ASTNode::VAR_ID;
-    id_node->value = stmt_node->children[0]->token.str;
+    ASTNode *id_node = new_id_node(stmt_node->children[0]->token);
     /* check symbol table */
 	std::string e_str;
-	switch (_symbol_table.find(id_node->value).type) {
+	switch (_symbol_table.find(id_node->symbol).type) {
 		case Symbol::VARIABLE_INT:
 			id_node->variable_type = ASTVariable::INTEGER;
 			break;
@@ -240,20 +466,20 @@ void AST::build_for_loop(ASTNode *parent, Node *stmt_node)
     /* for loop node */
     ASTNode *for_node = new ASTNode;
     for_node->type = ASTNode::FOR_LOOP;
+    set_position(for_node, stmt_node);
     parent->children.push_back(for_node);
 
     /* for in node */
     ASTNode *in_node = new ASTNode;
     in_node->type = ASTNode::FOR_IN;
+    set_position(in_node, stmt_node->children[1]);
     for_node->children.push_back(in_node);
     
     /* in : identifier node */
-    ASTNode *id_node = new ASTNode;
-    id_node->type = ASTNode::VAR_ID;
-    id_node->value = stmt_node->children[1]->token.str;
+    ASTNode *id_node = new_id_node(stmt_node->children[1]->token);
 	/* check symbol table */
 	std::string e_str;
-	switch (_symbol_table.find(id_node->value).type) {
+	switch (_symbol_table.find(id_node->symbol).type) {
 		case Symbol::VARIABLE_INT:
 			id_node->variable_type = ASTVariable::INTEGER;
 			break;
@@ -285,10 +511,20 @@ void AST::build_for_loop(ASTNode *parent, Node *stmt_node)
     /* for do node */
     ASTNode *do_node = new ASTNode;
     do_node->type = ASTNode::FOR_DO;
+    set_position(do_node, stmt_node->children[6]);
     for_node->children.push_back(do_node);
 
-    /* do : stmts */
+    /* do : stmts, a block with a frame of its own */
+    size_t declared = _declarations.size();
+    int frame_top[4];
+    memcpy(frame_top, _frame_top, sizeof(frame_top));
     build(do_node, stmt_node->children[7]);
+    /* end of block: its names go out of scope and its slots are free */
+    while (_declarations.size() > declared) {
+        _symbol_table.push(_declarations.back().symbol, _declarations.back().hidden);
+        _declarations.pop_back();
+    }
+    memcpy(_frame_top, frame_top, sizeof(frame_top));
 }
 
 void AST::build_read(ASTNode *parent, Node *stmt_node)
@@ -296,14 +532,13 @@ void AST::build_read(ASTNode *parent, Node *stmt_node)
     /* read node */
     ASTNode *read_node = new ASTNode;
     read_node->type = ASTNode::READ;
+    set_position(read_node, stmt_node);
 
     /* identifier node */
-    ASTNode *id_node = new ASTNode;
-    id_node->type = ASTNode::VAR_ID;
-    id_node->value = stmt_node->children[1]->token.str;
+    ASTNode *id_node = new_id_node(stmt_node->children[1]->token);
 	/* check symbol table */
 	std::string e_str;
-	switch (_symbol_table.find(id_node->value).type) {
+	switch (_symbol_table.find(id_node->symbol).type) {
 		case Symbol::VARIABLE_INT:
 			id_node->variable_type = ASTVariable::INTEGER;
 			break;
@@ -336,6 +571,7 @@ void AST::build_print(ASTNode *parent, Node *stmt_node)
     /* print node */
     ASTNode *print_node = new ASTNode;
     print_node->type = ASTNode::PRINT;
+    set_position(print_node, stmt_node);
 
     /* set print node to be children of parent */
     parent->children.push_back(print_node);
@@ -349,6 +585,7 @@ void AST::build_assert(ASTNode *parent, Node *stmt_node)
     /* assert node */
     ASTNode *assert_node = new ASTNode;
     assert_node->type = ASTNode::ASSERT;
+    set_position(assert_node, stmt_node);
 
     /* set assert node to be children of parent */
     parent->children.push_back(assert_node);
@@ -359,20 +596,43 @@ void AST::build_assert(ASTNode *parent, Node *stmt_node)
 
 void AST::build_expr(ASTNode *parent, Node *expr_node)
 {
+    /* Operands wait on a stack instead of the C++ stack, so expressions
+     * nested arbitrarily deep can be built. Left operands are built first,
+     * errors come in source order. */
+    _operands.clear();
+    build_expr_node(parent, expr_node);
+    while (!_operands.empty()) {
+        Operand operand = _operands.back();
+        _operands.pop_back();
+        Node *nested = build_opnd(operand.parent, operand.node);
+        if (nested) {
+            build_expr_node(operand.parent, nested);
+        }
+    }
+}
+
+void AST::build_expr_node(ASTNode *parent, Node *expr_node)
+{
+    Operand operand;
     if (expr_node->children.size() < 3) {
         /* unary operator */
 		if (expr_node->children[0]->token.type == Token::OP_NOT) {
 			ASTNode *unary_node = new ASTNode;
 			unary_node->type = ASTNode::UNARY_OP;
+			set_position(unary_node, expr_node->children[0]);
 			parent->children.push_back(unary_node);
 
-			build_opnd(unary_node, expr_node->children[1]);
+			operand.parent = unary_node;
+			operand.node = expr_node->children[1];
 		} else {
-			build_opnd(parent, expr_node->children[0]);
+			operand.parent = parent;
+			operand.node = expr_node->children[0];
 		}
+		_operands.push_back(operand);
     } else {
         ASTNode *op_node = new ASTNode;
         op_node->type = ASTNode::OPERATOR;
+        set_position(op_node, expr_node->children[1]);
         
         switch (expr_node->children[1]->token.type) {
             case Token::OP_ADD:
@@ -406,36 +666,43 @@ void AST::build_expr(ASTNode *parent, Node *expr_node)
 
         parent->children.push_back(op_node);
 
-        build_opnd(op_node, expr_node->children[0]);
-        build_opnd(op_node, expr_node->children[2]);
+        /* right operand below the left one */
+        operand.parent = op_node;
+        operand.node = expr_node->children[2];
+        _operands.push_back(operand);
+        operand.node = expr_node->children[0];
+        _operands.push_back(operand);
     }
 }
 
-void AST::build_opnd(ASTNode *parent, Node *opnd_node)
+Node *AST::build_opnd(ASTNode *parent, Node *opnd_node)
 {
     ASTNode *wat_node = NULL;
 	std::string e_str;
     switch (opnd_node->children[0]->token.type) {
         case Token::INTEGER:
             wat_node = new ASTNode;
+            set_position(wat_node, opnd_node->children[0]);
             wat_node->type = ASTNode::CONSTANT;
             wat_node->value = opnd_node->children[0]->token.str;
             wat_node->variable_type = ASTVariable::INTEGER;
+            /* oversized constants wrap, as they always have */
+            parse_int(wat_node->value.data(), wat_node->value.data() + wat_node->value.size(),
+                &wat_node->int_value);
             parent->children.push_back(wat_node);
             break;
         case Token::STRING:
             wat_node = new ASTNode;
+            set_position(wat_node, opnd_node->children[0]);
             wat_node->type = ASTNode::CONSTANT;
             wat_node->value = opnd_node->children[0]->token.str;
             wat_node->variable_type = ASTVariable::STRING;
             parent->children.push_back(wat_node);
             break;
         case Token::IDENTIFIER:
-            wat_node = new ASTNode;
-            wat_node->type = ASTNode::VAR_ID;
-            wat_node->value = opnd_node->children[0]->token.str;
+            wat_node = new_id_node(opnd_node->children[0]->token);
             /* check symbol table */
-			switch (_symbol_table.find(wat_node->value).type) {
+			switch (_symbol_table.find(wat_node->symbol).type) {
 				case Symbol::VARIABLE_INT:
 					wat_node->variable_type = ASTVariable::INTEGER;
 					break;
@@ -460,13 +727,134 @@ void AST::build_opnd(ASTNode *parent, Node *opnd_node)
 			parent->children.push_back(wat_node);
 			break;
         case Token::BRACKET_LEFT:
-            build_expr(parent, opnd_node->children[1]);
-            break;
+            return opnd_node->children[1];
         default:
 			e_str = "AST::build_opnd - Token type ";
 			e_str.append(opnd_node->children[0]->token.type_str());
 			report_error(e_str.append(" is not allowed at this location."));
     }
+    return NULL;
+}
+
+ASTVariable::TYPE op_var_typing(ASTNode *node)
+{
+	ASTVariable::TYPE t = ASTVariable::UNKNOWN;
+	ASTNode *n = node;
+	switch (node->children[0]->type) {
+		case ASTNode::OPERATOR:
+			n = node->children[0]->children[0];
+			while (n->type == ASTNode::OPERATOR) {
+				n = n->children[0];
+			}
+			switch (n->type) {
+				case ASTNode::UNARY_OP:
+					t = ASTVariable::BOOLEAN;
+					break;
+				case ASTNode::VAR_ID:
+				case ASTNode::CONSTANT:
+					t = n->variable_type;
+					break;
+				default:
+				t = ASTVariable::UNKNOWN;
+			}
+			break;
+		case ASTNode::UNARY_OP:
+			t = ASTVariable::BOOLEAN;
+			break;
+		case ASTNode::VAR_ID:
+		case ASTNode::CONSTANT:
+			t = node->children[0]->variable_type;
+			break;
+		default:
+			t = ASTVariable::UNKNOWN;
+	}
+	return t;
+}
+
+int refers_to(ASTNode *node, const std::string &id)
+{
+	if (node->type == ASTNode::VAR_ID && node->value == id) {
+		return 1;
+	}
+	if (node->height > ASTNode::RECURSIVE_HEIGHT) {
+		std::vector<ASTNode*> nodes;
+		preorder(node, nodes);
+		for (size_t i=1; i < nodes.size(); ++i) {
+			if (nodes[i]->type == ASTNode::VAR_ID && nodes[i]->value == id) {
+				return 1;
+			}
+		}
+		return 0;
+	}
+	for (size_t i=0; i < node->children.size(); ++i) {
+		if (refers_to(node->children[i], id)) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int refers_to(ASTNode *node, int symbol)
+{
+	if (node->type == ASTNode::VAR_ID && node->symbol == symbol) {
+		return 1;
+	}
+	if (node->height > ASTNode::RECURSIVE_HEIGHT) {
+		std::vector<ASTNode*> nodes;
+		preorder(node, nodes);
+		for (size_t i=1; i < nodes.size(); ++i) {
+			if (nodes[i]->type == ASTNode::VAR_ID && nodes[i]->symbol == symbol) {
+				return 1;
+			}
+		}
+		return 0;
+	}
+	for (size_t i=0; i < node->children.size(); ++i) {
+		if (refers_to(node->children[i], symbol)) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int count_nodes(ASTNode *node)
+{
+	std::vector<ASTNode*> nodes;
+	preorder(node, nodes);
+	return nodes.size();
+}
+
+void preorder(ASTNode *node, std::vector<ASTNode*> &nodes)
+{
+	/* nodes still to visit, the next one last */
+	std::vector<ASTNode*> stack(1, node);
+	while (!stack.empty()) {
+		ASTNode *n = stack.back();
+		stack.pop_back();
+		nodes.push_back(n);
+		for (int i=(int)n->children.size()-1; i >= 0; --i) {
+			stack.push_back(n->children[i]);
+		}
+	}
+}
+
+const char *type_name(ASTNode::TYPE type)
+{
+	static const char *names[] = { "root", "assign", "operator", "unary_op", "for",
+		"for_in", "for_do", "read", "print", "assert", "var_id", "var", "constant" };
+	return names[type];
+}
+
+int contains_type(ASTNode *node, ASTNode::TYPE type)
+{
+	std::vector<ASTNode*> nodes;
+	preorder(node, nodes);
+	for (size_t i=0; i < nodes.size(); ++i) {
+		if (nodes[i]->type == type) {
+			return 1;
+		}
+	}
+	return 0;
 }
 
 } // namespace mpli
@@ -5,6 +5,7 @@
 #include "symbol_table.hpp"
 #include <vector>
 #include <string>
+#include <cstddef>
 
 namespace mpli {
 
@@ -59,17 +60,110 @@ struct ASTNode {
     ASTOperator::TYPE operator_type;
     /* if type == VAR_ID | VAR_INIT | CONSTANT */
     ASTVariable::TYPE variable_type;
+    /* if type == CONSTANT and variable_type == INTEGER: value parsed once */
+    int int_value;
+    /* if type == VAR_ID: interned id of value in AST::identifiers(), -1 otherwise */
+    int symbol;
+    /* if type == VAR_INIT: slot of the variable among the values of its
+     * type, see AST::frame_size(), -1 otherwise */
+    int slot;
+    /* source position: first token of statements, operator token of
+     * operators, from 1, 0 if unknown */
+    int line;
+    int column;
+
+    /* expression cache annotations set by Optimizer, -1 if none:
+     * slot caching the value of an OPERATOR | UNARY_OP node, and scope
+     * whose cached values are invalidated when this statement starts */
+    int cache_slot;
+    int cache_scope;
+
+    /* levels of the tree under this node, 1 for leaves, set by AST */
+    int height;
+    /* Trees at most this high are walked recursively. Higher ones, such as
+     * generated expressions, are evaluated with an explicit stack and left
+     * alone by the optional passes, so they cannot overflow the C++ stack. */
+    static const int RECURSIVE_HEIGHT = 512;
+
+    ASTNode();
 };
 
+/* Operand typing of an OPERATOR node: type of its leftmost leaf. */
+ASTVariable::TYPE op_var_typing(ASTNode *node);
+/* Returns true if expression tree reads given identifier. */
+int refers_to(ASTNode *node, const std::string &id);
+/* Returns true if expression tree reads identifier of given symbol id. */
+int refers_to(ASTNode *node, int symbol);
+/* Returns number of nodes in tree. */
+int count_nodes(ASTNode *node);
+/* Appends nodes of tree into nodes in preorder. */
+void preorder(ASTNode *node, std::vector<ASTNode*> &nodes);
+/* Returns name of node type, statements by keyword, e.g. "print". */
+const char *type_name(ASTNode::TYPE type);
+/* Returns true if tree contains a node of given type. */
+int contains_type(ASTNode *node, ASTNode::TYPE type);
+
 /*
  * Abstract Syntax Tree.
  */
 class AST {
+public:
+	/* version of the serialized form, see serialize() */
+	static const int IMAGE_VERSION = 3;
+
 private:
+	/* node of serialized AST, nodes are stored in preorder */
+	struct FlatNode {
+		int type;
+		int operator_type;
+		int variable_type;
+		int int_value;
+		int n_children;
+		int line;
+		int column;
+		int slot;
+		unsigned int value_offset;
+		unsigned int value_length;
+	};
+	struct FlatHeader {
+		char magic[8];
+		int version;
+		unsigned int n_nodes;
+		unsigned int strings_size;
+	};
+
 	SymbolTable _symbol_table;
+	/* names of VAR_ID nodes, ASTNode::symbol is their id */
+	Identifiers _identifiers;
+
+	/* Frames: declarations of a FOR_DO block take the slots above those
+	 * of the enclosing blocks and free them when the block ends, so
+	 * sibling blocks share slots and every iteration reuses the same ones.
+	 * Next free slot and number of slots, by Symbol::TYPE. */
+	int _frame_top[4];
+	int _frame_size[4];
+	/* operands of the expression being built, the next one last */
+	struct Operand {
+		ASTNode *parent;
+		Node *node;
+	};
+	std::vector<Operand> _operands;
+
+	/* names declared in open blocks and the symbols they hid, innermost last */
+	struct Declaration {
+		int symbol;
+		Symbol hidden;
+	};
+	std::vector<Declaration> _declarations;
 
     ASTNode *_root;
 	int _number_of_errors;
+	/* error messages, one per line */
+	std::string _errors;
+	/* all nodes of a loaded AST, empty if nodes are allocated one by one */
+	std::vector<ASTNode> _pool;
+	/* unique among all ASTs of the process, never 0 */
+	unsigned long long _serial;
 
 	/* black magic, magical numbers and ugly code */
     void build(ASTNode *parent, Node *node);
@@ -81,12 +175,20 @@ private:
     void build_print(ASTNode *parent, Node *stmt_node);
     void build_assert(ASTNode *parent, Node *stmt_node);
     void build_expr(ASTNode *parent, Node *expr_node);
-    void build_opnd(ASTNode *parent, Node *opnd_node);
+    /* node of expr_node under parent, its operands are pushed into _operands */
+    void build_expr_node(ASTNode *parent, Node *expr_node);
+    /* returns expression of an operand in parentheses, NULL otherwise */
+    Node *build_opnd(ASTNode *parent, Node *opnd_node);
 
 	/* utility functions */
 	void report_error(std::string str);
-    void delete_node_r(ASTNode *node);
-	void debug_print_r(ASTNode *node, int level);
+	/* VAR_ID node named by identifier token */
+	ASTNode *new_id_node(const Token &token);
+	/* fill node from flat record, returns 0 on success */
+	int load_node(ASTNode *node, const FlatNode &flat, const char *strings,
+		unsigned int strings_size);
+	/* set ASTNode::height of nodes, given in preorder */
+	static void set_heights(const std::vector<ASTNode*> &nodes);
 public:
     AST();
     ~AST();
@@ -94,12 +196,27 @@ public:
 	 * Note: Changes in parse tree constructions probably breaks this.
 	 */
     void create(Node *root);
+	/* Append a flat, position independent image of the AST into out. */
+	void serialize(std::string &out) const;
+	/* Create AST from an image made by serialize(). Nodes are allocated
+	 * in one block. Returns 0 on success, 1 if image is not valid. */
+	int load(const char *data, size_t size);
     /* Get number of errors. */
 	int number_of_errors();
+	/* Get messages of reported errors. */
+	const std::string &errors();
 	/* Debug print AST with level information. */
-	void debug_print();
+	void debug_print() const;
 	/* Get AST's root node. Please do not abuse this to change AST. */
-	ASTNode *root();
+	ASTNode *root() const;
+	/* Number identifying this AST, node addresses alone may be reused by
+	 * later ASTs. */
+	unsigned long long serial() const;
+	/* Names of variables, indexed by ASTNode::symbol. */
+	const Identifiers &identifiers() const;
+	/* Number of slots for values of given type, the most that are in
+	 * scope at once. */
+	int frame_size(Symbol::TYPE type) const;
 };
 
 } // namespace mpli
@@ -0,0 +1,160 @@
+#include "batch_runner.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <dirent.h>
+#include <sys/stat.h>
+
+namespace mpli {
+
+BatchRunner::BatchRunner(const Program::Options &options, int threads) : _pool(threads)
+{
+	_options = options;
+	_batch_loops = 1;
+	_closed_form_loops = 1;
+}
+
+BatchRunner::~BatchRunner()
+{
+	for (size_t i=0; i < _programs.size(); ++i) {
+		delete _programs[i];
+	}
+	for (size_t i=0; i < _contexts.size(); ++i) {
+		delete _contexts[i];
+	}
+}
+
+void BatchRunner::set_loop_batching(int enabled)
+{
+	_batch_loops = enabled;
+}
+
+void BatchRunner::set_closed_form_loops(int enabled)
+{
+	_closed_form_loops = enabled;
+}
+
+void BatchRunner::add(const std::string &path)
+{
+	Script script;
+	script.path = path;
+	script.program = -1;
+	script.has_input = 0;
+	script.status = NO_FILE;
+
+	std::string source;
+	if (Program::read_file(path, source) == 0) {
+		std::map<std::string, int>::iterator it = _program_index.find(source);
+		if (it == _program_index.end()) {
+			it = _program_index.insert(std::make_pair(source, (int)_programs.size())).first;
+			_sources.push_back(&it->first);
+			_programs.push_back(NULL);
+			_errors.push_back(std::string());
+		}
+		script.program = it->second;
+		script.has_input = Program::read_file(path + ".in", script.input) == 0;
+	}
+	_scripts.push_back(script);
+}
+
+int BatchRunner::add_list(const std::string &path)
+{
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0) {
+		return 1;
+	}
+	if (S_ISDIR(st.st_mode)) {
+		DIR *dir = opendir(path.c_str());
+		if (!dir) {
+			return 1;
+		}
+		std::vector<std::string> names;
+		struct dirent *entry;
+		while ((entry = readdir(dir)) != NULL) {
+			std::string name(entry->d_name);
+			if (name.size() > 4 && name.compare(name.size() - 4, 4, ".mpl") == 0) {
+				names.push_back(name);
+			}
+		}
+		closedir(dir);
+		std::sort(names.begin(), names.end());
+		for (size_t i=0; i < names.size(); ++i) {
+			add(path + "/" + names[i]);
+		}
+		return 0;
+	}
+
+	std::string list;
+	if (Program::read_file(path, list) != 0) {
+		return 1;
+	}
+	size_t begin = 0;
+	while (begin < list.size()) {
+		size_t end = list.find('\n', begin);
+		if (end == std::string::npos) {
+			end = list.size();
+		}
+		if (end > begin) {
+			add(list.substr(begin, end - begin));
+		}
+		begin = end + 1;
+	}
+	return 0;
+}
+
+/* compiling needs no context, so the worker index is not used */
+void BatchRunner::compile_task(void *context, int task, int)
+{
+	BatchRunner *b = (BatchRunner*)context;
+	b->_programs[task] = Program::compile(*b->_sources[task], b->_options, &b->_errors[task]);
+}
+
+void BatchRunner::run_task(void *context, int task, int worker)
+{
+	BatchRunner *b = (BatchRunner*)context;
+	Script &script = b->_scripts[task];
+	if (script.program < 0) {
+		return;
+	}
+	const Program *program = b->_programs[script.program];
+	if (!program) {
+		script.output = b->_errors[script.program];
+		script.status = COMPILE_ERROR;
+		return;
+	}
+
+	Context *c = b->_contexts[worker];
+	c->set_output_string(&script.output);
+	c->set_input_string(script.has_input ? script.input : std::string());
+	try {
+		script.status = c->run(*program) == 0 ? OK : RUN_ERROR;
+	} catch (std::exception &e) {
+		script.status = EXCEPTION;
+	}
+	/* detach output string of this script */
+	c->set_output_string(NULL);
+}
+
+void BatchRunner::run()
+{
+	while ((int)_contexts.size() < _pool.size()) {
+		Context *c = new Context;
+		c->set_loop_batching(_batch_loops);
+		c->set_closed_form_loops(_closed_form_loops);
+		_contexts.push_back(c);
+	}
+	_pool.run(_programs.size(), compile_task, this);
+	_pool.run(_scripts.size(), run_task, this);
+}
+
+const std::vector<BatchRunner::Script> &BatchRunner::scripts() const
+{
+	return _scripts;
+}
+
+int BatchRunner::n_programs() const
+{
+	return _programs.size();
+}
+
+} // namespace mpli
@@ -0,0 +1,88 @@
+#ifndef MPLI_BATCH_RUNNER_HPP_
+#define MPLI_BATCH_RUNNER_HPP_
+
+#include "program.hpp"
+#include "context.hpp"
+#include "thread_pool.hpp"
+#include <vector>
+#include <string>
+#include <map>
+
+namespace mpli {
+
+/*
+ * Compiles and runs many scripts in one process on a thread pool. Every
+ * script runs in a context of its own worker with its own output string;
+ * scripts with identical sources share one compiled program. Input of a
+ * script is read from the file with ".in" appended to its path, if there
+ * is one.
+ */
+class BatchRunner {
+public:
+	/* result of a script, also its exit status in batch output */
+	enum STATUS {
+		OK = 0,
+		RUN_ERROR = 1,		/* stopped on an error, message in output */
+		COMPILE_ERROR = 2,	/* messages in output */
+		EXCEPTION = 3,		/* e.g. division by zero */
+		NO_FILE = 4			/* script cannot be read */
+	};
+
+	struct Script {
+		std::string path;
+		/* index into programs, -1 if file cannot be read */
+		int program;
+		std::string input;
+		int has_input;
+		std::string output;
+		STATUS status;
+	};
+
+private:
+	Program::Options _options;
+	int _batch_loops;
+	int _closed_form_loops;
+
+	std::vector<Script> _scripts;
+	/* unique sources, their programs and compile errors */
+	std::map<std::string, int> _program_index;
+	std::vector<const std::string*> _sources;
+	std::vector<Program*> _programs;
+	std::vector<std::string> _errors;
+
+	ThreadPool _pool;
+	/* one per worker */
+	std::vector<Context*> _contexts;
+
+	/* ThreadPool::TaskFunction */
+	static void compile_task(void *context, int task, int worker);
+	static void run_task(void *context, int task, int worker);
+
+	BatchRunner(const BatchRunner&);
+	BatchRunner &operator=(const BatchRunner&);
+
+public:
+	BatchRunner(const Program::Options &options, int threads);
+	~BatchRunner();
+
+	/* see Interpreter */
+	void set_loop_batching(int enabled);
+	void set_closed_form_loops(int enabled);
+
+	/* add script in path */
+	void add(const std::string &path);
+	/* Add scripts ending with ".mpl" in directory path in name order,
+	 * or when path is a file, scripts listed in it one per line.
+	 * Returns 0 on success, 1 if path cannot be read. */
+	int add_list(const std::string &path);
+
+	/* compile and run all added scripts */
+	void run();
+	/* scripts in the order they were added */
+	const std::vector<Script> &scripts() const;
+	/* number of distinct programs compiled */
+	int n_programs() const;
+};
+
+} // namespace mpli
+#endif // MPLI_BATCH_RUNNER_HPP_
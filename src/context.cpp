@@ -0,0 +1,70 @@
+#include "context.hpp"
+
+namespace mpli {
+
+Context::Context()
+{
+	_input_from_string = 0;
+}
+
+void Context::set_output_fd(int fd)
+{
+	_interpreter.set_output_fd(fd);
+}
+
+void Context::set_output_string(std::string *sink)
+{
+	_interpreter.capture_output(sink);
+}
+
+void Context::set_input_fd(int fd)
+{
+	_input.clear();
+	_input_from_string = 0;
+	_interpreter.set_input_fd(fd);
+}
+
+void Context::set_input_string(const std::string &data)
+{
+	_input = data;
+	_input_from_string = 1;
+}
+
+void Context::set_flush_policy(OutputBuffer::FLUSH_POLICY policy, size_t threshold)
+{
+	_interpreter.set_flush_policy(policy, threshold);
+}
+
+void Context::set_threads(int n)
+{
+	_interpreter.set_threads(n);
+}
+
+void Context::set_loop_batching(int enabled)
+{
+	_interpreter.set_loop_batching(enabled);
+}
+
+void Context::set_closed_form_loops(int enabled)
+{
+	_interpreter.set_closed_form_loops(enabled);
+}
+
+void Context::set_step_budget(unsigned long long steps)
+{
+	_interpreter.set_step_budget(steps);
+}
+
+int Context::run(const Program &program)
+{
+	if (_input_from_string) {
+		_interpreter.set_input_data(_input.data(), _input.size());
+	}
+	_interpreter.set_expression_cache(program._optimizer);
+	if (program._ir) {
+		return _interpreter.execute_ir(*program._ir);
+	}
+	return _interpreter.execute(&program._ast);
+}
+
+} // namespace mpli
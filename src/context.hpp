@@ -0,0 +1,53 @@
+#ifndef MPLI_CONTEXT_HPP_
+#define MPLI_CONTEXT_HPP_
+
+#include "program.hpp"
+#include "interpreter.hpp"
+#include <string>
+
+namespace mpli {
+
+/*
+ * Execution context that runs compiled programs. Variables live in the
+ * context only for the duration of one run, so a context can run the same
+ * or different programs any number of times, reusing its buffers. A
+ * context is used by one thread at a time.
+ */
+class Context {
+private:
+	Interpreter _interpreter;
+	/* input given as string, read by every run from its start */
+	std::string _input;
+	int _input_from_string;
+
+	Context(const Context&);
+	Context &operator=(const Context&);
+
+public:
+	Context();
+
+	/* Program output is written into fd, stdout by default. */
+	void set_output_fd(int fd);
+	/* Program output is appended into sink, which must stay valid. */
+	void set_output_string(std::string *sink);
+	/* Read statements read from fd, stdin by default. */
+	void set_input_fd(int fd);
+	/* Read statements read from a copy of data, every run from its start. */
+	void set_input_string(const std::string &data);
+
+	/* see Interpreter */
+	void set_flush_policy(OutputBuffer::FLUSH_POLICY policy, size_t threshold);
+	void set_threads(int n);
+	void set_loop_batching(int enabled);
+	void set_closed_form_loops(int enabled);
+	void set_step_budget(unsigned long long steps);
+
+	/* Run program. Returns 0 on success, 1 if it stopped on an error,
+	 * whose message is in its output, and Interpreter::BUDGET_EXCEEDED
+	 * when step budget ran out. Division by zero throws
+	 * std::invalid_argument. */
+	int run(const Program &program);
+};
+
+} // namespace mpli
+#endif // MPLI_CONTEXT_HPP_
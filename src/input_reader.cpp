@@ -0,0 +1,188 @@
+#include "input_reader.hpp"
+#include "int_conv.hpp"
+
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace mpli {
+
+/* same set of characters as isspace() in C locale */
+static inline int is_space(char c)
+{
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+InputReader::InputReader(int fd)
+{
+	_fd = fd;
+	_opened = 0;
+	_eof = 0;
+	_map = NULL;
+	_map_size = 0;
+	_pos = NULL;
+	_end = NULL;
+}
+
+InputReader::~InputReader()
+{
+	if (_map) {
+		munmap(_map, _map_size);
+	}
+}
+
+void InputReader::set_fd(int fd)
+{
+	if (_map) {
+		munmap(_map, _map_size);
+	}
+	_fd = fd;
+	_opened = 0;
+	_eof = 0;
+	_map = NULL;
+	_map_size = 0;
+	_pos = NULL;
+	_end = NULL;
+}
+
+void InputReader::set_data(const char *data, size_t size)
+{
+	set_fd(-1);
+	/* all input is available, like a mapped file */
+	_opened = 1;
+	_eof = 1;
+	_pos = data;
+	_end = data + size;
+}
+
+void InputReader::open()
+{
+	_opened = 1;
+
+	struct stat st;
+	off_t offset = lseek(_fd, 0, SEEK_CUR);
+	if (fstat(_fd, &st) == 0 && S_ISREG(st.st_mode) && offset >= 0 &&
+		st.st_size > offset) {
+		void *m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, _fd, 0);
+		if (m != MAP_FAILED) {
+			_map = (char*)m;
+			_map_size = st.st_size;
+			madvise(m, _map_size, MADV_SEQUENTIAL);
+			_pos = _map + offset;
+			_end = _map + _map_size;
+			/* whole file is available, no more reads */
+			_eof = 1;
+			lseek(_fd, 0, SEEK_END);
+			return;
+		}
+	}
+
+	_block.resize(BLOCK_SIZE);
+	_pos = &_block[0];
+	_end = _pos;
+}
+
+int InputReader::fill(const char **keep)
+{
+	if (_eof) {
+		return 0;
+	}
+
+	/* move kept bytes to start of block, grow block if they fill it */
+	size_t kept = _end - *keep;
+	if (kept > 0) {
+		memmove(&_block[0], *keep, kept);
+	}
+	if (kept == _block.size()) {
+		_block.resize(_block.size() * 2);
+	}
+	*keep = &_block[0];
+
+	ssize_t n;
+	do {
+		n = ::read(_fd, &_block[kept], _block.size() - kept);
+	} while (n < 0 && errno == EINTR);
+	if (n <= 0) {
+		_eof = 1;
+		n = 0;
+	}
+	_pos = &_block[0];
+	_end = _pos + kept + n;
+	return n > 0;
+}
+
+int InputReader::next_token(const char **begin, const char **end)
+{
+	if (!_opened) {
+		open();
+	}
+
+	/* skip whitespace */
+	for (;;) {
+		while (_pos < _end && is_space(*_pos)) {
+			++_pos;
+		}
+		if (_pos < _end) {
+			break;
+		}
+		const char *keep = _end;
+		if (!fill(&keep)) {
+			return 0;
+		}
+	}
+
+	/* token until whitespace or end of input */
+	const char *start = _pos;
+	const char *p = _pos;
+	for (;;) {
+		while (p < _end && !is_space(*p)) {
+			++p;
+		}
+		if (p < _end) {
+			break;
+		}
+		size_t len = p - start;
+		if (!fill(&start)) {
+			p = start + len;
+			break;
+		}
+		p = start + len;
+	}
+
+	*begin = start;
+	*end = p;
+	_pos = p;
+	return 1;
+}
+
+InputReader::RESULT InputReader::read_int(int *val)
+{
+	const char *b, *e;
+	if (!next_token(&b, &e)) {
+		return READ_EOF;
+	}
+	if (parse_int(b, e, val) != PARSE_INT_OK) {
+		_last_token.assign(b, e - b);
+		return READ_INVALID;
+	}
+	return READ_OK;
+}
+
+InputReader::RESULT InputReader::read_word(std::string &word)
+{
+	const char *b, *e;
+	if (!next_token(&b, &e)) {
+		return READ_EOF;
+	}
+	word.assign(b, e - b);
+	return READ_OK;
+}
+
+const std::string &InputReader::last_token()
+{
+	return _last_token;
+}
+
+} // namespace mpli
@@ -0,0 +1,72 @@
+#ifndef MPLI_INPUT_READER_HPP_
+#define MPLI_INPUT_READER_HPP_
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace mpli {
+
+/*
+ * Reader for whitespace separated input values. Regular files are mapped
+ * into memory, pipes and terminals are read in large blocks.
+ */
+class InputReader {
+public:
+	/* return values of read functions */
+	enum RESULT {
+		READ_OK,
+		READ_EOF,
+		READ_INVALID
+	};
+
+	/* size of a single read() when input is not mapped */
+	static const size_t BLOCK_SIZE = 64 * 1024;
+
+private:
+	int _fd;
+	int _opened;
+	int _eof;
+
+	/* mapped file, if input is a regular file */
+	char *_map;
+	size_t _map_size;
+
+	/* block buffer, otherwise */
+	std::vector<char> _block;
+
+	/* unconsumed input is [_pos, _end) */
+	const char *_pos;
+	const char *_end;
+
+	/* map or prepare block buffer on first read */
+	void open();
+	/* Read more input, keeping bytes from keep onwards. Returns 0 at
+	 * end of input. keep is updated to its new address. */
+	int fill(const char **keep);
+	/* Find next token, returns 0 at end of input. */
+	int next_token(const char **begin, const char **end);
+
+public:
+	InputReader(int fd = 0);
+	~InputReader();
+
+	/* Read from fd from now on, unread input is dropped. */
+	void set_fd(int fd);
+	/* Read from size bytes at data, which must stay valid while reading. */
+	void set_data(const char *data, size_t size);
+
+	/* Read next value as int. Value must be a whole token of optionally
+	 * signed digits that fits in int. */
+	RESULT read_int(int *val);
+	/* Read next whitespace separated word. */
+	RESULT read_word(std::string &word);
+	/* Last token that was rejected by read_int. */
+	const std::string &last_token();
+
+private:
+	std::string _last_token;
+};
+
+} // namespace mpli
+#endif // MPLI_INPUT_READER_HPP_
@@ -0,0 +1,113 @@
+#include "int_conv.hpp"
+
+namespace mpli {
+
+/* "00" "01" ... "99": two output digits per table lookup */
+static const char digit_pairs[201] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+static const unsigned int powers_of_10[] = {
+	0, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+	1000000000 };
+
+int count_digits(unsigned int val)
+{
+	/* log10 approximated from bit length (1233/4096 ~ log10(2)),
+	 * corrected with one table compare */
+	int bits = 32 - __builtin_clz(val | 1);
+	int t = (bits * 1233) >> 12;
+	return t + (val >= powers_of_10[t]);
+}
+
+/* writes exactly len digits of val ending at out + len */
+static void write_digits(unsigned int val, char *out, int len)
+{
+	char *p = out + len;
+	while (val >= 100) {
+		unsigned int i = (val % 100) * 2;
+		val /= 100;
+		p -= 2;
+		p[0] = digit_pairs[i];
+		p[1] = digit_pairs[i + 1];
+	}
+	if (val >= 10) {
+		unsigned int i = val * 2;
+		p -= 2;
+		p[0] = digit_pairs[i];
+		p[1] = digit_pairs[i + 1];
+	} else {
+		*--p = (char)('0' + val);
+	}
+}
+
+char *format_int(int val, char *out)
+{
+	unsigned int u = (unsigned int)val;
+	if (val < 0) {
+		*out++ = '-';
+		u = 0u - u;
+	}
+	int len = count_digits(u);
+	write_digits(u, out, len);
+	return out + len;
+}
+
+void append_int(std::string &str, int val)
+{
+	unsigned int u = (unsigned int)val;
+	int neg = (val < 0);
+	if (neg) {
+		u = 0u - u;
+	}
+	int len = count_digits(u);
+	std::string::size_type old = str.size();
+	str.resize(old + neg + len);
+	char *out = &str[old];
+	if (neg) {
+		*out++ = '-';
+	}
+	write_digits(u, out, len);
+}
+
+ParseIntResult parse_int(const char *begin, const char *end, int *val)
+{
+	const char *s = begin;
+	int neg = 0;
+	if (s != end && (*s == '+' || *s == '-')) {
+		neg = (*s == '-');
+		++s;
+	}
+	if (s == end) {
+		return PARSE_INT_INVALID;
+	}
+
+	/* accumulate in unsigned to get defined wrap-around */
+	unsigned int r = 0;
+	int overflow = 0;
+	for (; s != end; ++s) {
+		unsigned int d = (unsigned int)(*s - '0');
+		if (d > 9) {
+			return PARSE_INT_INVALID;
+		}
+		if (r > 429496729u || (r == 429496729u && d > 5)) {
+			overflow = 1;
+		}
+		r = r * 10 + d;
+	}
+	if (!overflow && r > 2147483647u + (unsigned int)neg) {
+		overflow = 1;
+	}
+	*val = (int)(neg ? 0u - r : r);
+	return overflow ? PARSE_INT_OVERFLOW : PARSE_INT_OK;
+}
+
+} // namespace mpli
@@ -0,0 +1,37 @@
+#ifndef MPLI_INT_CONV_HPP_
+#define MPLI_INT_CONV_HPP_
+
+#include <string>
+
+namespace mpli {
+
+/* Maximum number of characters format_int writes (sign + 10 digits). */
+static const int INT_CONV_MAX_CHARS = 11;
+
+/* Return values of parse_int. */
+enum ParseIntResult {
+	PARSE_INT_OK,
+	PARSE_INT_INVALID,
+	PARSE_INT_OVERFLOW
+};
+
+/* Returns number of decimal digits in val, 1 for zero. */
+int count_digits(unsigned int val);
+
+/* Writes decimal representation of val into out without terminating zero.
+ * out must have room for INT_CONV_MAX_CHARS characters.
+ * Returns pointer one past the last written character.
+ */
+char *format_int(int val, char *out);
+
+/* Appends decimal representation of val into str. */
+void append_int(std::string &str, int val);
+
+/* Parses optionally signed decimal integer from [begin, end).
+ * On PARSE_INT_OVERFLOW val holds the result wrapped to 32 bits, which is
+ * what the interpreter has always done for oversized constants.
+ */
+ParseIntResult parse_int(const char *begin, const char *end, int *val);
+
+} // namespace mpli
+#endif // MPLI_INT_CONV_HPP_
@@ -1,94 +1,485 @@
 #include "interpreter.hpp"
+#include "int_conv.hpp"
+#include "ir_executor.hpp"
 
 #include <cstdio>
-#include <iostream>
 #include <stdexcept>
+#include <algorithm>
+#include <atomic>
 
 namespace mpli {
 
-int Interpreter::execute(AST *ast)
+int Interpreter::execute(const AST *ast)
+{
+	int r = 0;
+	reset(ast);
+	try {
+		r = execute_root(ast);
+	} catch (...) {
+		/* let pending output out before the error propagates */
+		_output.flush();
+		throw;
+	}
+	_output.flush();
+	return r;
+}
+
+int Interpreter::execute_ir(const IRFunction &fn)
+{
+	IRExecutor executor(_output, _input);
+	int r = 0;
+	try {
+		r = executor.run(fn);
+	} catch (...) {
+		_output.flush();
+		throw;
+	}
+	_output.flush();
+	return r;
+}
+
+void Interpreter::reset(const AST *ast)
+{
+	_symbol_table.clear();
+	_int_values.assign(ast->frame_size(Symbol::VARIABLE_INT), 0);
+	_bool_values.assign(ast->frame_size(Symbol::VARIABLE_BOOL), 0);
+	/* strings keep their capacity for the next run */
+	_string_values.resize(ast->frame_size(Symbol::VARIABLE_STRING));
+	for (size_t i=0; i < _string_values.size(); ++i) {
+		_string_values[i].clear();
+	}
+	_cache_epochs.assign(_cache_epochs.size(), 0);
+	_scope_epochs.assign(_scope_epochs.size(), 0);
+	_steps = 0;
+	_loop_iterations = 0;
+	if (ast->serial() != _kernels_ast) {
+		std::map<ASTNode*, LoopKernel*>::iterator it;
+		for (it = _loop_kernels.begin(); it != _loop_kernels.end(); ++it) {
+			delete it->second;
+		}
+		_loop_kernels.clear();
+		_kernels_ast = ast->serial();
+	}
+}
+
+int Interpreter::execute_root(const AST *ast)
 {
 	ASTNode *root = ast->root();
 	if (!root) {
-		printf("\nERROR: Interpreter::execute - AST root is not valid.\n");
+		_output.write_format("\nERROR: Interpreter::execute - AST root is not valid.\n");
 	}
 	int r = 0;
-	for (int i=0; i < root->children.size(); ++i) {
+	for (size_t i=0; i < root->children.size(); ++i) {
 		if (r != 0) {
 			/* error -> exit with error code */
 			return r;
 		}
-		switch (root->children[i]->type) {
-			case ASTNode::INSERT:
-				r = execute_insert(root->children[i]);
-				break;
-			case ASTNode::FOR_LOOP:
-				r = execute_for_loop(root->children[i]);
-				break;
-			case ASTNode::VAR_INIT:
-				r = execute_var_init(root->children[i]);
-				break;
-			case ASTNode::READ:
-				r = execute_read(root->children[i]);
-				break;
-			case ASTNode::PRINT:
-				r = execute_print(root->children[i]);
-				break;
-			case ASTNode::ASSERT:
-				r = execute_assert(root->children[i]);
-				break;
-			default:
-				printf("\nERROR: Interpreter::execute - AST root's child is not valid.\n");
-				r = 1;
+		if (_statement_stats) {
+			char name[32];
+			snprintf(name, sizeof(name), "stmt %d:%d", root->children[i]->line,
+				root->children[i]->column);
+			_statement_stats->begin(name);
 		}
+		r = execute_stmt(root->children[i], "execute", "AST root's child is not valid");
+	}
+	/* an error of the last statement stops the program too */
+	return r;
+}
+
+int Interpreter::charge_steps(unsigned long long n)
+{
+	_steps += n;
+	if (_step_budget > 0 && _steps > _step_budget) {
+		return BUDGET_EXCEEDED;
 	}
 	return 0;
 }
 
-int Interpreter::execute_var_init(ASTNode *node)
+int Interpreter::execute_stmt(ASTNode *node, const char *caller, const char *invalid_msg)
+{
+	if (charge_steps(1)) {
+		return BUDGET_EXCEEDED;
+	}
+	if (_instrumented) {
+		return instrumented_stmt(node, caller, invalid_msg);
+	}
+	return dispatch_stmt(node, caller, invalid_msg);
+}
+
+int Interpreter::instrumented_stmt(ASTNode *node, const char *caller, const char *invalid_msg)
+{
+	if (_profiler) {
+		_profiler->enter(node);
+	}
+	ASTNode *outer = _sampler ? _sampler->enter(node) : NULL;
+	int outer_tag = Stats::allocation_tag();
+	if (_tag_allocations) {
+		Stats::set_allocation_tag(1 + node->type);
+	}
+	int r = dispatch_stmt(node, caller, invalid_msg);
+	if (_tag_allocations) {
+		Stats::set_allocation_tag(outer_tag);
+	}
+	if (_sampler) {
+		_sampler->leave(outer);
+	}
+	if (_profiler) {
+		_profiler->leave();
+	}
+	return r;
+}
+
+int Interpreter::dispatch_stmt(ASTNode *node, const char *caller, const char *invalid_msg)
+{
+	if (node->cache_scope >= 0) {
+		/* values cached in an earlier run of this statement are stale */
+		_scope_epochs[node->cache_scope] = ++_epoch;
+	}
+	switch (node->type) {
+		case ASTNode::INSERT:
+			return execute_insert(node);
+		case ASTNode::FOR_LOOP:
+			return execute_for_loop(node);
+		case ASTNode::VAR_INIT:
+			return execute_var_init(node);
+		case ASTNode::READ:
+			return execute_read(node);
+		case ASTNode::PRINT:
+			return execute_print(node);
+		case ASTNode::ASSERT:
+			return execute_assert(node);
+		default:
+			_output.write_format("\nERROR: Interpreter::%s - %s.\n", caller, invalid_msg);
+			return 1;
+	}
+}
+
+Interpreter::Interpreter()
+{
+	_pool = NULL;
+	_batch_loops = 1;
+	_closed_form_loops = 1;
+	_epoch = 0;
+	_steps = 0;
+	_step_budget = 0;
+	_loop_iterations = 0;
+	_kernels_ast = 0;
+	_profiler = NULL;
+	_sampler = NULL;
+	_statement_stats = NULL;
+	_tag_allocations = 0;
+	_instrumented = 0;
+}
+
+Interpreter::~Interpreter()
+{
+	std::map<ASTNode*, LoopKernel*>::iterator it;
+	for (it = _loop_kernels.begin(); it != _loop_kernels.end(); ++it) {
+		delete it->second;
+	}
+	delete _pool;
+}
+
+void Interpreter::set_threads(int n)
+{
+	delete _pool;
+	_pool = NULL;
+	if (n > 1) {
+		_pool = new ThreadPool(n);
+	}
+}
+
+void Interpreter::set_loop_batching(int enabled)
+{
+	_batch_loops = enabled;
+}
+
+void Interpreter::set_closed_form_loops(int enabled)
+{
+	_closed_form_loops = enabled;
+}
+
+void Interpreter::set_expression_cache(const Optimizer &optimizer)
+{
+	_cache_scopes = optimizer.slot_scopes();
+	_cache_values.assign(_cache_scopes.size(), 0);
+	_cache_epochs.assign(_cache_scopes.size(), 0);
+	_scope_epochs.assign(optimizer.n_scopes(), 0);
+}
+
+void Interpreter::set_step_budget(unsigned long long steps)
+{
+	_step_budget = steps;
+}
+
+void Interpreter::set_profiler(Profiler *profiler)
+{
+	_profiler = profiler;
+	update_instrumented();
+}
+
+void Interpreter::set_sampler(Sampler *sampler)
+{
+	_sampler = sampler;
+	update_instrumented();
+}
+
+void Interpreter::set_allocation_tags(int enabled)
+{
+	_tag_allocations = enabled;
+	update_instrumented();
+}
+
+void Interpreter::update_instrumented()
+{
+	_instrumented = (_profiler != NULL || _sampler != NULL || _tag_allocations);
+}
+
+void Interpreter::set_statement_stats(Stats *stats)
+{
+	_statement_stats = stats;
+}
+
+unsigned long long Interpreter::steps()
 {
-	if (_symbol_table.find(node->children[0]->value).type != Symbol::UNDEFINED) {
-		printf("\nERROR: Interpreter::execute_var_init - Identifier %s is already initialized.\n", node->children[0]->value.c_str());
+	return _steps;
+}
+
+unsigned long long Interpreter::loop_iterations()
+{
+	return _loop_iterations;
+}
+
+void Interpreter::capture_output(std::string *sink)
+{
+	_output.capture(sink);
+}
+
+void Interpreter::set_output_fd(int fd)
+{
+	_output.set_fd(fd);
+}
+
+void Interpreter::set_input_fd(int fd)
+{
+	_input.set_fd(fd);
+}
+
+void Interpreter::set_input_data(const char *data, size_t size)
+{
+	_input.set_data(data, size);
+}
+
+int Interpreter::cached(ASTNode *node, int *value)
+{
+	int slot = node->cache_slot;
+	if (_cache_epochs[slot] == 0 || _cache_epochs[slot] != _scope_epochs[_cache_scopes[slot]]) {
+		return 0;
+	}
+	*value = _cache_values[slot];
+	return 1;
+}
+
+void Interpreter::cache(ASTNode *node, int value)
+{
+	int slot = node->cache_slot;
+	_cache_values[slot] = value;
+	_cache_epochs[slot] = _scope_epochs[_cache_scopes[slot]];
+}
+
+LoopKernel *Interpreter::loop_kernel(ASTNode *node)
+{
+	std::map<ASTNode*, LoopKernel*>::iterator it = _loop_kernels.find(node);
+	if (it != _loop_kernels.end()) {
+		return it->second;
+	}
+	/* NULL is cached too: analysis result does not change */
+	LoopKernel *kernel = LoopKernel::compile(node, _symbol_table);
+	_loop_kernels[node] = kernel;
+	return kernel;
+}
+
+/* shared state of one kernel loop execution */
+struct KernelLoop {
+	const LoopKernel *kernel;
+	int start;
+	long long n;
+	int n_tasks;
+	int batch;
+	/* parts of Interpreter::_kernel_buffer: */
+	/* preamble registers, copied for every task */
+	int *loaded;
+	/* registers and batch scratch of every worker */
+	int *regs;
+	int *scratch;
+	/* partial reductions of every task */
+	int *partials;
+	/* registers after the last iteration */
+	int *last_regs;
+	std::atomic<int> failed;
+};
+
+static void kernel_loop_task(void *context, int task, int worker)
+{
+	KernelLoop *p = (KernelLoop*)context;
+	if (p->failed.load(std::memory_order_relaxed)) {
+		return;
+	}
+	const LoopKernel *k = p->kernel;
+	int n_regs = k->n_registers();
+	int *regs = p->regs + worker * n_regs;
+	int *partials = k->n_accumulators() > 0 ? p->partials + task * k->n_accumulators() : NULL;
+	std::copy(p->loaded, p->loaded + n_regs, regs);
+
+	int first = (int)(p->start + p->n * task / p->n_tasks);
+	int last = (int)(p->start + p->n * (task + 1) / p->n_tasks - 1);
+	long long stop;
+	if (p->batch) {
+		stop = k->run_batch(first, last, regs, p->scratch + worker * k->batch_scratch_size(), partials);
+	} else {
+		stop = k->run(first, last, regs, partials);
+	}
+	if (stop <= last) {
+		p->failed.store(1);
+		return;
+	}
+	if (task == p->n_tasks - 1) {
+		std::copy(regs, regs + n_regs, p->last_regs);
+	}
+}
+
+int Interpreter::execute_kernel_loop(LoopKernel *kernel, int start, int end, unsigned long long steps)
+{
+	KernelLoop p;
+	p.kernel = kernel;
+	p.start = start;
+	p.n = (long long)end - start + 1;
+	p.batch = _batch_loops;
+	int workers = 1;
+	p.n_tasks = 1;
+	if (_pool && p.n >= PARALLEL_MIN_ITERATIONS) {
+		workers = _pool->size();
+		long long tasks = p.n / PARALLEL_MIN_CHUNK;
+		long long max_tasks = (long long)workers * PARALLEL_TASKS_PER_WORKER;
+		p.n_tasks = (int)(tasks < 1 ? 1 : (tasks > max_tasks ? max_tasks : tasks));
+	}
+	int n_regs = kernel->n_registers();
+	int n_acc = kernel->n_accumulators();
+	int batch_size = p.batch ? kernel->batch_scratch_size() : 0;
+	/* one block for everything, its capacity is kept between loops */
+	size_t size = n_regs * (2 + workers) + batch_size * workers + n_acc * p.n_tasks +
+		kernel->closed_form_scratch_size() + 1;
+	if (_kernel_buffer.size() < size) {
+		_kernel_buffer.resize(size);
+	}
+	p.loaded = &_kernel_buffer[0];
+	p.last_regs = p.loaded + n_regs;
+	p.regs = p.last_regs + n_regs;
+	p.scratch = p.regs + n_regs * workers;
+	p.partials = p.scratch + batch_size * workers;
+	int *closed_form_scratch = p.partials + n_acc * p.n_tasks;
+	kernel->load(p.loaded, _int_values, _bool_values);
+
+	if (_closed_form_loops && kernel->closed_form(start, end, p.loaded, n_acc > 0 ? p.partials : NULL,
+		p.last_regs, closed_form_scratch)) {
+		kernel->store(n_acc > 0 ? p.partials : NULL, p.last_regs, (int)((unsigned int)end + 1),
+			_int_values, _bool_values);
+		return 0;
+	}
+	if (charge_steps(steps)) {
+		return BUDGET_EXCEEDED;
+	}
+
+	for (int t=0; t < p.n_tasks && n_acc > 0; ++t) {
+		kernel->init_partials(p.partials + t * n_acc);
+	}
+	p.failed.store(0);
+
+	if (workers > 1) {
+		_pool->run(p.n_tasks, kernel_loop_task, &p);
+	} else {
+		kernel_loop_task(&p, 0, 0);
+	}
+
+	if (p.failed.load()) {
+		_output.write_format("\nERROR: Interpreter::execute_assert - Assert returned false. Cannot continue.\n");
 		return 1;
 	}
 
+	/* merge partial reductions in iteration order */
+	for (int t=1; t < p.n_tasks && n_acc > 0; ++t) {
+		kernel->merge_partials(p.partials, p.partials + t * n_acc);
+	}
+	/* loop variable ends one past the range, like the sequential loop */
+	kernel->store(n_acc > 0 ? p.partials : NULL, p.last_regs, (int)((unsigned int)end + 1),
+		_int_values, _bool_values);
+	return 0;
+}
+
+void Interpreter::set_flush_policy(OutputBuffer::FLUSH_POLICY policy, size_t threshold)
+{
+	_output.set_policy(policy, threshold);
+}
+
+int Interpreter::execute_var_init(ASTNode *node)
+{
 	Symbol s;
+	size_t n_slots;
 	switch (node->children[0]->variable_type) {
 		case ASTVariable::INTEGER:
 			s.type = Symbol::VARIABLE_INT;
-			s.location = _int_values.size();
-			_int_values.push_back(0);
-			_symbol_table.push(node->children[0]->value, s);
+			n_slots = _int_values.size();
 			break;
 		case ASTVariable::STRING:
 			s.type = Symbol::VARIABLE_STRING;
-			s.location = _string_values.size();
-			_string_values.push_back("");
-			_symbol_table.push(node->children[0]->value, s);	
+			n_slots = _string_values.size();
 			break;
 		case ASTVariable::BOOLEAN:
 			s.type = Symbol::VARIABLE_BOOL;
-			s.location = _bool_values.size();
-			_bool_values.push_back(0);
-			_symbol_table.push(node->children[0]->value, s);
+			n_slots = _bool_values.size();
 			break;
 		default:
-			printf("\nERROR: Interpreter::execute_var_init - Variable type is not valid.\n");
+			_output.write_format("\nERROR: Interpreter::execute_var_init - Variable type is not valid.\n");
 			return 1;
 	}
+	s.location = node->slot;
+	if (s.location < 0 || (size_t)s.location >= n_slots) {
+		_output.write_format("\nERROR: Interpreter::execute_var_init - Identifier %s has no slot.\n", node->children[0]->value.c_str());
+		return 1;
+	}
+
+	/* the same declaration runs again on every iteration of its block */
+	Symbol old = _symbol_table.find(node->children[0]->symbol);
+	if (old.type != Symbol::UNDEFINED && (old.type != s.type || old.location != s.location)) {
+		_output.write_format("\nERROR: Interpreter::execute_var_init - Identifier %s is already initialized.\n", node->children[0]->value.c_str());
+		return 1;
+	}
+
+	switch (s.type) {
+		case Symbol::VARIABLE_INT:
+			_int_values[s.location] = 0;
+			break;
+		case Symbol::VARIABLE_STRING:
+			_string_values[s.location].clear();
+			break;
+		default:
+			_bool_values[s.location] = 0;
+	}
+	_symbol_table.push(node->children[0]->symbol, s);
 	return 0;
 }
 
 int Interpreter::execute_insert(ASTNode *node)
 {
 	/* children[0] == id_node */
-	Symbol s = _symbol_table.find(node->children[0]->value);
+	Symbol s = _symbol_table.find(node->children[0]->symbol);
 	if (s.type == Symbol::UNDEFINED) {
-		printf("\nERROR: Interpreter::execute_insert - Identifier %s is not initialized.\n", node->children[0]->value.c_str());
+		_output.write_format("\nERROR: Interpreter::execute_insert - Identifier %s is not initialized.\n", node->children[0]->value.c_str());
 		return 1;
 	}
 
 	Symbol s2;
+	ASTNode *op;
 	switch (node->children[1]->type) {
 		case ASTNode::OPERATOR:
 			switch (s.type) {
@@ -96,27 +487,38 @@ int Interpreter::execute_insert(ASTNode *node)
 					_int_values[s.location] = int_calc_op(node->children[1]);
 					break;
 				case Symbol::VARIABLE_STRING:
-					_string_values[s.location] = string_calc_op(node->children[1]);
+					op = node->children[1];
+					if (op->operator_type == ASTOperator::ADD &&
+						op->children[0]->type == ASTNode::VAR_ID &&
+						op->children[0]->symbol == node->children[0]->symbol &&
+						!refers_to(op->children[1], node->children[0]->symbol)) {
+						/* s := s + <expr>: append in place */
+						string_for_op(op->children[1], _string_values[s.location]);
+					} else {
+						_string_scratch.clear();
+						string_calc_op(op, _string_scratch);
+						_string_values[s.location].assign(_string_scratch);
+					}
 					break;
 				case Symbol::VARIABLE_BOOL:
 					_bool_values[s.location] = bool_calc_op(node->children[1]);
 					break;
 				default:
-					printf("\nERROR: Interpreter::execute_insert - Identifier typing error.\n");
+					_output.write_format("\nERROR: Interpreter::execute_insert - Identifier typing error.\n");
 					return 1;
 			}
 			break;
 		case ASTNode::UNARY_OP:
 			if (s.type != Symbol::VARIABLE_BOOL) {
-				printf("\nERROR: Interpreter::execute_insert - Unary operator '!' for non-boolean variable is not allowed.\n");
+				_output.write_format("\nERROR: Interpreter::execute_insert - Unary operator '!' for non-boolean variable is not allowed.\n");
 				return 1;
 			}
 			_bool_values[s.location] = calc_unary_op(node->children[1]);
 			break;
 		case ASTNode::VAR_ID:
-			s2 = _symbol_table.find(node->children[1]->value);
+			s2 = _symbol_table.find(node->children[1]->symbol);
 			if (s.type != s2.type) {
-				printf("\nERROR: Interpreter::execute_insert - Identifier type miss match for identifiers %s and %s.\n",
+				_output.write_format("\nERROR: Interpreter::execute_insert - Identifier type miss match for identifiers %s and %s.\n",
 					node->children[0]->value.c_str(), node->children[1]->value.c_str());
 				return 1;
 			}
@@ -131,25 +533,25 @@ int Interpreter::execute_insert(ASTNode *node)
 					_bool_values[s.location] = _bool_values[s2.location];
 					break;
 				default:
-					printf("\nERROR: Interpreter::execute_insert - Identifier typing error.\n");
+					_output.write_format("\nERROR: Interpreter::execute_insert - Identifier typing error.\n");
 					return 1;
 			}
 			break;
 		case ASTNode::CONSTANT:
 			switch (s.type) {
 				case Symbol::VARIABLE_INT:
-					_int_values[s.location] = to_int(node->children[1]->value);
+					_int_values[s.location] = constant_int(node->children[1]);
 					break;
 				case Symbol::VARIABLE_STRING:
 					_string_values[s.location] = node->children[1]->value;
 					break;
 				default:
-					printf("\nERROR: Interpreter::execute_insert - Cannot insert constant into bool value.\n");
+					_output.write_format("\nERROR: Interpreter::execute_insert - Cannot insert constant into bool value.\n");
 					return 1;
 			}
 			break;
 		default:
-			printf("\nERROR: Interpereter::execute_var_init - Insert statement is not valid.\n");
+			_output.write_format("\nERROR: Interpereter::execute_var_init - Insert statement is not valid.\n");
 			return 1;
 	}
 
@@ -162,9 +564,9 @@ int Interpreter::execute_for_loop(ASTNode *node)
 
 	/* in_node */
 	ASTNode *in_node = node->children[0];
-	Symbol s = _symbol_table.find(in_node->children[0]->value);
+	Symbol s = _symbol_table.find(in_node->children[0]->symbol);
 	if (s.type != Symbol::VARIABLE_INT) {
-		printf("\nERROR: Interpreter::execute_for_loop - Identifier %s not found or wrong typing.\n",
+		_output.write_format("\nERROR: Interpreter::execute_for_loop - Identifier %s not found or wrong typing.\n",
 			in_node->children[0]->value.c_str());
 		return 1;
 	}
@@ -175,18 +577,18 @@ int Interpreter::execute_for_loop(ASTNode *node)
 			start = int_calc_op(in_node->children[1]);			
 			break;
 		case ASTNode::VAR_ID:
-			s2 = _symbol_table.find(in_node->children[1]->value);
+			s2 = _symbol_table.find(in_node->children[1]->symbol);
 			if (s2.type != Symbol::VARIABLE_INT) {
-				printf("\nERROR: Interpreter::execute_for_loop - Identifier %s not found or wrong typing.\n",
+				_output.write_format("\nERROR: Interpreter::execute_for_loop - Identifier %s not found or wrong typing.\n",
 					in_node->children[1]->value.c_str());
 			}
 			start = _int_values[s2.location];
 			break;
 		case ASTNode::CONSTANT:
-			start = to_int(in_node->children[1]->value);
+			start = constant_int(in_node->children[1]);
 			break;
 		default:
-			printf("\nERROR: Interpreter::execute_for_loop - Invalid range type for FOR_LOOP.\n");
+			_output.write_format("\nERROR: Interpreter::execute_for_loop - Invalid range type for FOR_LOOP.\n");
 			return 1;
 	}
 	/* end */
@@ -195,26 +597,39 @@ int Interpreter::execute_for_loop(ASTNode *node)
 			end = int_calc_op(in_node->children[2]);			
 			break;
 		case ASTNode::VAR_ID:
-			s2 = _symbol_table.find(in_node->children[2]->value);
+			s2 = _symbol_table.find(in_node->children[2]->symbol);
 			if (s2.type != Symbol::VARIABLE_INT) {
-				printf("\nERROR: Interpreter::execute_for_loop - Identifier %s not found or wrong typing.\n",
+				_output.write_format("\nERROR: Interpreter::execute_for_loop - Identifier %s not found or wrong typing.\n",
 					in_node->children[2]->value.c_str());
 			}
 			end = _int_values[s2.location];
 			break;
 		case ASTNode::CONSTANT:
-			end = to_int(in_node->children[2]->value);
+			end = constant_int(in_node->children[2]);
 			break;
 		default:
-			printf("\nERROR: Interpreter::execute_for_loop - Invalid range type for FOR_LOOP.\n");
+			_output.write_format("\nERROR: Interpreter::execute_for_loop - Invalid range type for FOR_LOOP.\n");
 			return 1;
 	}
 
 	if (end < start) {
-		printf("\nERROR: Interpreter::execute_for_loop - Invalid range defined %d..%d\n", start, end);
+		_output.write_format("\nERROR: Interpreter::execute_for_loop - Invalid range defined %d..%d\n", start, end);
 		return 1;
 	}
 
+	/* independent iterations run as a kernel, in SIMD batches and/or
+	 * on the thread pool */
+	long long n_iterations = (long long)end - start + 1;
+	_loop_iterations += n_iterations;
+	if ((_pool && n_iterations >= PARALLEL_MIN_ITERATIONS) ||
+		((_batch_loops || _closed_form_loops) && n_iterations >= KERNEL_MIN_ITERATIONS)) {
+		LoopKernel *kernel = loop_kernel(node);
+		if (kernel) {
+			return execute_kernel_loop(kernel, start, end,
+				(unsigned long long)n_iterations * node->children[1]->children.size());
+		}
+	}
+
 	/* DO-PART */
 	ASTNode *do_node = node->children[1];
 	int r = 0;
@@ -225,70 +640,68 @@ int Interpreter::execute_for_loop(ASTNode *node)
 		/* set identifier value */
 		_int_values[s.location] = i;
 
-		for (int i=0; i < do_node->children.size(); ++i) {
+		for (size_t i=0; i < do_node->children.size(); ++i) {
 			if (r != 0) {
 				/* error -> exit with error code */
 				return r;
 			}
-			switch (do_node->children[i]->type) {
-				case ASTNode::INSERT:
-					r = execute_insert(do_node->children[i]);
-					break;
-				case ASTNode::FOR_LOOP:
-					r = execute_for_loop(do_node->children[i]);
-					break;
-				case ASTNode::VAR_INIT:
-					r = execute_var_init(do_node->children[i]);
-					break;
-				case ASTNode::READ:
-					r = execute_read(do_node->children[i]);
-					break;
-				case ASTNode::PRINT:
-					r = execute_print(do_node->children[i]);
-					break;
-				case ASTNode::ASSERT:
-					r = execute_assert(do_node->children[i]);
-					break;
-				default:
-					printf("\nERROR: Interpreter::execute_for_loop - Invalid statement.\n");
-					r = 1;
-			}
+			r = execute_stmt(do_node->children[i], "execute_for_loop", "Invalid statement");
 		}
 	}
 	/* according to example program, there should be last ++ for identifier variable */
 	_int_values[s.location] = i;
+	leave_block(do_node);
 
-	return 0;
+	/* error in the last statement of the last iteration, the enclosing
+	 * block must not go on */
+	return r;
+}
+
+void Interpreter::leave_block(ASTNode *do_node)
+{
+	for (size_t i=0; i < do_node->children.size(); ++i) {
+		if (do_node->children[i]->type == ASTNode::VAR_INIT) {
+			_symbol_table.pop(do_node->children[i]->children[0]->symbol);
+		}
+	}
 }
 
 int Interpreter::execute_read(ASTNode *node)
 {
 	if (node->children[0]->type != ASTNode::VAR_ID) {
-		printf("\nERROR: Interpreter::execute_read - Invalid read statement.\n");
+		_output.write_format("\nERROR: Interpreter::execute_read - Invalid read statement.\n");
 		return 1;
 	}
-	Symbol s = _symbol_table.find(node->children[0]->value);
+	Symbol s = _symbol_table.find(node->children[0]->symbol);
+	_output.before_read();
 	
-	int i;
-	std::string str;
+	InputReader::RESULT r = InputReader::READ_OK;
 	switch (s.type) {
 		case Symbol::VARIABLE_INT:
-			std::cin >> i;
-			_int_values[s.location] = i;
+			r = _input.read_int(&_int_values[s.location]);
 			break;
 		case Symbol::VARIABLE_STRING:
-			std::cin >> str;
-			_string_values[s.location] = str;
+			r = _input.read_word(_string_values[s.location]);
 			break;
 		case Symbol::VARIABLE_BOOL:
-			printf("\nERROR: Interpreter::execute_read - Boolean type identifier cannot be used in read statement.\n");
+			_output.write_format("\nERROR: Interpreter::execute_read - Boolean type identifier cannot be used in read statement.\n");
 			return 1;
 			break;
 		default:
-			printf("\nERROR: Interpreter::execute_read - Identifier %s not initialized.\n", node->children[0]->value.c_str());
+			_output.write_format("\nERROR: Interpreter::execute_read - Identifier %s not initialized.\n", node->children[0]->value.c_str());
 			return 1;
 	}
 
+	if (r == InputReader::READ_EOF) {
+		_output.write_format("\nERROR: Interpreter::execute_read - Unexpected end of input for %s.\n",
+			node->children[0]->value.c_str());
+		return 1;
+	} else if (r == InputReader::READ_INVALID) {
+		_output.write_format("\nERROR: Interpreter::execute_read - Invalid integer input '%s' for %s.\n",
+			_input.last_token().c_str(), node->children[0]->value.c_str());
+		return 1;
+	}
+
 	return 0;
 }
 
@@ -299,60 +712,69 @@ int Interpreter::execute_print(ASTNode *node)
 	switch (node->children[0]->type) {
 		case ASTNode::UNARY_OP:
 			if (calc_unary_op(node->children[0])) {
-				printf("true");
+				_output.write("true", 4);
 			} else {
-				printf("false");
+				_output.write("false", 5);
 			}
 			break;
 		case ASTNode::OPERATOR:
 			t = op_var_typing(node->children[0]);
 			switch (t) {
 				case ASTVariable::INTEGER:
-					printf("%d", int_calc_op(node->children[0]));
+					_output.write_int(int_calc_op(node->children[0]));
 					break;
 				case ASTVariable::STRING:
-					printf("%s", string_calc_op(node->children[0]).c_str());
+					/* the pieces are printed as they are evaluated, none of
+					 * them may be output if a later one fails */
+					_output.hold();
+					try {
+						print_string_calc_op(node->children[0]);
+					} catch (...) {
+						_output.drop_held();
+						throw;
+					}
+					_output.release();
 					break;
 				case ASTVariable::BOOLEAN:
 					if (bool_calc_op(node->children[0])) {
-						printf("true");
+						_output.write("true", 4);
 					} else {
-						printf("false");
+						_output.write("false", 5);
 					}
 					break;
 				default:
-					printf("\nERROR: Interpreter::execute_print - Could not define typing for operator.\n");
+					_output.write_format("\nERROR: Interpreter::execute_print - Could not define typing for operator.\n");
 					return 1;
 			}
 
 			break;
 		case ASTNode::VAR_ID:
-			s = _symbol_table.find(node->children[0]->value);
+			s = _symbol_table.find(node->children[0]->symbol);
 			switch (s.type) {
 				case Symbol::VARIABLE_INT:
-					printf("%d", _int_values[s.location]);
+					_output.write_int(_int_values[s.location]);
 					break;
 				case Symbol::VARIABLE_STRING:
-					printf("%s", _string_values[s.location].c_str());
+					_output.write(_string_values[s.location]);
 					break;
 				case Symbol::VARIABLE_BOOL:
 					if (_bool_values[s.location]) {
-						printf("true");
+						_output.write("true", 4);
 					} else {
-						printf("false");
+						_output.write("false", 5);
 					}
 					break;
 				default:
-					printf("\nERROR: Interpreter::execute_print - Identifier %s is not initialized.\n",
+					_output.write_format("\nERROR: Interpreter::execute_print - Identifier %s is not initialized.\n",
 						node->children[0]->value.c_str());
 					return 1;
 			}
 			break;
 		case ASTNode::CONSTANT:
-			printf("%s", node->children[0]->value.c_str());
+			_output.write(node->children[0]->value);
 			break;
 		default:
-			printf("\nERROR: Interpreter::execute_print - Invalid print statement.\n");
+			_output.write_format("\nERROR: Interpreter::execute_print - Invalid print statement.\n");
 			return 1;
 	}
 
@@ -375,9 +797,9 @@ int Interpreter::execute_assert(ASTNode *node)
 			}
 			break;
 		case ASTNode::VAR_ID:
-			s = _symbol_table.find(node->children[0]->value);
+			s = _symbol_table.find(node->children[0]->symbol);
 			if (s.type != Symbol::VARIABLE_BOOL) {
-				printf("\nERROR: Interpreter::execute_assert - %s is non-bool identifier or identifier not initialized.\n",
+				_output.write_format("\nERROR: Interpreter::execute_assert - %s is non-bool identifier or identifier not initialized.\n",
 					node->children[0]->value.c_str());
 				return 1;
 			}
@@ -386,12 +808,12 @@ int Interpreter::execute_assert(ASTNode *node)
 			}
 			break;
 		default:
-			printf("\nERROR: Interpreter::execute_assert - Assert statement is not valid.\n");
+			_output.write_format("\nERROR: Interpreter::execute_assert - Assert statement is not valid.\n");
 			return 1;
 	}
 
 	if (fail) {
-		printf("\nERROR: Interpreter::execute_assert - Assert returned false. Cannot continue.\n");
+		_output.write_format("\nERROR: Interpreter::execute_assert - Assert returned false. Cannot continue.\n");
 		return 1;
 	}
 
@@ -400,7 +822,26 @@ int Interpreter::execute_assert(ASTNode *node)
 
 int Interpreter::int_calc_op(ASTNode *node)
 {
+	if (_profiler) {
+		_profiler->enter(node);
+		int result = eval_int_op(node);
+		_profiler->leave();
+		return result;
+	}
+	return eval_int_op(node);
+}
+
+int Interpreter::eval_int_op(ASTNode *node)
+{
+	if (node->height > ASTNode::RECURSIVE_HEIGHT) {
+		return eval_deep(node, DEEP_INT, NULL);
+	}
 	int result = 0;
+	/* cached only for int operators, others raise their error below */
+	if (node->cache_slot >= 0 && node->operator_type <= ASTOperator::DIVIDE &&
+		cached(node, &result)) {
+		return result;
+	}
 	int left = int_for_op(node->children[0]);
 	int right = int_for_op(node->children[1]);
 	/* calculate */
@@ -423,31 +864,65 @@ int Interpreter::int_calc_op(ASTNode *node)
 		default:
 			throw std::invalid_argument("Non-valid operator for int return value.");
 	}
+	if (node->cache_slot >= 0) {
+		cache(node, result);
+	}
 	return result;
 }
 
-std::string Interpreter::string_calc_op(ASTNode *node)
+void Interpreter::string_calc_op(ASTNode *node, std::string &out)
+{
+	if (_profiler) {
+		_profiler->enter(node);
+		eval_string_op(node, out);
+		_profiler->leave();
+		return;
+	}
+	eval_string_op(node, out);
+}
+
+void Interpreter::eval_string_op(ASTNode *node, std::string &out)
 {
-	std::string result = "";
-	std::string left = string_for_op(node->children[0]);
-	std::string right = string_for_op(node->children[1]);
+	if (node->height > ASTNode::RECURSIVE_HEIGHT) {
+		eval_deep(node, DEEP_STRING, &out);
+		return;
+	}
 	/* calculate */
 	switch (node->operator_type) {
 		case ASTOperator::ADD:
-			result.append(left);
-			result.append(right);
+			string_for_op(node->children[0], out);
+			string_for_op(node->children[1], out);
 			break;
 		default:
 			throw std::invalid_argument("Non-valid operator for int return value.");
 	}
-	return result;
 }
 
 int Interpreter::bool_calc_op(ASTNode *node)
 {
+	if (_profiler) {
+		_profiler->enter(node);
+		int result = eval_bool_op(node);
+		_profiler->leave();
+		return result;
+	}
+	return eval_bool_op(node);
+}
+
+int Interpreter::eval_bool_op(ASTNode *node)
+{
+	if (node->height > ASTNode::RECURSIVE_HEIGHT) {
+		return eval_deep(node, DEEP_BOOL, NULL);
+	}
 	int result = 0;
-	
+
+	if (node->cache_slot >= 0 && node->operator_type >= ASTOperator::LESS_THAN &&
+		cached(node, &result)) {
+		return result;
+	}
 	int left = 0, right = 0;
+	/* string operands are evaluated left first, as eval_deep does */
+	const std::string *left_str = NULL;
 	ASTVariable::TYPE t = op_var_typing(node);
 	/* calculate */
 	switch (node->operator_type) {
@@ -462,7 +937,8 @@ int Interpreter::bool_calc_op(ASTNode *node)
 					result = (int_for_op(node->children[0]) == int_for_op(node->children[1]));
 					break;
 				case ASTVariable::STRING:
-					result = (string_for_op(node->children[0]) == string_for_op(node->children[1]));
+					left_str = &string_ref_op(node->children[0], _cmp_left);
+					result = (*left_str == string_ref_op(node->children[1], _cmp_right));
 					break;
 				case ASTVariable::BOOLEAN:
 					left = bool_for_op(node->children[0]);
@@ -488,7 +964,8 @@ int Interpreter::bool_calc_op(ASTNode *node)
 					result = (int_for_op(node->children[0]) != int_for_op(node->children[1]));
 					break;
 				case ASTVariable::STRING:
-					result = (string_for_op(node->children[0]) != string_for_op(node->children[1]));
+					left_str = &string_ref_op(node->children[0], _cmp_left);
+					result = (*left_str != string_ref_op(node->children[1], _cmp_right));
 					break;
 				case ASTVariable::BOOLEAN:
 					left = bool_for_op(node->children[0]);
@@ -506,13 +983,237 @@ int Interpreter::bool_calc_op(ASTNode *node)
 		default:
 			throw std::invalid_argument("Non-valid operator for bool return value.");
 	}
+	if (node->cache_slot >= 0) {
+		cache(node, result);
+	}
 
 	return result;
 }
 
 int Interpreter::calc_unary_op(ASTNode *node)
-{	
-	return (!bool_for_op(node->children[0]));
+{
+	if (_profiler) {
+		_profiler->enter(node);
+		int result = eval_unary_op(node);
+		_profiler->leave();
+		return result;
+	}
+	return eval_unary_op(node);
+}
+
+int Interpreter::eval_unary_op(ASTNode *node)
+{
+	if (node->height > ASTNode::RECURSIVE_HEIGHT) {
+		return eval_deep(node, DEEP_BOOL, NULL);
+	}
+	int result;
+	if (node->cache_slot >= 0 && cached(node, &result)) {
+		return result;
+	}
+	result = !bool_for_op(node->children[0]);
+	if (node->cache_slot >= 0) {
+		cache(node, result);
+	}
+	return result;
+}
+
+int Interpreter::eval_deep(ASTNode *node, DEEP_MODE mode, std::string *out)
+{
+	_deep_stack.clear();
+	DeepFrame root;
+	root.node = node;
+	root.mode = mode;
+	root.operand_mode = mode;
+	root.step = 0;
+	root.left = 0;
+	root.out = out;
+	root.left_ref = NULL;
+	root.right_ref = NULL;
+	_deep_stack.push_back(root);
+
+	/* value of the last frame done */
+	int value = 0;
+	while (!_deep_stack.empty()) {
+		DeepFrame &f = _deep_stack.back();
+		ASTNode *n = f.node;
+		int result = 0;
+		int done = 0;
+		if (f.step == 0) {
+			/* cached values, and errors raised before evaluating operands */
+			switch (f.mode) {
+				case DEEP_INT:
+					done = (n->cache_slot >= 0 && n->operator_type <= ASTOperator::DIVIDE &&
+						cached(n, &result));
+					break;
+				case DEEP_BOOL:
+					if (n->type == ASTNode::UNARY_OP) {
+						done = (n->cache_slot >= 0 && cached(n, &result));
+						break;
+					}
+					if (n->cache_slot >= 0 && n->operator_type >= ASTOperator::LESS_THAN &&
+						cached(n, &result)) {
+						done = 1;
+						break;
+					}
+					switch (n->operator_type) {
+						case ASTOperator::LESS_THAN:
+							f.operand_mode = DEEP_INT;
+							break;
+						case ASTOperator::EQUALS:
+						case ASTOperator::NOT:
+							switch (op_var_typing(n)) {
+								case ASTVariable::INTEGER:
+									f.operand_mode = DEEP_INT;
+									break;
+								case ASTVariable::STRING:
+									f.operand_mode = DEEP_STRING_REF;
+									break;
+								case ASTVariable::BOOLEAN:
+									f.operand_mode = DEEP_BOOL;
+									break;
+								default:
+									if (n->operator_type == ASTOperator::EQUALS) {
+										throw std::invalid_argument("Non-valid type for operator EQUALS.");
+									}
+									throw std::invalid_argument("Non-valid type for operator NOT.");
+							}
+							break;
+						case ASTOperator::AND:
+							f.operand_mode = DEEP_BOOL;
+							break;
+						default:
+							throw std::invalid_argument("Non-valid operator for bool return value.");
+					}
+					break;
+				default:
+					if (n->operator_type != ASTOperator::ADD) {
+						throw std::invalid_argument("Non-valid operator for int return value.");
+					}
+			}
+			if (done) {
+				/* cached, nothing to cache again */
+				value = result;
+				_deep_stack.pop_back();
+				continue;
+			}
+		} else if (f.step == 1) {
+			f.left = value;
+			if (n->type == ASTNode::UNARY_OP) {
+				result = !value;
+				done = 1;
+			} else if (f.mode == DEEP_BOOL && n->operator_type == ASTOperator::AND && !value) {
+				result = 0;
+				done = 1;
+			}
+		} else {
+			done = 1;
+			if (f.mode == DEEP_INT) {
+				switch (n->operator_type) {
+					case ASTOperator::ADD:
+						result = f.left + value;
+						break;
+					case ASTOperator::SUBTRACT:
+						result = f.left - value;
+						break;
+					case ASTOperator::MULTIPLY:
+						result = f.left * value;
+						break;
+					case ASTOperator::DIVIDE:
+						if (value == 0) {
+							throw std::invalid_argument("Cannot divide by zero.");
+						}
+						result = f.left / value;
+						break;
+					default:
+						throw std::invalid_argument("Non-valid operator for int return value.");
+				}
+			} else if (f.mode == DEEP_BOOL) {
+				int equal;
+				switch (f.operand_mode) {
+					case DEEP_STRING_REF:
+						equal = (*f.left_ref == *f.right_ref);
+						break;
+					case DEEP_BOOL:
+						equal = ((f.left && value) || !(f.left || value));
+						break;
+					default:
+						equal = (f.left == value);
+				}
+				switch (n->operator_type) {
+					case ASTOperator::LESS_THAN:
+						result = (f.left < value);
+						break;
+					case ASTOperator::EQUALS:
+						result = equal;
+						break;
+					case ASTOperator::NOT:
+						result = !equal;
+						break;
+					default:
+						/* AND with left operand true */
+						result = (value != 0);
+				}
+			}
+		}
+		if (done) {
+			if (n->cache_slot >= 0 && (f.mode == DEEP_INT || f.mode == DEEP_BOOL)) {
+				cache(n, result);
+			}
+			value = result;
+			_deep_stack.pop_back();
+			continue;
+		}
+
+		/* evaluate next operand, f is not valid after a push */
+		ASTNode *operand = n->children[f.step];
+		++f.step;
+		if (f.operand_mode == DEEP_STRING_REF) {
+			std::string &scratch = (f.step == 1) ? _cmp_left : _cmp_right;
+			const std::string **ref = (f.step == 1) ? &f.left_ref : &f.right_ref;
+			if (operand->height > ASTNode::RECURSIVE_HEIGHT && operand->type == ASTNode::OPERATOR) {
+				scratch.clear();
+				*ref = &scratch;
+				deep_operand(operand, DEEP_STRING, &scratch, &value);
+			} else {
+				*ref = &string_ref_op(operand, scratch);
+			}
+			continue;
+		}
+		deep_operand(operand, f.operand_mode, f.out, &value);
+	}
+	return value;
+}
+
+int Interpreter::deep_operand(ASTNode *node, DEEP_MODE mode, std::string *out, int *value)
+{
+	if (node->height > ASTNode::RECURSIVE_HEIGHT && (node->type == ASTNode::OPERATOR ||
+		(mode == DEEP_BOOL && node->type == ASTNode::UNARY_OP))) {
+		DeepFrame f;
+		f.node = node;
+		f.mode = mode;
+		f.operand_mode = mode;
+		f.step = 0;
+		f.left = 0;
+		f.out = out;
+		f.left_ref = NULL;
+		f.right_ref = NULL;
+		_deep_stack.push_back(f);
+		return 1;
+	}
+	switch (mode) {
+		case DEEP_INT:
+			*value = int_for_op(node);
+			break;
+		case DEEP_BOOL:
+			*value = bool_for_op(node);
+			break;
+		case DEEP_STRING:
+			string_for_op(node, *out);
+			break;
+		default:
+			print_string_for_op(node);
+	}
+	return 0;
 }
 
 int Interpreter::int_for_op(ASTNode *node)
@@ -526,7 +1227,7 @@ int Interpreter::int_for_op(ASTNode *node)
 			result = int_calc_op(node);
 			break;
 		case ASTNode::VAR_ID:
-			s = _symbol_table.find(node->value);
+			s = _symbol_table.find(node->symbol);
 			if (s.type != Symbol::VARIABLE_INT) {
 				e_str = "Identifier ";
 				e_str.append(node->value);
@@ -536,7 +1237,7 @@ int Interpreter::int_for_op(ASTNode *node)
 			result = _int_values[s.location];
 			break;
 		case ASTNode::CONSTANT:
-			result = to_int(node->value);
+			result = constant_int(node);
 			break;
 		default:
 			throw std::invalid_argument("Invalid argument for operator.");
@@ -545,31 +1246,86 @@ int Interpreter::int_for_op(ASTNode *node)
 	return result;
 }
 
-std::string Interpreter::string_for_op(ASTNode *node)
+void Interpreter::string_for_op(ASTNode *node, std::string &out)
+{
+	Symbol s;
+	std::string e_str;
+	switch (node->type) {
+		case ASTNode::OPERATOR:
+			string_calc_op(node, out);
+			break;
+		case ASTNode::VAR_ID:
+			s = _symbol_table.find(node->symbol);
+			switch (s.type) {
+				case Symbol::VARIABLE_STRING:
+					out.append(_string_values[s.location]);
+					break;
+				case Symbol::VARIABLE_INT:
+					append_int(out, _int_values[s.location]);
+					break;
+				case Symbol::VARIABLE_BOOL:
+					/* bool values are not allowed in string expressions */
+				default:
+					e_str = "Identifier ";
+					e_str.append(node->value);
+					e_str.append(" not found.");
+					throw std::invalid_argument(e_str.c_str());
+			}
+			break;
+		case ASTNode::CONSTANT:
+			out.append(node->value);
+			break;
+		default:
+			throw std::invalid_argument("Invalid argument for operator.");
+	}
+}
+
+void Interpreter::print_string_calc_op(ASTNode *node)
 {
-	std::string result = "";
+	if (_profiler) {
+		_profiler->enter(node);
+		print_string_op(node);
+		_profiler->leave();
+		return;
+	}
+	print_string_op(node);
+}
 
+void Interpreter::print_string_op(ASTNode *node)
+{
+	if (node->height > ASTNode::RECURSIVE_HEIGHT) {
+		eval_deep(node, DEEP_PRINT, NULL);
+		return;
+	}
+	switch (node->operator_type) {
+		case ASTOperator::ADD:
+			print_string_for_op(node->children[0]);
+			print_string_for_op(node->children[1]);
+			break;
+		default:
+			throw std::invalid_argument("Non-valid operator for int return value.");
+	}
+}
+
+void Interpreter::print_string_for_op(ASTNode *node)
+{
 	Symbol s;
 	std::string e_str;
 	switch (node->type) {
 		case ASTNode::OPERATOR:
-			result = string_calc_op(node);
+			print_string_calc_op(node);
 			break;
 		case ASTNode::VAR_ID:
-			s = _symbol_table.find(node->value);
+			s = _symbol_table.find(node->symbol);
 			switch (s.type) {
 				case Symbol::VARIABLE_STRING:
-					result = _string_values[s.location];
+					_output.write(_string_values[s.location]);
 					break;
 				case Symbol::VARIABLE_INT:
-					result = to_string(_int_values[s.location]);
+					_output.write_int(_int_values[s.location]);
 					break;
 				case Symbol::VARIABLE_BOOL:
-					if (_bool_values[s.location]) {
-						result = "true";
-					} else {
-						result = "false";
-					}
+					/* bool values are not allowed in string expressions */
 				default:
 					e_str = "Identifier ";
 					e_str.append(node->value);
@@ -578,13 +1334,31 @@ std::string Interpreter::string_for_op(ASTNode *node)
 			}
 			break;
 		case ASTNode::CONSTANT:
-			result = node->value;
+			_output.write(node->value);
 			break;
 		default:
 			throw std::invalid_argument("Invalid argument for operator.");
 	}
+}
 
-	return result;
+const std::string &Interpreter::string_ref_op(ASTNode *node, std::string &scratch)
+{
+	Symbol s;
+	switch (node->type) {
+		case ASTNode::VAR_ID:
+			s = _symbol_table.find(node->symbol);
+			if (s.type == Symbol::VARIABLE_STRING) {
+				return _string_values[s.location];
+			}
+			break;
+		case ASTNode::CONSTANT:
+			return node->value;
+		default:
+			break;
+	}
+	scratch.clear();
+	string_for_op(node, scratch);
+	return scratch;
 }
 
 int Interpreter::bool_for_op(ASTNode *node)
@@ -601,7 +1375,7 @@ int Interpreter::bool_for_op(ASTNode *node)
 			result = bool_calc_op(node);
 			break;
 		case ASTNode::VAR_ID:
-			s = _symbol_table.find(node->value);
+			s = _symbol_table.find(node->symbol);
 			if (s.type != Symbol::VARIABLE_BOOL) {
 				e_str = "Identifier ";
 				e_str.append(node->value);
@@ -618,42 +1392,7 @@ int Interpreter::bool_for_op(ASTNode *node)
 	return result;
 }
 
-ASTVariable::TYPE Interpreter::op_var_typing(ASTNode *node)
-{
-	ASTVariable::TYPE t = ASTVariable::UNKNOWN;
-	ASTNode *n = node;
-	switch (node->children[0]->type) {
-		case ASTNode::OPERATOR:
-			n = node->children[0]->children[0];
-			while (n->type == ASTNode::OPERATOR) {
-				n = n->children[0];
-			}
-			switch (n->type) {
-				case ASTNode::UNARY_OP:
-					t = ASTVariable::BOOLEAN;
-					break;
-				case ASTNode::VAR_ID:
-				case ASTNode::CONSTANT:
-					t = n->variable_type;
-					break;
-				default:
-				t = ASTVariable::UNKNOWN;
-			}
-			break;
-		case ASTNode::UNARY_OP:
-			t = ASTVariable::BOOLEAN;
-			break;
-		case ASTNode::VAR_ID:
-		case ASTNode::CONSTANT:
-			t = node->children[0]->variable_type;
-			break;
-		default:
-			t = ASTVariable::UNKNOWN;
-	}
-	return t;
-}
-
-int Interpreter::to_int(std::string str)
+int Interpreter::to_int(const std::string &str)
 {
 	const char *s = str.c_str();
 	if (*s == '\0') {
@@ -681,11 +1420,14 @@ int Interpreter::to_int(std::string str)
 	return neg ? r : -r;
 }
 
-std::string Interpreter::to_string(int val)
+int Interpreter::constant_int(ASTNode *node)
 {
-	char numstr[21]; // enough to hold all numbers up to 64-bits
-	sprintf(numstr, "%d", val);
-	return std::string(numstr);
+	if (node->variable_type == ASTVariable::INTEGER) {
+		return node->int_value;
+	}
+	/* string constant used as int */
+	return to_int(node->value);
 }
 
+
 } // namespace mpli
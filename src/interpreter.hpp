@@ -3,8 +3,18 @@
 
 #include "ast.hpp"
 #include "symbol_table.hpp"
+#include "output_buffer.hpp"
+#include "input_reader.hpp"
+#include "loop_kernel.hpp"
+#include "thread_pool.hpp"
+#include "optimizer.hpp"
+#include "ir.hpp"
+#include "profiler.hpp"
+#include "sampler.hpp"
+#include "stats.hpp"
 #include <vector>
 #include <string>
+#include <map>
 
 namespace mpli {
 
@@ -14,36 +24,227 @@ namespace mpli {
 class Interpreter {
 	private:
 		SymbolTable _symbol_table;
+		/* values by slot, sized by AST::frame_size() when a run starts */
 		std::vector<int> _int_values;
 		std::vector<int> _bool_values;
 		std::vector<std::string> _string_values;
 
+		/* Reusable scratch buffers for string evaluation. Their capacity is
+		 * kept between statements, so steady-state string expressions do not
+		 * allocate. */
+		std::string _string_scratch;
+		std::string _cmp_left;
+		std::string _cmp_right;
+
+		/* program output and diagnostics, in the order they happen */
+		OutputBuffer _output;
+		/* values for read statements */
+		InputReader _input;
+
+		/* Loops with at least this many iterations are considered for
+		 * parallel execution, each task gets at least PARALLEL_MIN_CHUNK
+		 * iterations. */
+		static const int PARALLEL_MIN_ITERATIONS = 4096;
+		static const int PARALLEL_MIN_CHUNK = 1024;
+		static const int PARALLEL_TASKS_PER_WORKER = 8;
+		/* sequential loops run as kernels from this many iterations */
+		static const int KERNEL_MIN_ITERATIONS = 64;
+
+		/* NULL when loops run sequentially */
+		ThreadPool *_pool;
+		/* run kernels LoopKernel::LANES iterations at a time */
+		int _batch_loops;
+		/* replace loops by closed-form results when possible */
+		int _closed_form_loops;
+		/* analysed FOR_LOOP nodes, NULL if not parallelizable */
+		std::map<ASTNode*, LoopKernel*> _loop_kernels;
+		/* registers, partials and scratch of the running kernel, kept
+		 * so that kernel loops do not allocate */
+		std::vector<int> _kernel_buffer;
+		/* serial of the AST whose nodes _loop_kernels refers to */
+		unsigned long long _kernels_ast;
+
+		/* Expression cache of Optimizer: a slot is valid while its epoch
+		 * equals the epoch of its scope, entering a scope bumps the scope
+		 * epoch. */
+		std::vector<int> _cache_values;
+		std::vector<unsigned long long> _cache_epochs;
+		std::vector<int> _cache_scopes;
+		std::vector<unsigned long long> _scope_epochs;
+		unsigned long long _epoch;
+
+		/* NULL when not profiling */
+		Profiler *_profiler;
+		/* NULL when not sampling */
+		Sampler *_sampler;
+		/* NULL when top-level statements are not measured */
+		Stats *_statement_stats;
+		/* attribute allocations to kinds of statements, see
+		 * set_allocation_tags */
+		int _tag_allocations;
+		/* any of profiler, sampler or allocation tags is on */
+		int _instrumented;
+		void update_instrumented();
+
+		/* statements executed so far and their limit, 0 = no limit */
+		unsigned long long _steps;
+		unsigned long long _step_budget;
+		/* loop iterations run so far, including those of kernels */
+		unsigned long long _loop_iterations;
+		/* count n statements, returns BUDGET_EXCEEDED when over budget */
+		int charge_steps(unsigned long long n);
+		/* get valid cached value of node, returns 0 if there is none */
+		int cached(ASTNode *node, int *value);
+		void cache(ASTNode *node, int value);
+
+		/* execute statements of AST root */
+		int execute_root(const AST *ast);
+		/* forget variables and cached values of an earlier run */
+		void reset(const AST *ast);
+		/* execute single statement, caller and invalid_msg for error message */
+		int execute_stmt(ASTNode *node, const char *caller, const char *invalid_msg);
+		/* execute_stmt with profiler, sampler and allocation tags */
+		int instrumented_stmt(ASTNode *node, const char *caller, const char *invalid_msg);
+		/* execute_stmt without instrumentation */
+		int dispatch_stmt(ASTNode *node, const char *caller, const char *invalid_msg);
+		/* kernel of FOR_LOOP node, NULL if iterations are not independent */
+		LoopKernel *loop_kernel(ASTNode *node);
+		/* Run start..end of kernel, on the thread pool if there is one.
+		 * steps is charged against the step budget unless the loop is
+		 * computed in closed form. */
+		int execute_kernel_loop(LoopKernel *kernel, int start, int end, unsigned long long steps);
+
 		/* return value: 0 = OK, 1 = Error */
 		int execute_var_init(ASTNode *node);
 		int execute_insert(ASTNode *node);
 		int execute_for_loop(ASTNode *node);
+		/* end scope of variables declared in FOR_DO block */
+		void leave_block(ASTNode *do_node);
 		int execute_read(ASTNode *node);
 		int execute_print(ASTNode *node);
 		int execute_assert(ASTNode *node);
 
 		/* Operator calculation functions */
 		int int_calc_op(ASTNode *node);
-		std::string string_calc_op(ASTNode *node);
+		/* appends result of string operator into out */
+		void string_calc_op(ASTNode *node, std::string &out);
 		int bool_calc_op(ASTNode *node);
 		int calc_unary_op(ASTNode *node);
+		/* The above without profiling. Profiled nodes are entered and left
+		 * explicitly, a scope guard would cost the unprofiled run too. */
+		int eval_int_op(ASTNode *node);
+		void eval_string_op(ASTNode *node, std::string &out);
+		int eval_bool_op(ASTNode *node);
+		int eval_unary_op(ASTNode *node);
+		void print_string_op(ASTNode *node);
+
+		/* Expressions higher than ASTNode::RECURSIVE_HEIGHT are evaluated
+		 * by eval_deep() with _deep_stack instead of the C++ stack; their
+		 * subtrees of at most that height are evaluated by the functions
+		 * above. Results and errors are the same, only the root is
+		 * profiled. */
+		enum DEEP_MODE {
+			/* value of int_for_op, bool_for_op */
+			DEEP_INT,
+			DEEP_BOOL,
+			/* string_for_op into out, print_string_for_op */
+			DEEP_STRING,
+			DEEP_PRINT,
+			/* operand of string comparison, see string_ref_op */
+			DEEP_STRING_REF
+		};
+		struct DeepFrame {
+			ASTNode *node;
+			DEEP_MODE mode;
+			/* mode of operands */
+			DEEP_MODE operand_mode;
+			/* operands evaluated so far */
+			int step;
+			int left;
+			std::string *out;
+			const std::string *left_ref;
+			const std::string *right_ref;
+		};
+		std::vector<DeepFrame> _deep_stack;
+		/* value of node in mode, out for DEEP_STRING */
+		int eval_deep(ASTNode *node, DEEP_MODE mode, std::string *out);
+		/* Evaluate operand in mode into *value or out. Returns 1 if it
+		 * is deep and was pushed on _deep_stack instead. */
+		int deep_operand(ASTNode *node, DEEP_MODE mode, std::string *out, int *value);
 
 		/* Operator left- and right-side parameter helper functions. */
 		int int_for_op(ASTNode *node);
-		std::string string_for_op(ASTNode *node);
+		/* appends string value of node into out */
+		void string_for_op(ASTNode *node, std::string &out);
+		/* Returns string value of node without copying when node is a
+		 * variable or constant, otherwise builds it into scratch. */
+		const std::string &string_ref_op(ASTNode *node, std::string &scratch);
+		/* Print string operator / operand piece by piece into output,
+		 * without building the concatenated string. */
+		void print_string_calc_op(ASTNode *node);
+		void print_string_for_op(ASTNode *node);
 		int bool_for_op(ASTNode *node);
-		ASTVariable::TYPE op_var_typing(ASTNode *node);
 
 		/* typecast functions */
-		int to_int(std::string str);
-		std::string to_string(int val);
+		int to_int(const std::string &str);
+		/* int value of CONSTANT node, pre-parsed for int constants */
+		int constant_int(ASTNode *node);
 	public:
-		/* Execute given AST. */
-		int execute(AST *ast);
+		/* return value of execute when step budget ran out */
+		static const int BUDGET_EXCEEDED = 2;
+
+		Interpreter();
+		~Interpreter();
+		/* Execute given AST. Every execution starts with no variables, so
+		 * one interpreter can run programs many times. Returns 0 on
+		 * success and 1 when a statement reported an error, after which
+		 * no further statement runs, as on the IR backend. */
+		int execute(const AST *ast);
+		/* Execute program lowered into IR, with the same input and output. */
+		int execute_ir(const IRFunction &fn);
+		/* Set when buffered output is written out, see OutputBuffer. */
+		void set_flush_policy(OutputBuffer::FLUSH_POLICY policy, size_t threshold);
+		/* Number of threads for loops with independent iterations,
+		 * 1 runs everything sequentially. */
+		void set_threads(int n);
+		/* Evaluate loops with independent iterations in SIMD batches,
+		 * enabled by default. */
+		void set_loop_batching(int enabled);
+		/* Compute loops such as sums over the loop variable in closed
+		 * form, enabled by default. */
+		void set_closed_form_loops(int enabled);
+		/* Use cache slots annotated by optimizer into the AST. */
+		void set_expression_cache(const Optimizer &optimizer);
+		/* Stop executing after given number of statements with
+		 * BUDGET_EXCEEDED, 0 for no limit. Loops computed in closed form
+		 * count as a single statement. */
+		void set_step_budget(unsigned long long steps);
+		/* Record statements and operators into profiler, NULL to stop.
+		 * Loops are best profiled without kernels, which run their
+		 * bodies as a whole. */
+		void set_profiler(Profiler *profiler);
+		/* Publish executing statements to sampler, NULL to stop. */
+		void set_sampler(Sampler *sampler);
+		/* Count allocations under tag 1 + ASTNode::TYPE of the statement
+		 * executing them, see Stats::set_allocation_tag. */
+		void set_allocation_tags(int enabled);
+		/* Measure every top-level statement as a phase of stats, named
+		 * by its position, NULL to stop. The last one is left running. */
+		void set_statement_stats(Stats *stats);
+		/* Statements and loop iterations run by the last execute(). A
+		 * loop run as a kernel counts every statement of every iteration,
+		 * one computed in closed form only the loop statement. */
+		unsigned long long steps();
+		unsigned long long loop_iterations();
+		/* Append program output into sink instead of stdout, see
+		 * OutputBuffer::capture. */
+		void capture_output(std::string *sink);
+		/* Write program output into fd, 1 by default. */
+		void set_output_fd(int fd);
+		/* Read input from fd, 0 by default. */
+		void set_input_fd(int fd);
+		/* Read input from memory, data must stay valid during execution. */
+		void set_input_data(const char *data, size_t size);
 };
 
 } // namespace mpli
@@ -0,0 +1,195 @@
+#include "ir.hpp"
+#include "int_conv.hpp"
+
+namespace mpli {
+
+IRInsn::IRInsn()
+{
+	op = CONST;
+	type = IR_VOID;
+	dst = -1;
+	imm = 0;
+}
+
+int IRInsn::is_pure() const
+{
+	switch (op) {
+		case DIV:
+		case PRINT:
+		case READ_INT:
+		case READ_STRING:
+		case CHECK_RANGE:
+		case ASSERT:
+			return 0;
+		default:
+			return 1;
+	}
+}
+
+IRBlock::IRBlock()
+{
+	exit = RETURN;
+	cond = -1;
+	target = -1;
+	other = -1;
+}
+
+int IRFunction::new_value(IRType type)
+{
+	value_types.push_back(type);
+	return value_types.size() - 1;
+}
+
+int IRFunction::new_block()
+{
+	blocks.push_back(IRBlock());
+	return blocks.size() - 1;
+}
+
+int IRFunction::n_insns() const
+{
+	int n = 0;
+	for (size_t b=0; b < blocks.size(); ++b) {
+		n += blocks[b].insns.size();
+	}
+	return n;
+}
+
+/* final replacement of v, shortening chains on the way */
+static int resolve(std::vector<int> &replace, int v)
+{
+	if (v < 0 || replace[v] == v) {
+		return v;
+	}
+	replace[v] = resolve(replace, replace[v]);
+	return replace[v];
+}
+
+void IRFunction::replace_uses(std::vector<int> &replace)
+{
+	for (size_t b=0; b < blocks.size(); ++b) {
+		IRBlock &block = blocks[b];
+		for (size_t i=0; i < block.insns.size(); ++i) {
+			std::vector<int> &args = block.insns[i].args;
+			for (size_t a=0; a < args.size(); ++a) {
+				args[a] = resolve(replace, args[a]);
+			}
+		}
+		block.cond = resolve(replace, block.cond);
+	}
+	for (size_t l=0; l < loops.size(); ++l) {
+		loops[l].counter = resolve(replace, loops[l].counter);
+		loops[l].next = resolve(replace, loops[l].next);
+	}
+}
+
+void IRFunction::remove_values(const std::vector<char> &dead)
+{
+	for (size_t b=0; b < blocks.size(); ++b) {
+		std::vector<IRInsn> &insns = blocks[b].insns;
+		size_t n = 0;
+		for (size_t i=0; i < insns.size(); ++i) {
+			if (insns[i].dst >= 0 && dead[insns[i].dst]) {
+				continue;
+			}
+			if (n != i) {
+				insns[n] = insns[i];
+			}
+			++n;
+		}
+		insns.resize(n);
+	}
+}
+
+static void append_value(std::string &out, int v)
+{
+	out.append("%");
+	append_int(out, v);
+}
+
+void IRFunction::dump(std::string &out) const
+{
+	const char *ops[] = {
+		"const", "const", "copy", "phi", "add", "sub", "mul", "div", "shl",
+		"lt", "eq", "ne", "str_eq", "str_ne", "and", "not", "to_string",
+		"concat", "print", "read_int", "read_string", "check_range", "assert"
+	};
+	const char *types[] = { "void", "int", "bool", "string" };
+
+	for (size_t b=0; b < blocks.size(); ++b) {
+		const IRBlock &block = blocks[b];
+		out.append("b");
+		append_int(out, b);
+		out.append(":");
+		if (!block.preds.empty()) {
+			out.append(" ; preds");
+			for (size_t p=0; p < block.preds.size(); ++p) {
+				out.append(" b");
+				append_int(out, block.preds[p]);
+			}
+		}
+		out.append("\n");
+
+		for (size_t i=0; i < block.insns.size(); ++i) {
+			const IRInsn &insn = block.insns[i];
+			out.append("  ");
+			if (insn.dst >= 0) {
+				append_value(out, insn.dst);
+				out.append(":");
+				out.append(types[insn.type]);
+				out.append(" = ");
+			}
+			out.append(ops[insn.op]);
+			for (size_t a=0; a < insn.args.size(); ++a) {
+				out.append(a ? ", " : " ");
+				append_value(out, insn.args[a]);
+				if (insn.op == IRInsn::PHI) {
+					out.append(" b");
+					append_int(out, block.preds[a]);
+				}
+			}
+			switch (insn.op) {
+				case IRInsn::CONST:
+				case IRInsn::SHL:
+					out.append(" ");
+					append_int(out, insn.imm);
+					break;
+				case IRInsn::CONST_STRING:
+					out.append(" \"");
+					out.append(insn.str);
+					out.append("\"");
+					break;
+				case IRInsn::READ_INT:
+				case IRInsn::READ_STRING:
+					out.append(" ");
+					out.append(insn.str);
+					break;
+				default:
+					break;
+			}
+			out.append("\n");
+		}
+
+		switch (block.exit) {
+			case IRBlock::RETURN:
+				out.append("  return\n");
+				break;
+			case IRBlock::JUMP:
+				out.append("  jump b");
+				append_int(out, block.target);
+				out.append("\n");
+				break;
+			case IRBlock::BRANCH:
+				out.append("  branch ");
+				append_value(out, block.cond);
+				out.append(" b");
+				append_int(out, block.target);
+				out.append(" b");
+				append_int(out, block.other);
+				out.append("\n");
+				break;
+		}
+	}
+}
+
+} // namespace mpli
@@ -0,0 +1,117 @@
+#ifndef MPLI_IR_HPP_
+#define MPLI_IR_HPP_
+
+#include <vector>
+#include <string>
+
+namespace mpli {
+
+/* type of an IR value, bools are 0/1 ints like in the interpreter */
+enum IRType {
+	IR_VOID,
+	IR_INT,
+	IR_BOOL,
+	IR_STRING
+};
+
+/*
+ * Instruction of the SSA IR. Every instruction defines at most one value,
+ * values are numbered over the whole function and defined exactly once.
+ */
+struct IRInsn {
+	enum OP {
+		CONST,			/* dst = imm (int or bool) */
+		CONST_STRING,	/* dst = str */
+		COPY,			/* dst = args[0] */
+		PHI,			/* dst = args[k] when entered from preds[k] */
+		ADD,			/* int ops wrap around like the interpreter */
+		SUB,
+		MUL,
+		DIV,			/* raises on division by zero */
+		SHL,			/* dst = args[0] << imm */
+		LT,
+		EQ,				/* int or bool operands */
+		NE,
+		STR_EQ,
+		STR_NE,
+		AND,
+		NOT,
+		TO_STRING,		/* decimal text of int */
+		CONCAT,			/* string dst = args[0] + args[1] */
+		PRINT,			/* print args[0] by its type */
+		READ_INT,		/* dst read from input, str = variable name */
+		READ_STRING,
+		CHECK_RANGE,	/* stop if args[1] < args[0] */
+		ASSERT			/* stop if args[0] is false */
+	};
+
+	OP op;
+	/* type of dst, IR_VOID if no value is defined */
+	IRType type;
+	int dst;
+	std::vector<int> args;
+	int imm;
+	std::string str;
+
+	IRInsn();
+	/* no side effects, may be removed when dst is not used */
+	int is_pure() const;
+};
+
+struct IRBlock {
+	enum EXIT {
+		RETURN,
+		JUMP,		/* to target */
+		BRANCH		/* to target if cond, else to other */
+	};
+
+	/* PHI instructions first */
+	std::vector<IRInsn> insns;
+	/* predecessors in the order of PHI arguments */
+	std::vector<int> preds;
+	EXIT exit;
+	int cond;
+	int target;
+	int other;
+
+	IRBlock();
+};
+
+/*
+ * Counted FOR loop: blocks header..latch in layout order, header starts
+ * with the PHIs, latch ends with the counter increment and the branch back.
+ */
+struct IRLoop {
+	int preheader;
+	int header;
+	int latch;
+	int exit;
+	/* counter PHI and its incremented value */
+	int counter;
+	int next;
+};
+
+/*
+ * Program lowered into SSA form. Blocks are in layout order.
+ */
+class IRFunction {
+public:
+	std::vector<IRBlock> blocks;
+	std::vector<IRLoop> loops;
+	/* type of every value */
+	std::vector<IRType> value_types;
+
+	int new_value(IRType type);
+	int new_block();
+	int n_insns() const;
+	/* Replace uses of values: uses of v become uses of replace[v],
+	 * following chains. replace[v] == v for values kept. */
+	void replace_uses(std::vector<int> &replace);
+	/* remove instructions whose dst is marked in dead */
+	void remove_values(const std::vector<char> &dead);
+	/* human readable listing */
+	void dump(std::string &out) const;
+};
+
+} // namespace mpli
+#endif // MPLI_IR_HPP_
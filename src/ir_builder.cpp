@@ -0,0 +1,603 @@
+#include "ir_builder.hpp"
+
+#include <algorithm>
+
+namespace mpli {
+
+IRBuilder::IRBuilder()
+{
+	_fn = NULL;
+	_block = 0;
+	_loop_depth = 0;
+}
+
+const std::string &IRBuilder::error() const
+{
+	return _error;
+}
+
+IRFunction *IRBuilder::build(ASTNode *root)
+{
+	_fn = new IRFunction;
+	_block = _fn->new_block();
+	_symbols = SymbolTable();
+	_defs.clear();
+	_loop_depth = 0;
+	_error.clear();
+
+	for (size_t i=0; i < root->children.size(); ++i) {
+		if (lower_stmt(root->children[i]) != 0) {
+			delete _fn;
+			_fn = NULL;
+			return NULL;
+		}
+	}
+	if (_fn->blocks.size() * _defs.size() > MAX_LIVE) {
+		fail("too many blocks and variables", "");
+		delete _fn;
+		_fn = NULL;
+		return NULL;
+	}
+	IRFunction *fn = _fn;
+	_fn = NULL;
+	return fn;
+}
+
+int IRBuilder::fail(const char *reason, const std::string &name)
+{
+	if (_error.empty()) {
+		_error = reason;
+		if (!name.empty()) {
+			_error.append(" ");
+			_error.append(name);
+		}
+	}
+	return -1;
+}
+
+int IRBuilder::emit(IRInsn::OP op, IRType type, int a, int b)
+{
+	IRInsn insn;
+	insn.op = op;
+	insn.type = type;
+	if (a >= 0) {
+		insn.args.push_back(a);
+	}
+	if (b >= 0) {
+		insn.args.push_back(b);
+	}
+	if (type != IR_VOID) {
+		insn.dst = _fn->new_value(type);
+	}
+	_fn->blocks[_block].insns.push_back(insn);
+	return insn.dst;
+}
+
+int IRBuilder::emit_const(int val, IRType type)
+{
+	int v = emit(IRInsn::CONST, type, -1, -1);
+	_fn->blocks[_block].insns.back().imm = val;
+	return v;
+}
+
+int IRBuilder::emit_string(const std::string &str)
+{
+	int v = emit(IRInsn::CONST_STRING, IR_STRING, -1, -1);
+	_fn->blocks[_block].insns.back().str = str;
+	return v;
+}
+
+int IRBuilder::variable(ASTNode *id_node, Symbol::TYPE type)
+{
+	Symbol s = _symbols.find(id_node->symbol);
+	if (s.type != type) {
+		return fail("variable is not declared with the type it is used as:", id_node->value);
+	}
+	return _defs[s.location];
+}
+
+/* true if evaluating expression may raise an error */
+static int may_raise(ASTNode *node)
+{
+	if (node->type == ASTNode::OPERATOR && node->operator_type == ASTOperator::DIVIDE) {
+		ASTNode *d = node->children[1];
+		if (d->type != ASTNode::CONSTANT || d->variable_type != ASTVariable::INTEGER ||
+			d->int_value == 0 || d->int_value == -1) {
+			return 1;
+		}
+	}
+	for (size_t i=0; i < node->children.size(); ++i) {
+		if (may_raise(node->children[i])) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int IRBuilder::lower_stmt(ASTNode *node)
+{
+	int r;
+	/* expressions are lowered recursively */
+	ASTNode *exprs = (node->type == ASTNode::FOR_LOOP) ? node->children[0] : node;
+	if (exprs->height > ASTNode::RECURSIVE_HEIGHT) {
+		fail("expression nested too deeply", "");
+		return 1;
+	}
+	switch (node->type) {
+		case ASTNode::INSERT:
+			r = lower_insert(node);
+			break;
+		case ASTNode::FOR_LOOP:
+			r = lower_for_loop(node);
+			break;
+		case ASTNode::VAR_INIT:
+			r = lower_var_init(node);
+			break;
+		case ASTNode::READ:
+			r = lower_read(node);
+			break;
+		case ASTNode::PRINT:
+			r = lower_print(node);
+			break;
+		case ASTNode::ASSERT:
+			r = lower_assert(node);
+			break;
+		default:
+			r = fail("invalid statement", "");
+	}
+	return (r < 0) ? 1 : 0;
+}
+
+int IRBuilder::lower_var_init(ASTNode *node)
+{
+	const std::string &name = node->children[0]->value;
+	if (_loop_depth > 0) {
+		/* declared again on the next iteration */
+		return fail("declaration inside loop:", name);
+	}
+	if (_symbols.find(node->children[0]->symbol).type != Symbol::UNDEFINED) {
+		return fail("variable declared twice:", name);
+	}
+
+	Symbol s;
+	s.location = _defs.size();
+	switch (node->children[0]->variable_type) {
+		case ASTVariable::INTEGER:
+			s.type = Symbol::VARIABLE_INT;
+			_defs.push_back(emit_const(0, IR_INT));
+			break;
+		case ASTVariable::STRING:
+			s.type = Symbol::VARIABLE_STRING;
+			_defs.push_back(emit_string(""));
+			break;
+		case ASTVariable::BOOLEAN:
+			s.type = Symbol::VARIABLE_BOOL;
+			_defs.push_back(emit_const(0, IR_BOOL));
+			break;
+		default:
+			return fail("invalid variable type:", name);
+	}
+	_symbols.push(node->children[0]->symbol, s);
+	return 0;
+}
+
+int IRBuilder::lower_insert(ASTNode *node)
+{
+	const std::string &name = node->children[0]->value;
+	Symbol s = _symbols.find(node->children[0]->symbol);
+	ASTNode *rhs = node->children[1];
+	int v = -1;
+	Symbol s2;
+
+	switch (rhs->type) {
+		case ASTNode::OPERATOR:
+			switch (s.type) {
+				case Symbol::VARIABLE_INT:
+					v = lower_int_calc(rhs);
+					break;
+				case Symbol::VARIABLE_STRING:
+					v = lower_string(rhs);
+					break;
+				case Symbol::VARIABLE_BOOL:
+					v = lower_bool_calc(rhs);
+					break;
+				default:
+					return fail("assignment to undeclared variable", name);
+			}
+			break;
+		case ASTNode::UNARY_OP:
+			if (s.type != Symbol::VARIABLE_BOOL) {
+				return fail("'!' assigned to non-bool variable", name);
+			}
+			v = lower_bool(rhs);
+			break;
+		case ASTNode::VAR_ID:
+			s2 = _symbols.find(rhs->symbol);
+			if (s.type == Symbol::UNDEFINED || s.type != s2.type) {
+				return fail("assignment between different types to", name);
+			}
+			v = emit(IRInsn::COPY, _fn->value_types[_defs[s2.location]], _defs[s2.location], -1);
+			break;
+		case ASTNode::CONSTANT:
+			if (s.type == Symbol::VARIABLE_INT) {
+				v = lower_int(rhs);
+			} else if (s.type == Symbol::VARIABLE_STRING) {
+				v = emit_string(rhs->value);
+			} else {
+				return fail("constant assigned to", name);
+			}
+			break;
+		default:
+			return fail("invalid assignment to", name);
+	}
+
+	if (v < 0) {
+		return -1;
+	}
+	_defs[s.location] = v;
+	return 0;
+}
+
+void IRBuilder::collect_assigned(ASTNode *node, std::vector<int> &vars)
+{
+	Symbol s;
+	switch (node->type) {
+		case ASTNode::INSERT:
+		case ASTNode::READ:
+			s = _symbols.find(node->children[0]->symbol);
+			break;
+		case ASTNode::FOR_LOOP:
+			s = _symbols.find(node->children[0]->children[0]->symbol);
+			collect_assigned(node->children[1], vars);
+			break;
+		case ASTNode::FOR_DO:
+			for (size_t i=0; i < node->children.size(); ++i) {
+				collect_assigned(node->children[i], vars);
+			}
+			return;
+		default:
+			return;
+	}
+	if (s.type != Symbol::UNDEFINED &&
+		std::find(vars.begin(), vars.end(), s.location) == vars.end()) {
+		vars.push_back(s.location);
+	}
+}
+
+int IRBuilder::lower_for_loop(ASTNode *node)
+{
+	ASTNode *in_node = node->children[0];
+	const std::string &name = in_node->children[0]->value;
+	Symbol s = _symbols.find(in_node->children[0]->symbol);
+	if (s.type != Symbol::VARIABLE_INT) {
+		return fail("loop variable is not an int variable:", name);
+	}
+
+	/* range, evaluated once before the loop */
+	int range[2];
+	for (int i=0; i < 2; ++i) {
+		ASTNode *bound = in_node->children[i + 1];
+		switch (bound->type) {
+			case ASTNode::OPERATOR:
+				range[i] = lower_int_calc(bound);
+				break;
+			case ASTNode::VAR_ID:
+			case ASTNode::CONSTANT:
+				range[i] = lower_int(bound);
+				break;
+			default:
+				range[i] = fail("invalid range of loop over", name);
+		}
+		if (range[i] < 0) {
+			return -1;
+		}
+	}
+	emit(IRInsn::CHECK_RANGE, IR_VOID, range[0], range[1]);
+
+	IRLoop loop;
+	loop.preheader = _block;
+	loop.header = _fn->new_block();
+	_fn->blocks[loop.preheader].exit = IRBlock::JUMP;
+	_fn->blocks[loop.preheader].target = loop.header;
+	_fn->blocks[loop.header].preds.push_back(loop.preheader);
+	_block = loop.header;
+
+	/* PHI for every variable assigned in the body, the loop variable is
+	 * set from the counter at the start of every iteration */
+	std::vector<int> vars;
+	collect_assigned(node->children[1], vars);
+	vars.erase(std::remove(vars.begin(), vars.end(), s.location), vars.end());
+	for (size_t i=0; i < vars.size(); ++i) {
+		int v = vars[i];
+		_defs[v] = emit(IRInsn::PHI, _fn->value_types[_defs[v]], _defs[v], -1);
+	}
+	loop.counter = emit(IRInsn::PHI, IR_INT, range[0], -1);
+	_defs[s.location] = loop.counter;
+
+	++_loop_depth;
+	ASTNode *do_node = node->children[1];
+	for (size_t i=0; i < do_node->children.size(); ++i) {
+		if (lower_stmt(do_node->children[i]) != 0) {
+			return -1;
+		}
+	}
+	--_loop_depth;
+
+	loop.latch = _block;
+	loop.next = emit(IRInsn::ADD, IR_INT, loop.counter, emit_const(1, IR_INT));
+	int more = emit(IRInsn::NE, IR_BOOL, loop.counter, range[1]);
+	loop.exit = _fn->new_block();
+	IRBlock &latch = _fn->blocks[loop.latch];
+	latch.exit = IRBlock::BRANCH;
+	latch.cond = more;
+	latch.target = loop.header;
+	latch.other = loop.exit;
+	_fn->blocks[loop.exit].preds.push_back(loop.latch);
+
+	IRBlock &header = _fn->blocks[loop.header];
+	header.preds.push_back(loop.latch);
+	for (size_t i=0; i < vars.size(); ++i) {
+		header.insns[i].args.push_back(_defs[vars[i]]);
+	}
+	header.insns[vars.size()].args.push_back(loop.next);
+
+	/* like the interpreter, the loop variable ends one past the range */
+	_defs[s.location] = loop.next;
+	_fn->loops.push_back(loop);
+	_block = loop.exit;
+	return 0;
+}
+
+int IRBuilder::lower_read(ASTNode *node)
+{
+	const std::string &name = node->children[0]->value;
+	Symbol s = _symbols.find(node->children[0]->symbol);
+	int v;
+	switch (s.type) {
+		case Symbol::VARIABLE_INT:
+			v = emit(IRInsn::READ_INT, IR_INT, -1, -1);
+			break;
+		case Symbol::VARIABLE_STRING:
+			v = emit(IRInsn::READ_STRING, IR_STRING, -1, -1);
+			break;
+		default:
+			return fail("read into non int/string variable", name);
+	}
+	_fn->blocks[_block].insns.back().str = name;
+	_defs[s.location] = v;
+	return 0;
+}
+
+int IRBuilder::lower_print(ASTNode *node)
+{
+	ASTNode *expr = node->children[0];
+	Symbol s;
+	int v;
+	switch (expr->type) {
+		case ASTNode::UNARY_OP:
+			v = lower_bool(expr);
+			break;
+		case ASTNode::OPERATOR:
+			switch (op_var_typing(expr)) {
+				case ASTVariable::INTEGER:
+					v = lower_int_calc(expr);
+					break;
+				case ASTVariable::STRING:
+					/* printed piece by piece */
+					return lower_print_string(expr);
+				case ASTVariable::BOOLEAN:
+					v = lower_bool_calc(expr);
+					break;
+				default:
+					return fail("untyped print expression", "");
+			}
+			break;
+		case ASTNode::VAR_ID:
+			s = _symbols.find(expr->symbol);
+			if (s.type == Symbol::UNDEFINED) {
+				return fail("print of undeclared variable", expr->value);
+			}
+			v = _defs[s.location];
+			break;
+		case ASTNode::CONSTANT:
+			v = emit_string(expr->value);
+			break;
+		default:
+			return fail("invalid print statement", "");
+	}
+	if (v < 0) {
+		return -1;
+	}
+	emit(IRInsn::PRINT, IR_VOID, v, -1);
+	return 0;
+}
+
+int IRBuilder::lower_assert(ASTNode *node)
+{
+	ASTNode *expr = node->children[0];
+	int v;
+	switch (expr->type) {
+		case ASTNode::UNARY_OP:
+		case ASTNode::VAR_ID:
+			v = lower_bool(expr);
+			break;
+		case ASTNode::OPERATOR:
+			v = lower_bool_calc(expr);
+			break;
+		default:
+			return fail("invalid assert statement", "");
+	}
+	if (v < 0) {
+		return -1;
+	}
+	emit(IRInsn::ASSERT, IR_VOID, v, -1);
+	return 0;
+}
+
+int IRBuilder::lower_int(ASTNode *node)
+{
+	switch (node->type) {
+		case ASTNode::OPERATOR:
+			return lower_int_calc(node);
+		case ASTNode::VAR_ID:
+			return variable(node, Symbol::VARIABLE_INT);
+		case ASTNode::CONSTANT:
+			if (node->variable_type != ASTVariable::INTEGER) {
+				return fail("string constant used as int:", node->value);
+			}
+			return emit_const(node->int_value, IR_INT);
+		default:
+			return fail("invalid int operand", "");
+	}
+}
+
+int IRBuilder::lower_int_calc(ASTNode *node)
+{
+	IRInsn::OP op;
+	switch (node->operator_type) {
+		case ASTOperator::ADD:
+			op = IRInsn::ADD;
+			break;
+		case ASTOperator::SUBTRACT:
+			op = IRInsn::SUB;
+			break;
+		case ASTOperator::MULTIPLY:
+			op = IRInsn::MUL;
+			break;
+		case ASTOperator::DIVIDE:
+			op = IRInsn::DIV;
+			break;
+		default:
+			return fail("non-int operator in int expression", "");
+	}
+	int a = lower_int(node->children[0]);
+	int b = (a < 0) ? -1 : lower_int(node->children[1]);
+	if (b < 0) {
+		return -1;
+	}
+	return emit(op, IR_INT, a, b);
+}
+
+int IRBuilder::lower_bool(ASTNode *node)
+{
+	int v;
+	switch (node->type) {
+		case ASTNode::UNARY_OP:
+			v = lower_bool(node->children[0]);
+			return (v < 0) ? -1 : emit(IRInsn::NOT, IR_BOOL, v, -1);
+		case ASTNode::OPERATOR:
+			return lower_bool_calc(node);
+		case ASTNode::VAR_ID:
+			return variable(node, Symbol::VARIABLE_BOOL);
+		default:
+			return fail("invalid bool operand", "");
+	}
+}
+
+int IRBuilder::lower_bool_calc(ASTNode *node)
+{
+	ASTNode *left = node->children[0];
+	ASTNode *right = node->children[1];
+	IRInsn::OP op;
+	int a, b;
+	switch (node->operator_type) {
+		case ASTOperator::LESS_THAN:
+			a = lower_int(left);
+			b = (a < 0) ? -1 : lower_int(right);
+			op = IRInsn::LT;
+			break;
+		case ASTOperator::EQUALS:
+		case ASTOperator::NOT:
+			op = (node->operator_type == ASTOperator::EQUALS) ? IRInsn::EQ : IRInsn::NE;
+			switch (op_var_typing(node)) {
+				case ASTVariable::INTEGER:
+					a = lower_int(left);
+					b = (a < 0) ? -1 : lower_int(right);
+					break;
+				case ASTVariable::STRING:
+					op = (op == IRInsn::EQ) ? IRInsn::STR_EQ : IRInsn::STR_NE;
+					a = lower_string(left);
+					b = (a < 0) ? -1 : lower_string(right);
+					break;
+				case ASTVariable::BOOLEAN:
+					a = lower_bool(left);
+					b = (a < 0) ? -1 : lower_bool(right);
+					break;
+				default:
+					return fail("untyped comparison", "");
+			}
+			break;
+		case ASTOperator::AND:
+			/* right side is skipped when left is false */
+			if (may_raise(right)) {
+				return fail("'&' with a right side that may raise an error", "");
+			}
+			a = lower_bool(left);
+			b = (a < 0) ? -1 : lower_bool(right);
+			op = IRInsn::AND;
+			break;
+		default:
+			return fail("non-bool operator in bool expression", "");
+	}
+	if (b < 0) {
+		return -1;
+	}
+	return emit(op, IR_BOOL, a, b);
+}
+
+int IRBuilder::lower_string(ASTNode *node)
+{
+	Symbol s;
+	int a, b;
+	switch (node->type) {
+		case ASTNode::OPERATOR:
+			if (node->operator_type != ASTOperator::ADD) {
+				return fail("non-string operator in string expression", "");
+			}
+			a = lower_string(node->children[0]);
+			b = (a < 0) ? -1 : lower_string(node->children[1]);
+			return (b < 0) ? -1 : emit(IRInsn::CONCAT, IR_STRING, a, b);
+		case ASTNode::VAR_ID:
+			s = _symbols.find(node->symbol);
+			if (s.type == Symbol::VARIABLE_STRING) {
+				return _defs[s.location];
+			}
+			if (s.type == Symbol::VARIABLE_INT) {
+				return emit(IRInsn::TO_STRING, IR_STRING, _defs[s.location], -1);
+			}
+			return fail("non int/string variable in string expression:", node->value);
+		case ASTNode::CONSTANT:
+			return emit_string(node->value);
+		default:
+			return fail("invalid string operand", "");
+	}
+}
+
+int IRBuilder::lower_print_string(ASTNode *node)
+{
+	Symbol s;
+	switch (node->type) {
+		case ASTNode::OPERATOR:
+			if (node->operator_type != ASTOperator::ADD) {
+				return fail("non-string operator in string expression", "");
+			}
+			if (lower_print_string(node->children[0]) < 0) {
+				return -1;
+			}
+			return lower_print_string(node->children[1]);
+		case ASTNode::VAR_ID:
+			s = _symbols.find(node->symbol);
+			if (s.type != Symbol::VARIABLE_STRING && s.type != Symbol::VARIABLE_INT) {
+				return fail("non int/string variable in string expression:", node->value);
+			}
+			emit(IRInsn::PRINT, IR_VOID, _defs[s.location], -1);
+			return 0;
+		case ASTNode::CONSTANT:
+			emit(IRInsn::PRINT, IR_VOID, emit_string(node->value), -1);
+			return 0;
+		default:
+			return fail("invalid string operand", "");
+	}
+}
+
+} // namespace mpli
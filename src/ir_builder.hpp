@@ -0,0 +1,72 @@
+#ifndef MPLI_IR_BUILDER_HPP_
+#define MPLI_IR_BUILDER_HPP_
+
+#include "ast.hpp"
+#include "ir.hpp"
+#include "symbol_table.hpp"
+#include <vector>
+#include <string>
+
+namespace mpli {
+
+/*
+ * Lowers an AST into SSA form. Expressions are lowered the same way the
+ * interpreter evaluates them (int_for_op, string_for_op, print_string_for_op
+ * etc.), including the operand typing rules. Programs on which the
+ * interpreter would report an error that can be seen before running, like
+ * type errors, use of undeclared variables or declarations inside loops,
+ * are not lowered; they are left to the interpreter.
+ */
+class IRBuilder {
+public:
+	/* Bound on blocks times variables, which bounds the values the
+	 * backend tracks as live across blocks. Larger programs are left to
+	 * the interpreter. */
+	static const size_t MAX_LIVE = (size_t)1 << 22;
+
+private:
+	IRFunction *_fn;
+	/* block instructions are appended to */
+	int _block;
+	/* declared variables, location is the index into _defs */
+	SymbolTable _symbols;
+	/* current SSA value of every variable */
+	std::vector<int> _defs;
+	int _loop_depth;
+	std::string _error;
+
+	int emit(IRInsn::OP op, IRType type, int a, int b);
+	int emit_const(int val, IRType type);
+	int emit_string(const std::string &str);
+	/* record reason lowering stopped, returns -1 */
+	int fail(const char *reason, const std::string &name);
+
+	int lower_stmt(ASTNode *node);
+	int lower_var_init(ASTNode *node);
+	int lower_insert(ASTNode *node);
+	int lower_for_loop(ASTNode *node);
+	int lower_read(ASTNode *node);
+	int lower_print(ASTNode *node);
+	int lower_assert(ASTNode *node);
+
+	/* Expressions, return value or -1. */
+	int lower_int(ASTNode *node);
+	int lower_int_calc(ASTNode *node);
+	int lower_bool(ASTNode *node);
+	int lower_bool_calc(ASTNode *node);
+	int lower_string(ASTNode *node);
+	int lower_print_string(ASTNode *node);
+	/* value of variable read with given type, -1 if not declared so */
+	int variable(ASTNode *id_node, Symbol::TYPE type);
+	void collect_assigned(ASTNode *node, std::vector<int> &vars);
+
+public:
+	IRBuilder();
+	/* Lower program, NULL if it cannot be lowered. Caller owns result. */
+	IRFunction *build(ASTNode *root);
+	/* why last build() returned NULL */
+	const std::string &error() const;
+};
+
+} // namespace mpli
+#endif // MPLI_IR_BUILDER_HPP_
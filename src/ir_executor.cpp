@@ -0,0 +1,440 @@
+#include "ir_executor.hpp"
+#include "int_conv.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+
+namespace mpli {
+
+IRExecutor::IRExecutor(OutputBuffer &output, InputReader &input)
+	: _output(output), _input(input)
+{
+}
+
+void IRExecutor::emit(CODE code, int dst, int a, int b)
+{
+	Op op;
+	op.code = code;
+	op.dst = dst;
+	op.a = a;
+	op.b = b;
+	op.imm = 0;
+	op.str = NULL;
+	_code.push_back(op);
+}
+
+/* values live on the edge from block b into block to: live_in of to and
+ * the arguments of its PHIs for that edge, appended to out */
+static void append_edge_live(const IRFunction &fn, int b, int to,
+	const std::vector<std::vector<int> > &live_in, std::vector<int> &out)
+{
+	const IRBlock &block = fn.blocks[to];
+	out.insert(out.end(), live_in[to].begin(), live_in[to].end());
+	int k = std::find(block.preds.begin(), block.preds.end(), b) - block.preds.begin();
+	for (size_t i=0; i < block.insns.size(); ++i) {
+		if (block.insns[i].op == IRInsn::PHI) {
+			out.push_back(block.insns[i].args[k]);
+		}
+	}
+}
+
+/* live_in[b]: sorted values used in block b or after it, not counting
+ * PHIs of b, which are used on the incoming edges. Only values that live
+ * across blocks are stored, so the sets stay small for long programs. */
+static void compute_liveness(const IRFunction &fn, std::vector<std::vector<int> > &live_in)
+{
+	int n = fn.value_types.size();
+	int n_blocks = fn.blocks.size();
+	live_in.assign(n_blocks, std::vector<int>());
+	/* block defining every value, and values used in a block before
+	 * their definition in it (uses of the block) */
+	std::vector<int> def_block(n, -1);
+	std::vector<std::vector<int> > uses(n_blocks);
+	for (int b=0; b < n_blocks; ++b) {
+		const IRBlock &block = fn.blocks[b];
+		for (size_t i=0; i < block.insns.size(); ++i) {
+			const IRInsn &insn = block.insns[i];
+			if (insn.op != IRInsn::PHI) {
+				for (size_t a=0; a < insn.args.size(); ++a) {
+					if (def_block[insn.args[a]] != b) {
+						uses[b].push_back(insn.args[a]);
+					}
+				}
+			}
+			if (insn.dst >= 0) {
+				def_block[insn.dst] = b;
+			}
+		}
+		if (block.exit == IRBlock::BRANCH && def_block[block.cond] != b) {
+			uses[b].push_back(block.cond);
+		}
+		std::sort(uses[b].begin(), uses[b].end());
+		uses[b].erase(std::unique(uses[b].begin(), uses[b].end()), uses[b].end());
+	}
+
+	std::vector<int> live;
+	int changed = 1;
+	while (changed) {
+		changed = 0;
+		for (int b=n_blocks-1; b >= 0; --b) {
+			const IRBlock &block = fn.blocks[b];
+			live.clear();
+			if (block.exit != IRBlock::RETURN) {
+				append_edge_live(fn, b, block.target, live_in, live);
+			}
+			if (block.exit == IRBlock::BRANCH) {
+				append_edge_live(fn, b, block.other, live_in, live);
+			}
+			/* values defined in b are dead before it */
+			int kept = 0;
+			for (size_t i=0; i < live.size(); ++i) {
+				if (def_block[live[i]] != b) {
+					live[kept++] = live[i];
+				}
+			}
+			live.resize(kept);
+			live.insert(live.end(), uses[b].begin(), uses[b].end());
+			std::sort(live.begin(), live.end());
+			live.erase(std::unique(live.begin(), live.end()), live.end());
+			if (live != live_in[b]) {
+				live_in[b].swap(live);
+				changed = 1;
+			}
+		}
+	}
+}
+
+void IRExecutor::emit_edge(const IRFunction &fn, int from, int to,
+	const std::vector<std::vector<int> > &live_in)
+{
+	const IRBlock &block = fn.blocks[to];
+	int k = std::find(block.preds.begin(), block.preds.end(), from) - block.preds.begin();
+	std::vector<int> dsts, srcs;
+	for (size_t i=0; i < block.insns.size(); ++i) {
+		const IRInsn &insn = block.insns[i];
+		if (insn.op == IRInsn::PHI && insn.args[k] != insn.dst) {
+			dsts.push_back(insn.dst);
+			srcs.push_back(insn.args[k]);
+		}
+	}
+
+	/* a string can be moved if nothing reads it after this edge */
+	std::vector<char> move(srcs.size(), 0);
+	int overlap = 0;
+	for (size_t i=0; i < srcs.size(); ++i) {
+		int s = srcs[i];
+		move[i] = fn.value_types[s] == IR_STRING && !_constant[s] &&
+			!std::binary_search(live_in[to].begin(), live_in[to].end(), s) &&
+			std::count(srcs.begin(), srcs.end(), s) == 1;
+		overlap = overlap || std::find(dsts.begin(), dsts.end(), s) != dsts.end();
+	}
+
+	if (overlap) {
+		/* PHIs read their values in parallel: go through temporaries */
+		for (size_t i=0; i < srcs.size(); ++i) {
+			int t = _ints.size();
+			_ints.push_back(0);
+			_strings.push_back(std::string());
+			_constant.push_back(0);
+			if (fn.value_types[srcs[i]] == IR_STRING) {
+				emit(move[i] ? MOVE_STRING : COPY_STRING, t, srcs[i], -1);
+			} else {
+				emit(COPY_INT, t, srcs[i], -1);
+			}
+			srcs[i] = t;
+			move[i] = 1;
+		}
+	}
+	for (size_t i=0; i < srcs.size(); ++i) {
+		if (fn.value_types[dsts[i]] == IR_STRING) {
+			emit(move[i] ? MOVE_STRING : COPY_STRING, dsts[i], srcs[i], -1);
+		} else {
+			emit(COPY_INT, dsts[i], srcs[i], -1);
+		}
+	}
+}
+
+void IRExecutor::compile(const IRFunction &fn)
+{
+	int n = fn.value_types.size();
+	_code.clear();
+	_ints.assign(n, 0);
+	_strings.assign(n, std::string());
+	_constant.assign(n, 0);
+
+	/* constants are set once, values are never redefined */
+	for (int b=0; b < (int)fn.blocks.size(); ++b) {
+		const std::vector<IRInsn> &insns = fn.blocks[b].insns;
+		for (size_t i=0; i < insns.size(); ++i) {
+			if (insns[i].op == IRInsn::CONST) {
+				_ints[insns[i].dst] = insns[i].imm;
+			} else if (insns[i].op == IRInsn::CONST_STRING) {
+				_strings[insns[i].dst] = insns[i].str;
+				_constant[insns[i].dst] = 1;
+			}
+		}
+	}
+
+	std::vector<std::vector<int> > live_in;
+	compute_liveness(fn, live_in);
+
+	std::vector<int> block_pc(fn.blocks.size());
+	/* jumps to patch with block_pc of their target block */
+	std::vector<std::pair<int, int> > jumps;
+	/* values live after the current instruction, and those set in the
+	 * current block, cleared before the next one */
+	std::vector<char> live(n, 0);
+	std::vector<int> touched;
+
+	for (int b=0; b < (int)fn.blocks.size(); ++b) {
+		const IRBlock &block = fn.blocks[b];
+		block_pc[b] = _code.size();
+
+		/* values used after each instruction, to find last uses */
+		std::vector<char> last_use(block.insns.size(), 0);
+		touched.clear();
+		if (block.exit != IRBlock::RETURN) {
+			append_edge_live(fn, b, block.target, live_in, touched);
+		}
+		if (block.exit == IRBlock::BRANCH) {
+			append_edge_live(fn, b, block.other, live_in, touched);
+		}
+		for (size_t i=0; i < touched.size(); ++i) {
+			live[touched[i]] = 1;
+		}
+		for (int i=block.insns.size()-1; i >= 0; --i) {
+			const IRInsn &insn = block.insns[i];
+			if (insn.op == IRInsn::PHI) {
+				continue;
+			}
+			if (insn.dst >= 0) {
+				live[insn.dst] = 0;
+			}
+			if (!insn.args.empty() && !live[insn.args[0]] && !_constant[insn.args[0]] &&
+				(insn.args.size() < 2 || insn.args[1] != insn.args[0])) {
+				last_use[i] = 1;
+			}
+			for (size_t a=0; a < insn.args.size(); ++a) {
+				live[insn.args[a]] = 1;
+				touched.push_back(insn.args[a]);
+			}
+		}
+		for (size_t i=0; i < touched.size(); ++i) {
+			live[touched[i]] = 0;
+		}
+
+		for (size_t i=0; i < block.insns.size(); ++i) {
+			const IRInsn &insn = block.insns[i];
+			int a = insn.args.size() > 0 ? insn.args[0] : -1;
+			int c = insn.args.size() > 1 ? insn.args[1] : -1;
+			IRType t = (a >= 0) ? fn.value_types[a] : IR_VOID;
+			switch (insn.op) {
+				case IRInsn::CONST:
+				case IRInsn::CONST_STRING:
+				case IRInsn::PHI:
+					break;
+				case IRInsn::COPY:
+					if (t == IR_STRING) {
+						emit(last_use[i] ? MOVE_STRING : COPY_STRING, insn.dst, a, -1);
+					} else {
+						emit(COPY_INT, insn.dst, a, -1);
+					}
+					break;
+				case IRInsn::ADD: emit(ADD, insn.dst, a, c); break;
+				case IRInsn::SUB: emit(SUB, insn.dst, a, c); break;
+				case IRInsn::MUL: emit(MUL, insn.dst, a, c); break;
+				case IRInsn::DIV: emit(DIV, insn.dst, a, c); break;
+				case IRInsn::SHL:
+					emit(SHL, insn.dst, a, -1);
+					_code.back().imm = insn.imm;
+					break;
+				case IRInsn::LT: emit(LT, insn.dst, a, c); break;
+				case IRInsn::EQ: emit(EQ, insn.dst, a, c); break;
+				case IRInsn::NE: emit(NE, insn.dst, a, c); break;
+				case IRInsn::STR_EQ: emit(STR_EQ, insn.dst, a, c); break;
+				case IRInsn::STR_NE: emit(STR_NE, insn.dst, a, c); break;
+				case IRInsn::AND: emit(AND, insn.dst, a, c); break;
+				case IRInsn::NOT: emit(NOT, insn.dst, a, -1); break;
+				case IRInsn::TO_STRING: emit(TO_STRING, insn.dst, a, -1); break;
+				case IRInsn::CONCAT:
+					emit(last_use[i] ? APPEND : CONCAT, insn.dst, a, c);
+					break;
+				case IRInsn::PRINT:
+					emit(t == IR_STRING ? PRINT_STRING : (t == IR_BOOL ? PRINT_BOOL : PRINT_INT),
+						-1, a, -1);
+					break;
+				case IRInsn::READ_INT:
+				case IRInsn::READ_STRING:
+					emit(insn.op == IRInsn::READ_INT ? READ_INT : READ_STRING, insn.dst, -1, -1);
+					_code.back().str = &insn.str;
+					break;
+				case IRInsn::CHECK_RANGE: emit(CHECK_RANGE, -1, a, c); break;
+				case IRInsn::ASSERT: emit(ASSERT, -1, a, -1); break;
+			}
+		}
+
+		switch (block.exit) {
+			case IRBlock::RETURN:
+				emit(HALT, -1, -1, -1);
+				break;
+			case IRBlock::JUMP:
+				emit_edge(fn, b, block.target, live_in);
+				if (block.target != b + 1) {
+					emit(JUMP, -1, -1, -1);
+					jumps.push_back(std::make_pair((int)_code.size() - 1, block.target));
+				}
+				break;
+			case IRBlock::BRANCH: {
+				emit(JUMP_IF_NOT, -1, block.cond, -1);
+				int skip = _code.size() - 1;
+				emit_edge(fn, b, block.target, live_in);
+				emit(JUMP, -1, -1, -1);
+				jumps.push_back(std::make_pair((int)_code.size() - 1, block.target));
+				_code[skip].imm = _code.size();
+				emit_edge(fn, b, block.other, live_in);
+				if (block.other != b + 1) {
+					emit(JUMP, -1, -1, -1);
+					jumps.push_back(std::make_pair((int)_code.size() - 1, block.other));
+				}
+				break;
+			}
+		}
+	}
+	for (size_t i=0; i < jumps.size(); ++i) {
+		_code[jumps[i].first].imm = block_pc[jumps[i].second];
+	}
+}
+
+int IRExecutor::run(const IRFunction &fn)
+{
+	compile(fn);
+	int *ints = &_ints[0];
+	std::string *strings = &_strings[0];
+	const Op *code = &_code[0];
+	InputReader::RESULT r;
+
+	for (int pc=0; ; ) {
+		const Op &op = code[pc++];
+		/* arithmetic wraps around like the interpreter on int */
+		unsigned int a = (op.a >= 0) ? ints[op.a] : 0;
+		unsigned int b = (op.b >= 0) ? ints[op.b] : 0;
+		switch (op.code) {
+			case COPY_INT:
+				ints[op.dst] = a;
+				break;
+			case COPY_STRING:
+				strings[op.dst] = strings[op.a];
+				break;
+			case MOVE_STRING:
+				strings[op.dst].swap(strings[op.a]);
+				break;
+			case ADD:
+				ints[op.dst] = (int)(a + b);
+				break;
+			case SUB:
+				ints[op.dst] = (int)(a - b);
+				break;
+			case MUL:
+				ints[op.dst] = (int)(a * b);
+				break;
+			case DIV:
+				if (b == 0) {
+					throw std::invalid_argument("Cannot divide by zero.");
+				}
+				ints[op.dst] = (int)a / (int)b;
+				break;
+			case SHL:
+				ints[op.dst] = (int)(a << op.imm);
+				break;
+			case LT:
+				ints[op.dst] = ((int)a < (int)b);
+				break;
+			case EQ:
+				ints[op.dst] = (a == b);
+				break;
+			case NE:
+				ints[op.dst] = (a != b);
+				break;
+			case STR_EQ:
+				ints[op.dst] = (strings[op.a] == strings[op.b]);
+				break;
+			case STR_NE:
+				ints[op.dst] = (strings[op.a] != strings[op.b]);
+				break;
+			case AND:
+				ints[op.dst] = (a && b);
+				break;
+			case NOT:
+				ints[op.dst] = !a;
+				break;
+			case TO_STRING:
+				strings[op.dst].clear();
+				append_int(strings[op.dst], (int)a);
+				break;
+			case CONCAT:
+				strings[op.dst].assign(strings[op.a]);
+				strings[op.dst].append(strings[op.b]);
+				break;
+			case APPEND:
+				strings[op.dst].swap(strings[op.a]);
+				strings[op.dst].append(strings[op.b]);
+				break;
+			case PRINT_INT:
+				_output.write_int((int)a);
+				break;
+			case PRINT_BOOL:
+				if (a) {
+					_output.write("true", 4);
+				} else {
+					_output.write("false", 5);
+				}
+				break;
+			case PRINT_STRING:
+				_output.write(strings[op.a]);
+				break;
+			case READ_INT:
+			case READ_STRING:
+				_output.before_read();
+				if (op.code == READ_INT) {
+					r = _input.read_int(&ints[op.dst]);
+				} else {
+					r = _input.read_word(strings[op.dst]);
+				}
+				if (r == InputReader::READ_EOF) {
+					_output.write_format("\nERROR: Interpreter::execute_read - Unexpected end of input for %s.\n",
+						op.str->c_str());
+					return 1;
+				} else if (r == InputReader::READ_INVALID) {
+					_output.write_format("\nERROR: Interpreter::execute_read - Invalid integer input '%s' for %s.\n",
+						_input.last_token().c_str(), op.str->c_str());
+					return 1;
+				}
+				break;
+			case CHECK_RANGE:
+				if ((int)b < (int)a) {
+					_output.write_format("\nERROR: Interpreter::execute_for_loop - Invalid range defined %d..%d\n",
+						(int)a, (int)b);
+					return 1;
+				}
+				break;
+			case ASSERT:
+				if (!a) {
+					_output.write_format("\nERROR: Interpreter::execute_assert - Assert returned false. Cannot continue.\n");
+					return 1;
+				}
+				break;
+			case JUMP:
+				pc = op.imm;
+				break;
+			case JUMP_IF_NOT:
+				if (!a) {
+					pc = op.imm;
+				}
+				break;
+			case HALT:
+				return 0;
+		}
+	}
+}
+
+} // namespace mpli
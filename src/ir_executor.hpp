@@ -0,0 +1,83 @@
+#ifndef MPLI_IR_EXECUTOR_HPP_
+#define MPLI_IR_EXECUTOR_HPP_
+
+#include "ir.hpp"
+#include "output_buffer.hpp"
+#include "input_reader.hpp"
+#include <vector>
+#include <string>
+
+namespace mpli {
+
+/*
+ * Backend running an IRFunction. The blocks are flattened into a linear
+ * instruction list with PHIs resolved into copies on the incoming edges.
+ * Every SSA value has its own register; a string whose value is used for
+ * the last time is moved instead of copied, so s := s + e in a loop
+ * appends in place like the interpreter does.
+ */
+class IRExecutor {
+private:
+	enum CODE {
+		COPY_INT,
+		COPY_STRING,
+		MOVE_STRING,
+		ADD,
+		SUB,
+		MUL,
+		DIV,
+		SHL,
+		LT,
+		EQ,
+		NE,
+		STR_EQ,
+		STR_NE,
+		AND,
+		NOT,
+		TO_STRING,
+		CONCAT,
+		APPEND,		/* CONCAT moving its first operand */
+		PRINT_INT,
+		PRINT_BOOL,
+		PRINT_STRING,
+		READ_INT,
+		READ_STRING,
+		CHECK_RANGE,
+		ASSERT,
+		JUMP,		/* to imm */
+		JUMP_IF_NOT,
+		HALT
+	};
+
+	struct Op {
+		CODE code;
+		int dst;
+		int a;
+		int b;
+		int imm;
+		const std::string *str;
+	};
+
+	OutputBuffer &_output;
+	InputReader &_input;
+	std::vector<Op> _code;
+	std::vector<int> _ints;
+	std::vector<std::string> _strings;
+	/* per value: defined by CONST_STRING, never moved from */
+	std::vector<char> _constant;
+
+	void compile(const IRFunction &fn);
+	void emit(CODE code, int dst, int a, int b);
+	/* copies of PHIs of block to when entered from block from */
+	void emit_edge(const IRFunction &fn, int from, int to,
+		const std::vector<std::vector<int> > &live_in);
+
+public:
+	IRExecutor(OutputBuffer &output, InputReader &input);
+	/* Run fn. Returns 0 on success, 1 after reporting an error. Division
+	 * by zero raises std::invalid_argument like in the interpreter. */
+	int run(const IRFunction &fn);
+};
+
+} // namespace mpli
+#endif // MPLI_IR_EXECUTOR_HPP_
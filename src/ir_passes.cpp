@@ -0,0 +1,442 @@
+#include "ir_passes.hpp"
+#include "int_conv.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <chrono>
+
+namespace mpli {
+
+/* turn insn into a constant definition of its dst */
+static void make_const(IRInsn &insn, int val)
+{
+	insn.op = IRInsn::CONST;
+	insn.args.clear();
+	insn.imm = val;
+}
+
+static void make_const_string(IRInsn &insn, const std::string &str)
+{
+	insn.op = IRInsn::CONST_STRING;
+	insn.args.clear();
+	insn.str = str;
+}
+
+static void make_copy(IRInsn &insn, int src)
+{
+	insn.op = IRInsn::COPY;
+	insn.args.assign(1, src);
+}
+
+void constant_propagation(IRFunction &fn)
+{
+	int n = fn.value_types.size();
+	std::vector<char> known(n, 0);
+	std::vector<int> values(n, 0);
+	std::vector<std::string> strings(n);
+
+	int changed = 1;
+	while (changed) {
+		changed = 0;
+		for (size_t b=0; b < fn.blocks.size(); ++b) {
+			std::vector<IRInsn> &insns = fn.blocks[b].insns;
+			size_t kept = 0;
+			for (size_t i=0; i < insns.size(); ++i) {
+				IRInsn &insn = insns[i];
+				const std::vector<int> &args = insn.args;
+				int all_known = 1;
+				for (size_t a=0; a < args.size(); ++a) {
+					all_known = all_known && known[args[a]];
+				}
+				unsigned int x = all_known && args.size() > 0 ? values[args[0]] : 0;
+				unsigned int y = all_known && args.size() > 1 ? values[args[1]] : 0;
+				int folded = all_known;
+				int remove = 0;
+				if (!folded && args.size() == 2 && args[0] == args[1]) {
+					/* a value compared with itself */
+					switch (insn.op) {
+						case IRInsn::EQ:
+						case IRInsn::STR_EQ:
+							make_const(insn, 1);
+							changed = 1;
+							break;
+						case IRInsn::NE:
+						case IRInsn::STR_NE:
+							make_const(insn, 0);
+							changed = 1;
+							break;
+						default:
+							break;
+					}
+				}
+
+				switch (insn.op) {
+					case IRInsn::CONST:
+					case IRInsn::CONST_STRING:
+						folded = 0;
+						if (!known[insn.dst]) {
+							known[insn.dst] = 1;
+							values[insn.dst] = insn.imm;
+							strings[insn.dst] = insn.str;
+						}
+						break;
+					case IRInsn::PHI: {
+						/* same constant from every predecessor */
+						int same = 1;
+						for (size_t a=0; a < args.size() && same; ++a) {
+							same = (args[a] == insn.dst) || (known[args[a]] &&
+								values[args[a]] == values[args[0]] &&
+								strings[args[a]] == strings[args[0]]);
+						}
+						folded = same && known[args[0]];
+						if (folded) {
+							if (insn.type == IR_STRING) {
+								make_const_string(insn, strings[args[0]]);
+							} else {
+								make_const(insn, values[args[0]]);
+							}
+						}
+						break;
+					}
+					case IRInsn::COPY:
+						if (folded) {
+							if (insn.type == IR_STRING) {
+								make_const_string(insn, strings[args[0]]);
+							} else {
+								make_const(insn, x);
+							}
+						}
+						break;
+					case IRInsn::ADD:
+						if (folded) make_const(insn, (int)(x + y));
+						break;
+					case IRInsn::SUB:
+						if (folded) make_const(insn, (int)(x - y));
+						break;
+					case IRInsn::MUL:
+						if (folded) make_const(insn, (int)(x * y));
+						break;
+					case IRInsn::SHL:
+						if (folded) make_const(insn, (int)(x << insn.imm));
+						break;
+					case IRInsn::DIV:
+						/* raising divisions stay for run time */
+						folded = folded && y != 0 && !((int)x == INT_MIN && (int)y == -1);
+						if (folded) make_const(insn, (int)x / (int)y);
+						break;
+					case IRInsn::LT:
+						if (folded) make_const(insn, (int)x < (int)y);
+						break;
+					case IRInsn::EQ:
+						if (folded) make_const(insn, x == y);
+						break;
+					case IRInsn::NE:
+						if (folded) make_const(insn, x != y);
+						break;
+					case IRInsn::AND:
+						if (!folded && ((known[args[0]] && !values[args[0]]) ||
+							(known[args[1]] && !values[args[1]]))) {
+							/* both sides are pure, one false is enough */
+							folded = 1;
+							x = 0;
+						}
+						if (folded) make_const(insn, x && y);
+						break;
+					case IRInsn::NOT:
+						if (folded) make_const(insn, !x);
+						break;
+					case IRInsn::STR_EQ:
+						if (folded) make_const(insn, strings[args[0]] == strings[args[1]]);
+						break;
+					case IRInsn::STR_NE:
+						if (folded) make_const(insn, strings[args[0]] != strings[args[1]]);
+						break;
+					case IRInsn::TO_STRING:
+						if (folded) {
+							std::string s;
+							append_int(s, (int)x);
+							make_const_string(insn, s);
+						}
+						break;
+					case IRInsn::CONCAT:
+						if (folded) make_const_string(insn, strings[args[0]] + strings[args[1]]);
+						break;
+					case IRInsn::ASSERT:
+						remove = folded && x;
+						folded = 0;
+						break;
+					case IRInsn::CHECK_RANGE:
+						remove = folded && (int)x <= (int)y;
+						folded = 0;
+						break;
+					default:
+						folded = 0;
+				}
+
+				if (folded) {
+					changed = 1;
+				}
+				if (remove) {
+					changed = 1;
+					continue;
+				}
+				if (kept != i) {
+					insns[kept] = insns[i];
+				}
+				++kept;
+			}
+			insns.resize(kept);
+		}
+	}
+}
+
+void copy_propagation(IRFunction &fn)
+{
+	int n = fn.value_types.size();
+	int changed = 1;
+	while (changed) {
+		changed = 0;
+		std::vector<int> replace(n);
+		std::vector<char> dead(n, 0);
+		for (int v=0; v < n; ++v) {
+			replace[v] = v;
+		}
+		for (size_t b=0; b < fn.blocks.size(); ++b) {
+			const std::vector<IRInsn> &insns = fn.blocks[b].insns;
+			for (size_t i=0; i < insns.size(); ++i) {
+				const IRInsn &insn = insns[i];
+				int src = -1;
+				if (insn.op == IRInsn::COPY) {
+					src = insn.args[0];
+				} else if (insn.op == IRInsn::PHI) {
+					/* trivial PHI: one value apart from itself */
+					int unique = 1;
+					for (size_t a=0; a < insn.args.size(); ++a) {
+						int arg = insn.args[a];
+						if (arg == insn.dst || arg == src) {
+							continue;
+						}
+						if (src >= 0) {
+							unique = 0;
+						}
+						src = arg;
+					}
+					if (!unique) {
+						src = -1;
+					}
+				}
+				if (src >= 0) {
+					replace[insn.dst] = src;
+					dead[insn.dst] = 1;
+					changed = 1;
+				}
+			}
+		}
+		if (changed) {
+			fn.replace_uses(replace);
+			fn.remove_values(dead);
+		}
+	}
+}
+
+void dead_store_elimination(IRFunction &fn)
+{
+	int n = fn.value_types.size();
+	std::vector<const IRInsn*> defs(n, (const IRInsn*)NULL);
+	for (size_t b=0; b < fn.blocks.size(); ++b) {
+		const std::vector<IRInsn> &insns = fn.blocks[b].insns;
+		for (size_t i=0; i < insns.size(); ++i) {
+			if (insns[i].dst >= 0) {
+				defs[insns[i].dst] = &insns[i];
+			}
+		}
+	}
+
+	/* mark values used by instructions that have to run */
+	std::vector<char> live(n, 0);
+	std::vector<int> work;
+	for (size_t b=0; b < fn.blocks.size(); ++b) {
+		const IRBlock &block = fn.blocks[b];
+		if (block.exit == IRBlock::BRANCH) {
+			work.push_back(block.cond);
+		}
+		for (size_t i=0; i < block.insns.size(); ++i) {
+			const IRInsn &insn = block.insns[i];
+			int required = !insn.is_pure();
+			if (insn.op == IRInsn::DIV) {
+				/* division by a constant other than 0 and -1 cannot raise */
+				const IRInsn *d = defs[insn.args[1]];
+				required = !(d && d->op == IRInsn::CONST && d->imm != 0 && d->imm != -1);
+			}
+			if (required) {
+				if (insn.dst >= 0) {
+					work.push_back(insn.dst);
+				}
+				work.insert(work.end(), insn.args.begin(), insn.args.end());
+			}
+		}
+	}
+	while (!work.empty()) {
+		int v = work.back();
+		work.pop_back();
+		if (live[v]) {
+			continue;
+		}
+		live[v] = 1;
+		if (defs[v]) {
+			work.insert(work.end(), defs[v]->args.begin(), defs[v]->args.end());
+		}
+	}
+
+	std::vector<char> dead(n, 0);
+	for (int v=0; v < n; ++v) {
+		dead[v] = defs[v] && !live[v];
+	}
+	fn.remove_values(dead);
+}
+
+/* k if val is 2^k with k > 0, else -1 */
+static int log2_exact(int val)
+{
+	if (val < 2 || (val & (val - 1)) != 0) {
+		return -1;
+	}
+	int k = 0;
+	while ((1 << k) != val) {
+		++k;
+	}
+	return k;
+}
+
+void strength_reduction(IRFunction &fn)
+{
+	int n = fn.value_types.size();
+	std::vector<char> known(n, 0);
+	std::vector<int> values(n, 0);
+	for (size_t b=0; b < fn.blocks.size(); ++b) {
+		const std::vector<IRInsn> &insns = fn.blocks[b].insns;
+		for (size_t i=0; i < insns.size(); ++i) {
+			if (insns[i].op == IRInsn::CONST) {
+				known[insns[i].dst] = 1;
+				values[insns[i].dst] = insns[i].imm;
+			}
+		}
+	}
+
+	for (size_t b=0; b < fn.blocks.size(); ++b) {
+		std::vector<IRInsn> &insns = fn.blocks[b].insns;
+		for (size_t i=0; i < insns.size(); ++i) {
+			IRInsn &insn = insns[i];
+			if (insn.args.size() != 2) {
+				continue;
+			}
+			int a = insn.args[0], c = insn.args[1];
+			switch (insn.op) {
+				case IRInsn::MUL:
+					if (known[a]) {
+						std::swap(a, c);
+					}
+					if (!known[c]) {
+						break;
+					}
+					if (values[c] == 0) {
+						make_const(insn, 0);
+					} else if (values[c] == 1) {
+						make_copy(insn, a);
+					} else if (log2_exact(values[c]) > 0) {
+						insn.op = IRInsn::SHL;
+						insn.imm = log2_exact(values[c]);
+						insn.args.assign(1, a);
+					}
+					break;
+				case IRInsn::ADD:
+					if (known[a] && values[a] == 0) {
+						make_copy(insn, c);
+					} else if (known[c] && values[c] == 0) {
+						make_copy(insn, a);
+					}
+					break;
+				case IRInsn::SUB:
+					if (known[c] && values[c] == 0) {
+						make_copy(insn, a);
+					}
+					break;
+				case IRInsn::DIV:
+					if (known[c] && values[c] == 1) {
+						make_copy(insn, a);
+					}
+					break;
+				case IRInsn::AND:
+					if (known[a] && values[a]) {
+						make_copy(insn, c);
+					} else if (known[c] && values[c]) {
+						make_copy(insn, a);
+					}
+					break;
+				default:
+					break;
+			}
+		}
+	}
+}
+
+void PassManager::add(const char *name, PassFunction run)
+{
+	Pass pass;
+	pass.name = name;
+	pass.run = run;
+	_passes.push_back(pass);
+}
+
+void PassManager::add_level(int level)
+{
+	if (level >= 1) {
+		add("copy-propagation", copy_propagation);
+		add("constant-propagation", constant_propagation);
+	}
+	if (level >= 2) {
+		add("strength-reduction", strength_reduction);
+		add("copy-propagation", copy_propagation);
+	}
+	if (level >= 1) {
+		add("dead-store-elimination", dead_store_elimination);
+	}
+}
+
+void PassManager::record(const char *name, double seconds, int insns)
+{
+	Timing t;
+	t.name = name;
+	t.seconds = seconds;
+	t.insns = insns;
+	_timings.push_back(t);
+}
+
+void PassManager::run(IRFunction &fn)
+{
+	for (size_t i=0; i < _passes.size(); ++i) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		_passes[i].run(fn);
+		std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+		record(_passes[i].name, d.count(), fn.n_insns());
+	}
+}
+
+void PassManager::report(std::string &out) const
+{
+	char line[128];
+	double total = 0;
+	snprintf(line, sizeof(line), "%-24s %12s %8s\n", "pass", "time (us)", "insns");
+	out.append(line);
+	for (size_t i=0; i < _timings.size(); ++i) {
+		snprintf(line, sizeof(line), "%-24s %12.1f %8d\n", _timings[i].name,
+			_timings[i].seconds * 1e6, _timings[i].insns);
+		out.append(line);
+		total += _timings[i].seconds;
+	}
+	snprintf(line, sizeof(line), "%-24s %12.1f\n", "total", total * 1e6);
+	out.append(line);
+}
+
+} // namespace mpli
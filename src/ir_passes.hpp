@@ -0,0 +1,60 @@
+#ifndef MPLI_IR_PASSES_HPP_
+#define MPLI_IR_PASSES_HPP_
+
+#include "ir.hpp"
+#include <vector>
+#include <string>
+
+namespace mpli {
+
+/* Fold instructions whose operands are constants, drop asserts and range
+ * checks that always hold. Errors such as division by zero are left to
+ * happen at run time. */
+void constant_propagation(IRFunction &fn);
+/* Replace copies and PHIs with a single incoming value by their source. */
+void copy_propagation(IRFunction &fn);
+/* Remove definitions whose values are never used, including dead PHI
+ * cycles of variables that are assigned in a loop but never read. */
+void dead_store_elimination(IRFunction &fn);
+/* Replace multiplications by powers of two with shifts and drop
+ * identities (x + 0, x * 1, x / 1, x * 0, b & true). */
+void strength_reduction(IRFunction &fn);
+
+/*
+ * Runs a pipeline of passes, timing each of them.
+ */
+class PassManager {
+public:
+	typedef void (*PassFunction)(IRFunction &fn);
+
+private:
+	struct Pass {
+		const char *name;
+		PassFunction run;
+	};
+	struct Timing {
+		const char *name;
+		double seconds;
+		int insns;
+	};
+
+	std::vector<Pass> _passes;
+	std::vector<Timing> _timings;
+
+public:
+	/* -O0 runs nothing, -O1 propagation and dead store elimination,
+	 * -O2 also strength reduction */
+	static const int MAX_LEVEL = 2;
+
+	void add(const char *name, PassFunction run);
+	/* add passes of optimization level */
+	void add_level(int level);
+	/* record time of a step run outside the manager, e.g. lowering */
+	void record(const char *name, double seconds, int insns);
+	void run(IRFunction &fn);
+	/* one line per pass: time and instruction count after it */
+	void report(std::string &out) const;
+};
+
+} // namespace mpli
+#endif // MPLI_IR_PASSES_HPP_
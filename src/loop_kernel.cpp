@@ -0,0 +1,939 @@
+#include "loop_kernel.hpp"
+#include "int_conv.hpp"
+#include <algorithm>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define MPLI_AVX2_KERNEL 1
+#include <immintrin.h>
+#endif
+
+namespace mpli {
+
+LoopKernel::LoopKernel()
+{
+	_n_registers = 0;
+	_loop_register = -1;
+	_loop_location = -1;
+	_loop_symbol = -1;
+	_symbols = NULL;
+}
+
+int LoopKernel::new_register()
+{
+	return _n_registers++;
+}
+
+int LoopKernel::emit(KernelInsn::OP op, int a, int b)
+{
+	if (a < 0 || b < 0) {
+		return -1;
+	}
+	KernelInsn insn;
+	insn.op = op;
+	insn.dst = new_register();
+	insn.a = a;
+	insn.b = b;
+	_body.push_back(insn);
+	return insn.dst;
+}
+
+int LoopKernel::emit_const(int val)
+{
+	KernelInsn insn;
+	insn.op = KernelInsn::CONST;
+	insn.dst = new_register();
+	insn.a = val;
+	insn.b = 0;
+	_preamble.push_back(insn);
+	return insn.dst;
+}
+
+/* value of CONSTANT node in int context, returns 0 if it would not parse */
+static int constant_value(ASTNode *node, int *val)
+{
+	if (node->variable_type == ASTVariable::INTEGER) {
+		*val = node->int_value;
+		return 1;
+	}
+	const char *s = node->value.data();
+	return parse_int(s, s + node->value.size(), val) == PARSE_INT_OK;
+}
+
+static int find_symbol(const std::vector<int> &symbols, int symbol)
+{
+	for (size_t i=0; i < symbols.size(); ++i) {
+		if (symbols[i] == symbol) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+int LoopKernel::variable_register(int symbol, Symbol::TYPE type)
+{
+	if (_symbols->find(symbol).type != type) {
+		return -1;
+	}
+	if (symbol == _loop_symbol) {
+		return _loop_register;
+	}
+	int i = find_symbol(_temp_symbols, symbol);
+	if (i >= 0) {
+		return _temp_registers[i];
+	}
+	if (find_symbol(_assigned, symbol) >= 0) {
+		/* accumulator, or read before written in this iteration */
+		return -1;
+	}
+	i = find_symbol(_param_symbols, symbol);
+	if (i >= 0) {
+		return _param_registers[i];
+	}
+
+	/* loop invariant: loaded once before iterations */
+	KernelInsn insn;
+	insn.op = (type == Symbol::VARIABLE_INT) ? KernelInsn::LOAD_INT : KernelInsn::LOAD_BOOL;
+	insn.dst = new_register();
+	insn.a = _symbols->find(symbol).location;
+	insn.b = 0;
+	_preamble.push_back(insn);
+	_param_symbols.push_back(symbol);
+	_param_registers.push_back(insn.dst);
+	return insn.dst;
+}
+
+int LoopKernel::compile_int(ASTNode *node)
+{
+	int val;
+	switch (node->type) {
+		case ASTNode::OPERATOR:
+			return compile_int_calc(node);
+		case ASTNode::VAR_ID:
+			return variable_register(node->symbol, Symbol::VARIABLE_INT);
+		case ASTNode::CONSTANT:
+			if (!constant_value(node, &val)) {
+				return -1;
+			}
+			return emit_const(val);
+		default:
+			return -1;
+	}
+}
+
+int LoopKernel::compile_int_calc(ASTNode *node)
+{
+	int left = compile_int(node->children[0]);
+	int right = compile_int(node->children[1]);
+	int divisor;
+	switch (node->operator_type) {
+		case ASTOperator::ADD:
+			return emit(KernelInsn::ADD, left, right);
+		case ASTOperator::SUBTRACT:
+			return emit(KernelInsn::SUB, left, right);
+		case ASTOperator::MULTIPLY:
+			return emit(KernelInsn::MUL, left, right);
+		case ASTOperator::DIVIDE:
+			/* only divisions that cannot trap */
+			if (node->children[1]->type != ASTNode::CONSTANT ||
+				!constant_value(node->children[1], &divisor) ||
+				divisor == 0 || divisor == -1) {
+				return -1;
+			}
+			return emit(KernelInsn::DIV, left, right);
+		default:
+			return -1;
+	}
+}
+
+int LoopKernel::compile_bool(ASTNode *node)
+{
+	switch (node->type) {
+		case ASTNode::UNARY_OP:
+			return emit(KernelInsn::NOT, compile_bool(node->children[0]), 0);
+		case ASTNode::OPERATOR:
+			return compile_bool_calc(node);
+		case ASTNode::VAR_ID:
+			return variable_register(node->symbol, Symbol::VARIABLE_BOOL);
+		default:
+			return -1;
+	}
+}
+
+int LoopKernel::compile_bool_calc(ASTNode *node)
+{
+	ASTVariable::TYPE t = op_var_typing(node);
+	KernelInsn::OP op;
+	switch (node->operator_type) {
+		case ASTOperator::LESS_THAN:
+			return emit(KernelInsn::LT, compile_int(node->children[0]), compile_int(node->children[1]));
+		case ASTOperator::EQUALS:
+		case ASTOperator::NOT:
+			op = (node->operator_type == ASTOperator::EQUALS) ? KernelInsn::EQ : KernelInsn::NE;
+			switch (t) {
+				case ASTVariable::INTEGER:
+					return emit(op, compile_int(node->children[0]), compile_int(node->children[1]));
+				case ASTVariable::BOOLEAN:
+					return emit(op, compile_bool(node->children[0]), compile_bool(node->children[1]));
+				default:
+					return -1;
+			}
+		case ASTOperator::AND:
+			/* right side has no side effects, no need to short-circuit */
+			return emit(KernelInsn::AND, compile_bool(node->children[0]), compile_bool(node->children[1]));
+		default:
+			return -1;
+	}
+}
+
+int LoopKernel::compile_insert(ASTNode *node)
+{
+	Symbol s = _symbols->find(node->children[0]->symbol);
+	ASTNode *rhs = node->children[1];
+	int val;
+	switch (rhs->type) {
+		case ASTNode::OPERATOR:
+			if (s.type == Symbol::VARIABLE_INT) {
+				return compile_int_calc(rhs);
+			} else if (s.type == Symbol::VARIABLE_BOOL) {
+				return compile_bool_calc(rhs);
+			}
+			return -1;
+		case ASTNode::UNARY_OP:
+			if (s.type != Symbol::VARIABLE_BOOL) {
+				return -1;
+			}
+			return emit(KernelInsn::NOT, compile_bool(rhs->children[0]), 0);
+		case ASTNode::VAR_ID:
+			if (s.type != Symbol::VARIABLE_INT && s.type != Symbol::VARIABLE_BOOL) {
+				return -1;
+			}
+			return variable_register(rhs->symbol, s.type);
+		case ASTNode::CONSTANT:
+			if (s.type != Symbol::VARIABLE_INT || !constant_value(rhs, &val)) {
+				return -1;
+			}
+			return emit_const(val);
+		default:
+			return -1;
+	}
+}
+
+int LoopKernel::compile_assert(ASTNode *node)
+{
+	ASTNode *expr = node->children[0];
+	switch (expr->type) {
+		case ASTNode::UNARY_OP:
+			return emit(KernelInsn::NOT, compile_bool(expr->children[0]), 0);
+		case ASTNode::OPERATOR:
+			return compile_bool_calc(expr);
+		case ASTNode::VAR_ID:
+			return variable_register(expr->symbol, Symbol::VARIABLE_BOOL);
+		default:
+			return -1;
+	}
+}
+
+ASTNode *LoopKernel::reduction_operand(ASTNode *insert_node, Symbol::TYPE type, ACC_OP *op)
+{
+	int symbol = insert_node->children[0]->symbol;
+	ASTNode *rhs = insert_node->children[1];
+	if (rhs->type != ASTNode::OPERATOR) {
+		return NULL;
+	}
+
+	int commutative = 1;
+	if (type == Symbol::VARIABLE_INT) {
+		switch (rhs->operator_type) {
+			case ASTOperator::ADD:
+				*op = ACC_ADD;
+				break;
+			case ASTOperator::SUBTRACT:
+				*op = ACC_SUB;
+				commutative = 0;
+				break;
+			case ASTOperator::MULTIPLY:
+				*op = ACC_MUL;
+				break;
+			default:
+				return NULL;
+		}
+	} else if (type == Symbol::VARIABLE_BOOL && rhs->operator_type == ASTOperator::AND) {
+		*op = ACC_AND;
+	} else {
+		return NULL;
+	}
+
+	ASTNode *left = rhs->children[0];
+	ASTNode *right = rhs->children[1];
+	if (left->type == ASTNode::VAR_ID && left->symbol == symbol && !refers_to(right, symbol)) {
+		return right;
+	}
+	if (commutative && right->type == ASTNode::VAR_ID && right->symbol == symbol &&
+		!refers_to(left, symbol)) {
+		return left;
+	}
+	return NULL;
+}
+
+LoopKernel *LoopKernel::compile(ASTNode *for_node, const SymbolTable &symbols)
+{
+	ASTNode *in_node = for_node->children[0];
+	ASTNode *do_node = for_node->children[1];
+	std::vector<ASTNode*> &stmts = do_node->children;
+
+	LoopKernel *k = new LoopKernel;
+	k->_symbols = &symbols;
+	k->_loop_symbol = in_node->children[0]->symbol;
+	Symbol loop_symbol = symbols.find(k->_loop_symbol);
+	if (loop_symbol.type != Symbol::VARIABLE_INT) {
+		delete k;
+		return NULL;
+	}
+	k->_loop_location = loop_symbol.location;
+	k->_loop_register = k->new_register();
+
+	/* only assignments and asserts of expressions that can be compiled
+	 * recursively, loop variable is never assigned */
+	for (size_t i=0; i < stmts.size(); ++i) {
+		if (stmts[i]->height > ASTNode::RECURSIVE_HEIGHT) {
+			delete k;
+			return NULL;
+		}
+		if (stmts[i]->type == ASTNode::INSERT) {
+			if (stmts[i]->children[0]->symbol == k->_loop_symbol) {
+				delete k;
+				return NULL;
+			}
+			k->_assigned.push_back(stmts[i]->children[0]->symbol);
+		} else if (stmts[i]->type != ASTNode::ASSERT) {
+			delete k;
+			return NULL;
+		}
+	}
+
+	/* accumulators: assigned once in reduction form and read nowhere else */
+	std::vector<ASTNode*> operands(stmts.size(), (ASTNode*)NULL);
+	std::vector<ACC_OP> ops(stmts.size(), ACC_ADD);
+	for (size_t i=0; i < stmts.size(); ++i) {
+		if (stmts[i]->type != ASTNode::INSERT) {
+			continue;
+		}
+		int symbol = stmts[i]->children[0]->symbol;
+		int assignments = 0;
+		for (size_t j=0; j < k->_assigned.size(); ++j) {
+			assignments += (k->_assigned[j] == symbol);
+		}
+		if (assignments != 1) {
+			continue;
+		}
+		Symbol s = symbols.find(symbol);
+		ASTNode *operand = k->reduction_operand(stmts[i], s.type, &ops[i]);
+		if (!operand) {
+			continue;
+		}
+		int read_elsewhere = 0;
+		for (size_t j=0; j < stmts.size() && !read_elsewhere; ++j) {
+			read_elsewhere = (j != i && refers_to(stmts[j], symbol));
+		}
+		if (!read_elsewhere) {
+			operands[i] = operand;
+		}
+	}
+
+	/* compile statements in order */
+	for (size_t i=0; i < stmts.size(); ++i) {
+		int reg;
+		if (stmts[i]->type == ASTNode::ASSERT) {
+			if (k->emit(KernelInsn::ASSERT, k->compile_assert(stmts[i]), 0) < 0) {
+				delete k;
+				return NULL;
+			}
+			continue;
+		}
+
+		int symbol = stmts[i]->children[0]->symbol;
+		Symbol s = symbols.find(symbol);
+		if (operands[i]) {
+			if (s.type == Symbol::VARIABLE_INT) {
+				reg = k->compile_int(operands[i]);
+			} else {
+				reg = k->compile_bool(operands[i]);
+			}
+			Accumulator acc;
+			acc.op = ops[i];
+			acc.type = s.type;
+			acc.location = s.location;
+			KernelInsn insn;
+			insn.op = KernelInsn::REDUCE;
+			insn.dst = k->_accumulators.size();
+			insn.a = reg;
+			insn.b = acc.op;
+			if (reg < 0) {
+				delete k;
+				return NULL;
+			}
+			k->_accumulators.push_back(acc);
+			k->_acc_symbols.push_back(symbol);
+			k->_body.push_back(insn);
+		} else {
+			reg = k->compile_insert(stmts[i]);
+			if (reg < 0) {
+				delete k;
+				return NULL;
+			}
+			/* reads after this point see the new value */
+			int t = find_symbol(k->_temp_symbols, symbol);
+			if (t >= 0) {
+				k->_temp_registers[t] = reg;
+			} else {
+				k->_temp_symbols.push_back(symbol);
+				k->_temp_registers.push_back(reg);
+			}
+		}
+	}
+
+	for (size_t i=0; i < k->_temp_symbols.size(); ++i) {
+		Symbol s = symbols.find(k->_temp_symbols[i]);
+		Temporary t;
+		t.type = s.type;
+		t.location = s.location;
+		t.reg = k->_temp_registers[i];
+		k->_temporaries.push_back(t);
+	}
+	k->_symbols = NULL;
+	return k;
+}
+
+int LoopKernel::n_registers() const
+{
+	return _n_registers;
+}
+
+int LoopKernel::n_accumulators() const
+{
+	return _accumulators.size();
+}
+
+const std::vector<LoopKernel::Accumulator> &LoopKernel::accumulators() const
+{
+	return _accumulators;
+}
+
+const std::vector<LoopKernel::Temporary> &LoopKernel::temporaries() const
+{
+	return _temporaries;
+}
+
+int LoopKernel::loop_location() const
+{
+	return _loop_location;
+}
+
+void LoopKernel::load(int *regs, const std::vector<int> &int_values,
+	const std::vector<int> &bool_values) const
+{
+	for (size_t i=0; i < _preamble.size(); ++i) {
+		const KernelInsn &insn = _preamble[i];
+		switch (insn.op) {
+			case KernelInsn::CONST:
+				regs[insn.dst] = insn.a;
+				break;
+			case KernelInsn::LOAD_INT:
+				regs[insn.dst] = int_values[insn.a];
+				break;
+			case KernelInsn::LOAD_BOOL:
+				regs[insn.dst] = bool_values[insn.a];
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+void LoopKernel::init_partials(int *partials) const
+{
+	for (size_t i=0; i < _accumulators.size(); ++i) {
+		switch (_accumulators[i].op) {
+			case ACC_MUL:
+			case ACC_AND:
+				partials[i] = 1;
+				break;
+			default:
+				partials[i] = 0;
+		}
+	}
+}
+
+/* combine two partial reductions of an accumulator */
+static int combine_partials(LoopKernel::ACC_OP op, unsigned int p, unsigned int o)
+{
+	switch (op) {
+		case LoopKernel::ACC_MUL:
+			return (int)(p * o);
+		case LoopKernel::ACC_AND:
+			return (p && o);
+		default:
+			/* subtraction accumulates the sum of subtrahends */
+			return (int)(p + o);
+	}
+}
+
+void LoopKernel::merge_partials(int *partials, const int *other) const
+{
+	for (size_t i=0; i < _accumulators.size(); ++i) {
+		partials[i] = combine_partials(_accumulators[i].op, partials[i], other[i]);
+	}
+}
+
+long long LoopKernel::run(int first, int last, int *regs, int *partials) const
+{
+	const KernelInsn *code = _body.empty() ? NULL : &_body[0];
+	const int n = _body.size();
+	for (long long i=first; i <= last; ++i) {
+		regs[_loop_register] = (int)i;
+		for (int pc=0; pc < n; ++pc) {
+			const KernelInsn &insn = code[pc];
+			/* arithmetic wraps around like the tree walker on int */
+			unsigned int a = regs[insn.a], b = regs[insn.b];
+			switch (insn.op) {
+				case KernelInsn::ADD:
+					regs[insn.dst] = (int)(a + b);
+					break;
+				case KernelInsn::SUB:
+					regs[insn.dst] = (int)(a - b);
+					break;
+				case KernelInsn::MUL:
+					regs[insn.dst] = (int)(a * b);
+					break;
+				case KernelInsn::DIV:
+					regs[insn.dst] = regs[insn.a] / regs[insn.b];
+					break;
+				case KernelInsn::LT:
+					regs[insn.dst] = (regs[insn.a] < regs[insn.b]);
+					break;
+				case KernelInsn::EQ:
+					regs[insn.dst] = (a == b);
+					break;
+				case KernelInsn::NE:
+					regs[insn.dst] = (a != b);
+					break;
+				case KernelInsn::AND:
+					regs[insn.dst] = (a && b);
+					break;
+				case KernelInsn::NOT:
+					regs[insn.dst] = !a;
+					break;
+				case KernelInsn::REDUCE:
+					switch (insn.b) {
+						case ACC_ADD:
+						case ACC_SUB:
+							partials[insn.dst] = (int)((unsigned int)partials[insn.dst] + a);
+							break;
+						case ACC_MUL:
+							partials[insn.dst] = (int)((unsigned int)partials[insn.dst] * a);
+							break;
+						case ACC_AND:
+							partials[insn.dst] = (partials[insn.dst] && a);
+							break;
+					}
+					break;
+				case KernelInsn::ASSERT:
+					if (!a) {
+						return i;
+					}
+					break;
+				default:
+					break;
+			}
+		}
+	}
+	return (long long)last + 1;
+}
+
+/* Lane-wise evaluation of a block of LANES iterations. Returns bit mask
+ * of lanes whose assert failed. */
+static unsigned int run_lanes_scalar(const KernelInsn *code, int n, int *lanes, int *acc_lanes)
+{
+	const int L = LoopKernel::LANES;
+	unsigned int failed = 0;
+	for (int pc=0; pc < n; ++pc) {
+		const KernelInsn &insn = code[pc];
+		int *d = &lanes[insn.dst * L];
+		const int *a = &lanes[insn.a * L];
+		const int *b = &lanes[insn.b * L];
+		int *acc;
+		int l;
+		switch (insn.op) {
+			case KernelInsn::ADD:
+				for (l=0; l < L; ++l) d[l] = (int)((unsigned int)a[l] + (unsigned int)b[l]);
+				break;
+			case KernelInsn::SUB:
+				for (l=0; l < L; ++l) d[l] = (int)((unsigned int)a[l] - (unsigned int)b[l]);
+				break;
+			case KernelInsn::MUL:
+				for (l=0; l < L; ++l) d[l] = (int)((unsigned int)a[l] * (unsigned int)b[l]);
+				break;
+			case KernelInsn::DIV:
+				for (l=0; l < L; ++l) d[l] = a[l] / b[l];
+				break;
+			case KernelInsn::LT:
+				for (l=0; l < L; ++l) d[l] = (a[l] < b[l]);
+				break;
+			case KernelInsn::EQ:
+				for (l=0; l < L; ++l) d[l] = (a[l] == b[l]);
+				break;
+			case KernelInsn::NE:
+				for (l=0; l < L; ++l) d[l] = (a[l] != b[l]);
+				break;
+			case KernelInsn::AND:
+				/* bool registers are always 0 or 1 */
+				for (l=0; l < L; ++l) d[l] = a[l] & b[l];
+				break;
+			case KernelInsn::NOT:
+				for (l=0; l < L; ++l) d[l] = !a[l];
+				break;
+			case KernelInsn::REDUCE:
+				acc = &acc_lanes[insn.dst * L];
+				switch (insn.b) {
+					case LoopKernel::ACC_ADD:
+					case LoopKernel::ACC_SUB:
+						for (l=0; l < L; ++l) acc[l] = (int)((unsigned int)acc[l] + (unsigned int)a[l]);
+						break;
+					case LoopKernel::ACC_MUL:
+						for (l=0; l < L; ++l) acc[l] = (int)((unsigned int)acc[l] * (unsigned int)a[l]);
+						break;
+					case LoopKernel::ACC_AND:
+						for (l=0; l < L; ++l) acc[l] &= a[l];
+						break;
+				}
+				break;
+			case KernelInsn::ASSERT:
+				for (l=0; l < L; ++l) {
+					if (!a[l]) failed |= (1u << l);
+				}
+				break;
+			default:
+				break;
+		}
+	}
+	return failed;
+}
+
+#ifdef MPLI_AVX2_KERNEL
+__attribute__((target("avx2")))
+static unsigned int run_lanes_avx2(const KernelInsn *code, int n, int *lanes, int *acc_lanes)
+{
+	const int L = LoopKernel::LANES;
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256i zero = _mm256_setzero_si256();
+	unsigned int failed = 0;
+	for (int pc=0; pc < n; ++pc) {
+		const KernelInsn &insn = code[pc];
+		__m256i *d = (__m256i*)&lanes[insn.dst * L];
+		__m256i *acc;
+		__m256i a = _mm256_loadu_si256((const __m256i*)&lanes[insn.a * L]);
+		__m256i b = _mm256_loadu_si256((const __m256i*)&lanes[insn.b * L]);
+		__m256i r;
+		switch (insn.op) {
+			case KernelInsn::ADD:
+				_mm256_storeu_si256(d, _mm256_add_epi32(a, b));
+				break;
+			case KernelInsn::SUB:
+				_mm256_storeu_si256(d, _mm256_sub_epi32(a, b));
+				break;
+			case KernelInsn::MUL:
+				_mm256_storeu_si256(d, _mm256_mullo_epi32(a, b));
+				break;
+			case KernelInsn::DIV: {
+				/* no integer division in AVX2, divisor is a constant */
+				int *dl = &lanes[insn.dst * L];
+				const int *al = &lanes[insn.a * L];
+				int divisor = lanes[insn.b * L];
+				for (int l=0; l < L; ++l) dl[l] = al[l] / divisor;
+				break;
+			}
+			case KernelInsn::LT:
+				_mm256_storeu_si256(d, _mm256_and_si256(_mm256_cmpgt_epi32(b, a), one));
+				break;
+			case KernelInsn::EQ:
+				_mm256_storeu_si256(d, _mm256_and_si256(_mm256_cmpeq_epi32(a, b), one));
+				break;
+			case KernelInsn::NE:
+				_mm256_storeu_si256(d, _mm256_andnot_si256(_mm256_cmpeq_epi32(a, b), one));
+				break;
+			case KernelInsn::AND:
+				_mm256_storeu_si256(d, _mm256_and_si256(a, b));
+				break;
+			case KernelInsn::NOT:
+				_mm256_storeu_si256(d, _mm256_and_si256(_mm256_cmpeq_epi32(a, zero), one));
+				break;
+			case KernelInsn::REDUCE:
+				acc = (__m256i*)&acc_lanes[insn.dst * L];
+				r = _mm256_loadu_si256(acc);
+				switch (insn.b) {
+					case LoopKernel::ACC_ADD:
+					case LoopKernel::ACC_SUB:
+						r = _mm256_add_epi32(r, a);
+						break;
+					case LoopKernel::ACC_MUL:
+						r = _mm256_mullo_epi32(r, a);
+						break;
+					case LoopKernel::ACC_AND:
+						r = _mm256_and_si256(r, a);
+						break;
+				}
+				_mm256_storeu_si256(acc, r);
+				break;
+			case KernelInsn::ASSERT:
+				failed |= (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, zero)));
+				break;
+			default:
+				break;
+		}
+	}
+	return failed;
+}
+#endif
+
+typedef unsigned int (*RunLanesFunction)(const KernelInsn *code, int n, int *lanes, int *acc_lanes);
+
+/* AVX2 when the CPU has it, plain lane loops otherwise */
+static RunLanesFunction select_run_lanes()
+{
+#ifdef MPLI_AVX2_KERNEL
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return run_lanes_avx2;
+	}
+#endif
+	return run_lanes_scalar;
+}
+
+int LoopKernel::batch_scratch_size() const
+{
+	return (_n_registers + _accumulators.size()) * LANES;
+}
+
+long long LoopKernel::run_batch(int first, int last, int *regs, int *scratch, int *partials) const
+{
+	static const RunLanesFunction run_lanes = select_run_lanes();
+
+	long long n = (long long)last - first + 1;
+	long long blocks = _body.empty() ? 0 : n / LANES;
+	if (blocks > 0) {
+		int *lanes = scratch;
+		int *acc_lanes = scratch + _n_registers * LANES;
+		for (int r=0; r < _n_registers; ++r) {
+			for (int l=0; l < LANES; ++l) {
+				lanes[r * LANES + l] = regs[r];
+			}
+		}
+		for (size_t a=0; a < _accumulators.size(); ++a) {
+			int identity = (_accumulators[a].op == ACC_MUL || _accumulators[a].op == ACC_AND);
+			for (int l=0; l < LANES; ++l) {
+				acc_lanes[a * LANES + l] = identity;
+			}
+		}
+
+		int *loop_lanes = &lanes[_loop_register * LANES];
+		for (long long blk=0; blk < blocks; ++blk) {
+			long long base = first + blk * LANES;
+			for (int l=0; l < LANES; ++l) {
+				loop_lanes[l] = (int)(base + l);
+			}
+			unsigned int failed = run_lanes(&_body[0], _body.size(), lanes, acc_lanes);
+			if (failed) {
+				/* lanes do not depend on each other: lowest lane is the
+				 * first failing iteration */
+				return base + __builtin_ctz(failed);
+			}
+		}
+
+		/* fold lanes into partials, registers of the last lane */
+		for (size_t a=0; a < _accumulators.size(); ++a) {
+			for (int l=0; l < LANES; ++l) {
+				partials[a] = combine_partials(_accumulators[a].op, partials[a], acc_lanes[a * LANES + l]);
+			}
+		}
+		for (int r=0; r < _n_registers; ++r) {
+			regs[r] = lanes[r * LANES + LANES - 1];
+		}
+	}
+
+	long long tail = first + blocks * LANES;
+	if (tail <= last) {
+		return run((int)tail, last, regs, partials);
+	}
+	return (long long)last + 1;
+}
+
+/* base^exponent with wrapping multiplication */
+static unsigned int power(unsigned int base, long long exponent)
+{
+	unsigned int r = 1;
+	while (exponent > 0) {
+		if (exponent & 1) {
+			r *= base;
+		}
+		base *= base;
+		exponent >>= 1;
+	}
+	return r;
+}
+
+int LoopKernel::closed_form_scratch_size() const
+{
+	return 3 * _n_registers + _accumulators.size();
+}
+
+int LoopKernel::closed_form(int first, int last, const int *loaded, int *partials, int *regs,
+	int *scratch) const
+{
+	/* every register as coef * i + base (mod 2^32), or not affine */
+	unsigned int *coef = (unsigned int*)scratch;
+	unsigned int *base = coef + _n_registers;
+	int *affine = scratch + 2 * _n_registers;
+	int *last_partials = scratch + 3 * _n_registers;
+	for (int r=0; r < _n_registers; ++r) {
+		coef[r] = 0;
+		base[r] = loaded[r];
+		affine[r] = 1;
+	}
+	coef[_loop_register] = 1;
+	base[_loop_register] = 0;
+
+	long long n = (long long)last - first + 1;
+	/* first + ... + last, one of n and first + last is even */
+	long long ends = (long long)first + last;
+	unsigned int sum = (n % 2 == 0) ? (unsigned int)(n / 2) * (unsigned int)ends
+		: (unsigned int)n * (unsigned int)(ends / 2);
+
+	init_partials(partials);
+	for (size_t pc=0; pc < _body.size(); ++pc) {
+		const KernelInsn &insn = _body[pc];
+		int d = insn.dst, a = insn.a, b = insn.b;
+		int constant = (insn.op == KernelInsn::REDUCE || insn.op == KernelInsn::ASSERT) ?
+			affine[a] && coef[a] == 0 : affine[a] && coef[a] == 0 && affine[b] && coef[b] == 0;
+		int va = (int)base[a], vb = (int)base[b];
+		switch (insn.op) {
+			case KernelInsn::ADD:
+				affine[d] = affine[a] && affine[b];
+				coef[d] = coef[a] + coef[b];
+				base[d] = base[a] + base[b];
+				break;
+			case KernelInsn::SUB:
+				affine[d] = affine[a] && affine[b];
+				coef[d] = coef[a] - coef[b];
+				base[d] = base[a] - base[b];
+				break;
+			case KernelInsn::MUL:
+				/* stays affine if one factor is invariant */
+				if (affine[a] && affine[b] && coef[b] == 0) {
+					coef[d] = coef[a] * base[b];
+					base[d] = base[a] * base[b];
+				} else if (affine[a] && affine[b] && coef[a] == 0) {
+					coef[d] = base[a] * coef[b];
+					base[d] = base[a] * base[b];
+				} else {
+					affine[d] = 0;
+				}
+				break;
+			case KernelInsn::DIV:
+				affine[d] = constant;
+				base[d] = constant ? va / vb : 0;
+				break;
+			case KernelInsn::LT:
+				affine[d] = constant;
+				base[d] = (va < vb);
+				break;
+			case KernelInsn::EQ:
+				affine[d] = constant;
+				base[d] = (va == vb);
+				break;
+			case KernelInsn::NE:
+				affine[d] = constant;
+				base[d] = (va != vb);
+				break;
+			case KernelInsn::AND:
+				affine[d] = constant;
+				base[d] = (va && vb);
+				break;
+			case KernelInsn::NOT:
+				affine[d] = affine[a] && coef[a] == 0;
+				base[d] = !va;
+				break;
+			case KernelInsn::REDUCE:
+				switch (b) {
+					case ACC_ADD:
+					case ACC_SUB:
+						/* sum of coef * i + base over the range */
+						if (!affine[a]) {
+							return 0;
+						}
+						partials[d] = (int)(coef[a] * sum + base[a] * (unsigned int)n);
+						break;
+					case ACC_MUL:
+						if (!constant) {
+							return 0;
+						}
+						partials[d] = (int)power(base[a], n);
+						break;
+					case ACC_AND:
+						if (!constant) {
+							return 0;
+						}
+						partials[d] = (va != 0);
+						break;
+				}
+				break;
+			case KernelInsn::ASSERT:
+				/* only asserts that hold in every iteration */
+				if (!constant || va == 0) {
+					return 0;
+				}
+				break;
+			default:
+				break;
+		}
+		if (insn.op != KernelInsn::REDUCE && insn.op != KernelInsn::ASSERT && !affine[d]) {
+			coef[d] = 0;
+		}
+	}
+
+	/* temporaries keep their values of the last iteration */
+	std::copy(loaded, loaded + _n_registers, regs);
+	run(last, last, regs, _accumulators.empty() ? NULL : last_partials);
+	return 1;
+}
+
+void LoopKernel::store(const int *partials, const int *last_regs, int final_value,
+	std::vector<int> &int_values, std::vector<int> &bool_values) const
+{
+	for (size_t i=0; i < _accumulators.size(); ++i) {
+		const Accumulator &acc = _accumulators[i];
+		std::vector<int> &values = (acc.type == Symbol::VARIABLE_INT) ? int_values : bool_values;
+		unsigned int v = values[acc.location], p = partials[i];
+		switch (acc.op) {
+			case ACC_ADD:
+				values[acc.location] = (int)(v + p);
+				break;
+			case ACC_SUB:
+				values[acc.location] = (int)(v - p);
+				break;
+			case ACC_MUL:
+				values[acc.location] = (int)(v * p);
+				break;
+			case ACC_AND:
+				values[acc.location] = (v && p);
+				break;
+		}
+	}
+	for (size_t i=0; i < _temporaries.size(); ++i) {
+		const Temporary &t = _temporaries[i];
+		std::vector<int> &values = (t.type == Symbol::VARIABLE_INT) ? int_values : bool_values;
+		values[t.location] = last_regs[t.reg];
+	}
+	int_values[_loop_location] = final_value;
+}
+
+} // namespace mpli
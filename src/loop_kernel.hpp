@@ -0,0 +1,156 @@
+#ifndef MPLI_LOOP_KERNEL_HPP_
+#define MPLI_LOOP_KERNEL_HPP_
+
+#include "ast.hpp"
+#include "symbol_table.hpp"
+#include <vector>
+#include <string>
+
+namespace mpli {
+
+/*
+ * Instruction of a loop kernel. Operands are register indices, bools are
+ * kept as 0/1 ints like in the interpreter.
+ */
+struct KernelInsn {
+	enum OP {
+		CONST,		/* dst = a */
+		LOAD_INT,	/* dst = int variable at location a */
+		LOAD_BOOL,	/* dst = bool variable at location a */
+		ADD,		/* dst = a + b, wrapping */
+		SUB,		/* dst = a - b, wrapping */
+		MUL,		/* dst = a * b, wrapping */
+		DIV,		/* dst = a / b, b is a non-zero constant */
+		LT,			/* dst = a < b */
+		EQ,			/* dst = a == b */
+		NE,			/* dst = a != b */
+		AND,		/* dst = a && b */
+		NOT,		/* dst = !a */
+		REDUCE,		/* partial[dst] op= a, op given by accumulator */
+		ASSERT		/* stop if a is false */
+	};
+
+	OP op;
+	int dst;
+	int a;
+	int b;
+};
+
+/*
+ * Body of a FOR_DO block compiled into a register program, for loops whose
+ * iterations are independent apart from recognized reductions:
+ *  - the body has only assignments and asserts,
+ *  - every variable assigned in the body is either an accumulator
+ *    (acc := acc + e, acc - e, acc * e for ints, acc & e for bools, where
+ *    acc is not read anywhere else in the body) or a temporary that is
+ *    always assigned before it is read in the same iteration,
+ *  - nothing in the body can raise an error, e.g. divisors are non-zero
+ *    constants.
+ * Such iterations can run in any grouping, partial reductions are merged
+ * afterwards.
+ */
+class LoopKernel {
+public:
+	enum ACC_OP { ACC_ADD, ACC_SUB, ACC_MUL, ACC_AND };
+
+	/* number of consecutive iterations run_batch evaluates together */
+	static const int LANES = 8;
+
+	struct Accumulator {
+		ACC_OP op;
+		Symbol::TYPE type;
+		int location;
+	};
+
+	struct Temporary {
+		Symbol::TYPE type;
+		int location;
+		/* register holding the value after the last iteration */
+		int reg;
+	};
+
+private:
+	/* CONST and LOAD instructions, run once per chunk */
+	std::vector<KernelInsn> _preamble;
+	/* instructions run for every iteration */
+	std::vector<KernelInsn> _body;
+	std::vector<Accumulator> _accumulators;
+	std::vector<Temporary> _temporaries;
+	int _n_registers;
+	int _loop_register;
+	int _loop_location;
+
+	/* compile state */
+	const SymbolTable *_symbols;
+	/* variables by symbol id, see ASTNode::symbol */
+	int _loop_symbol;
+	std::vector<int> _assigned;
+	std::vector<int> _param_symbols;
+	std::vector<int> _param_registers;
+	std::vector<int> _temp_symbols;
+	std::vector<int> _temp_registers;
+	std::vector<int> _acc_symbols;
+
+	LoopKernel();
+
+	int new_register();
+	int emit(KernelInsn::OP op, int a, int b);
+	int emit_const(int val);
+	/* register of variable read, -1 if read is not allowed */
+	int variable_register(int symbol, Symbol::TYPE type);
+	/* Compile expressions the same way int_for_op, bool_for_op etc.
+	 * evaluate them. Return result register, -1 if not compilable. */
+	int compile_int(ASTNode *node);
+	int compile_int_calc(ASTNode *node);
+	int compile_bool(ASTNode *node);
+	int compile_bool_calc(ASTNode *node);
+	int compile_insert(ASTNode *node);
+	int compile_assert(ASTNode *node);
+	/* accumulator candidate: returns expression combined into target */
+	ASTNode *reduction_operand(ASTNode *insert_node, Symbol::TYPE type, ACC_OP *op);
+
+public:
+	/* Compile FOR_LOOP node. Returns NULL if iterations are not provably
+	 * independent. */
+	static LoopKernel *compile(ASTNode *for_node, const SymbolTable &symbols);
+
+	int n_registers() const;
+	int n_accumulators() const;
+	const std::vector<Accumulator> &accumulators() const;
+	const std::vector<Temporary> &temporaries() const;
+	int loop_location() const;
+
+	/* fill preamble registers from variable values */
+	void load(int *regs, const std::vector<int> &int_values,
+		const std::vector<int> &bool_values) const;
+	/* set partial accumulators to identity values */
+	void init_partials(int *partials) const;
+	/* partials = partials op other */
+	void merge_partials(int *partials, const int *other) const;
+	/* Run iterations first..last with loaded registers. Returns index of
+	 * first iteration whose assert failed, or last + 1. */
+	long long run(int first, int last, int *regs, int *partials) const;
+	/* ints of scratch space run_batch needs */
+	int batch_scratch_size() const;
+	/* Same as run(), but evaluates blocks of LANES iterations at once
+	 * with SIMD instructions when available. */
+	long long run_batch(int first, int last, int *regs, int *scratch, int *partials) const;
+	/* Evaluate iterations first..last without running them, when every
+	 * reduction operand is affine in the loop variable (arithmetic series)
+	 * or invariant (geometric growth, counting) and every assert holds.
+	 * Fills partials and the registers of the last iteration from loaded
+	 * registers, using closed_form_scratch_size() ints of scratch.
+	 * Returns 0 if the loop has no closed form. */
+	int closed_form(int first, int last, const int *loaded, int *partials, int *regs,
+		int *scratch) const;
+	/* ints of scratch space closed_form needs */
+	int closed_form_scratch_size() const;
+	/* Store results of a finished loop: accumulators combined with merged
+	 * partials, temporaries from regs of the last iteration and loop
+	 * variable set to final_value. */
+	void store(const int *partials, const int *last_regs, int final_value,
+		std::vector<int> &int_values, std::vector<int> &bool_values) const;
+};
+
+} // namespace mpli
+#endif // MPLI_LOOP_KERNEL_HPP_
@@ -2,54 +2,631 @@
 #define DEBUG_MPLI 0
 
 
-#include "scanner.hpp"
 #include "parser.hpp"
 #include "ast.hpp"
 #include "interpreter.hpp"
+#include "ir_passes.hpp"
+#include "output_buffer.hpp"
+#include "program_cache.hpp"
+#include "program.hpp"
+#include "batch_runner.hpp"
+#include "server.hpp"
+#include "profiler.hpp"
+#include "sampler.hpp"
+#include "stats.hpp"
 
 #include <iostream>
+#include <fstream>
 #include <string>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+#include <unistd.h>
+
+/* default --precompute budget, in executed statements */
+static const unsigned long long DEFAULT_PRECOMPUTE_STEPS = 1000000;
+
+static void usage(const char *prog)
+{
+    std::cerr << "Usage: " << prog << " [OPTIONS] FILENAME" << std::endl
+              << "       " << prog << " [OPTIONS] --batch DIRECTORY|LISTFILE" << std::endl
+              << "       " << prog << " [OPTIONS] --serve SOCKET" << std::endl
+              << "       " << prog << " [--repeat=N] [--threads=N] --client SOCKET FILENAME" << std::endl
+              << "Options:" << std::endl
+              << "  --flush=POLICY  when print output is written out: exit, read," << std::endl
+              << "                  newline or a byte count (default: newline on" << std::endl
+              << "                  a terminal, read otherwise)" << std::endl
+              << "  --threads=N     run for loops with independent iterations on" << std::endl
+              << "                  N threads (default 1)" << std::endl
+              << "  --no-vectorize  do not evaluate such loops in SIMD batches" << std::endl
+              << "  --no-closed-form" << std::endl
+              << "                  run sums and products over a range iteration by" << std::endl
+              << "                  iteration instead of computing them directly" << std::endl
+              << "  --max-depth=N   report an error for parentheses and loops nested" << std::endl
+              << "                  deeper than N levels (default " << mpli::Parser::DEFAULT_MAX_DEPTH << ")" << std::endl
+              << "  --no-hoist      evaluate loop-invariant and repeated expressions" << std::endl
+              << "                  every time instead of caching them" << std::endl
+              << "  --opt-report    list expressions moved out of loops or shared" << std::endl
+              << "                  on stderr" << std::endl
+              << "  -O0, -O1, -O2   lower the program into SSA IR, optimize it at the" << std::endl
+              << "                  given level and run it on the IR backend" << std::endl
+              << "  --time-passes   print time spent lowering and in every IR pass" << std::endl
+              << "  --dump-ir       print the optimized IR on stderr" << std::endl
+              << "  --precompute[=STEPS]" << std::endl
+              << "                  evaluate programs without read statements up to" << std::endl
+              << "                  STEPS statements ahead (default " << DEFAULT_PRECOMPUTE_STEPS << ") and" << std::endl
+              << "                  cache their output for later runs" << std::endl
+              << "  --cache-dir=DIR directory of cached programs and results (default:" << std::endl
+              << "                  $XDG_CACHE_HOME/mpli or ~/.cache/mpli)" << std::endl
+              << "  --no-cache      always parse the source, do not read or write" << std::endl
+              << "                  the cache" << std::endl
+              << "  --batch         run all .mpl files of DIRECTORY, or files listed" << std::endl
+              << "                  in LISTFILE, on --threads threads in one process" << std::endl
+              << "  --serve         keep compiled programs warm and run requests of" << std::endl
+              << "                  --client on SOCKET with --threads workers" << std::endl
+              << "  --client        run FILENAME on the server at SOCKET, with stdin" << std::endl
+              << "                  as input unless it is a terminal" << std::endl
+              << "  --repeat=N      with --client, send the request N times on each" << std::endl
+              << "                  of --threads connections and print latencies" << std::endl
+              << "  --profile[=FILE]" << std::endl
+              << "                  count and time every statement and operator, print" << std::endl
+              << "                  a report on stderr and folded stacks into FILE;" << std::endl
+              << "                  loops then run statement by statement on the AST" << std::endl
+              << "                  interpreter" << std::endl
+              << "  --sample[=HZ]   sample the executing statement HZ times per second" << std::endl
+              << "                  of CPU time (1000 by default) and print the hottest" << std::endl
+              << "                  lines on stderr" << std::endl
+              << "  --stats[=json]  print time, allocations and counters of every phase" << std::endl
+              << "                  on stderr, as text or JSON" << std::endl
+              << "  --perf[=statements]" << std::endl
+              << "                  add instructions, cycles, branch and cache misses" << std::endl
+              << "                  of every phase, or of every top-level statement," << std::endl
+              << "                  to --stats" << std::endl;
+}
+
+/* start phase of stats, if they are collected */
+static void begin_phase(mpli::Stats *stats, const char *name)
+{
+    if (stats) {
+        stats->begin(name);
+    }
+}
+
+static void print_stats(mpli::Stats *stats, int json)
+{
+    if (!stats) {
+        return;
+    }
+    stats->end();
+    std::string text;
+    if (json) {
+        stats->report_json(text);
+    } else {
+        stats->report_text(text);
+    }
+    std::cerr << text;
+}
+
+/* per connection part of run_client */
+struct ClientRun {
+    const std::string *socket_path;
+    const std::string *source;
+    const std::string *input;
+    int repeat;
+    std::vector<double> latencies;
+    std::string output;
+    int status;
+};
+
+static void client_thread(ClientRun *run)
+{
+    mpli::Client client;
+    run->status = -1;
+    if (client.connect(*run->socket_path) != 0) {
+        return;
+    }
+    for (int i=0; i < run->repeat; ++i) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        run->status = client.run(*run->source, *run->input, run->output);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (run->status < 0) {
+            return;
+        }
+        run->latencies.push_back(elapsed.count());
+    }
+}
+
+/* Send filename to server on socket_path, print its output, or latency
+ * percentiles when repeating. Returns exit status of mpli: status of
+ * the program, see BatchRunner::STATUS, or 5 if server cannot be used. */
+static int run_client(const std::string &socket_path, const char *filename,
+    int repeat, int connections)
+{
+    using namespace mpli;
+
+    std::string source, input;
+    if (Program::read_file(filename, source) != 0) {
+        std::cerr << "Cannot read " << filename << std::endl;
+        return BatchRunner::NO_FILE;
+    }
+    if (!isatty(0)) {
+        Program::read_file("/dev/stdin", input);
+    }
+
+    std::vector<ClientRun> runs(connections);
+    std::vector<std::thread> threads;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i=0; i < connections; ++i) {
+        runs[i].socket_path = &socket_path;
+        runs[i].source = &source;
+        runs[i].input = &input;
+        runs[i].repeat = repeat;
+        threads.push_back(std::thread(client_thread, &runs[i]));
+    }
+    for (int i=0; i < connections; ++i) {
+        threads[i].join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    for (int i=0; i < connections; ++i) {
+        if (runs[i].status < 0) {
+            std::cerr << "Request to " << socket_path << " failed." << std::endl;
+            return 5;
+        }
+    }
+
+    if (repeat > 1 || connections > 1) {
+        std::vector<double> all;
+        for (int i=0; i < connections; ++i) {
+            all.insert(all.end(), runs[i].latencies.begin(), runs[i].latencies.end());
+        }
+        std::sort(all.begin(), all.end());
+        const double points[] = {0.5, 0.9, 0.99, 1.0};
+        const char *names[] = {"p50", "p90", "p99", "max"};
+        std::cerr << "client: " << all.size() << " requests, "
+                  << all.size() / elapsed.count() << " requests/s, latency us:";
+        for (int i=0; i < 4; ++i) {
+            size_t k = (size_t)(points[i] * (all.size() - 1) + 0.5);
+            std::cerr << " " << names[i] << " " << (int)(all[k] * 1e6);
+        }
+        std::cerr << std::endl;
+    }
+    OutputBuffer output;
+    output.write(runs[0].output);
+    output.flush();
+    return runs[0].status;
+}
+
+/* Run scripts of a directory or list file with BatchRunner and print
+ * their output and status in order. Returns exit status of mpli. */
+static int run_batch(const char *path, const mpli::Program::Options &options,
+    int threads, int vectorize, int closed_form)
+{
+    using namespace mpli;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    BatchRunner runner(options, threads);
+    runner.set_loop_batching(vectorize);
+    runner.set_closed_form_loops(closed_form);
+    if (runner.add_list(path) != 0) {
+        std::cerr << "Cannot read batch " << path << std::endl;
+        return 1;
+    }
+    runner.run();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    const std::vector<BatchRunner::Script> &scripts = runner.scripts();
+    OutputBuffer output;
+    int failed = 0;
+    for (size_t i=0; i < scripts.size(); ++i) {
+        output.write_format("==> %s <==\n", scripts[i].path.c_str());
+        output.write(scripts[i].output);
+        output.write_format("\n==> exit %d <==\n", (int)scripts[i].status);
+        if (scripts[i].status != BatchRunner::OK) {
+            ++failed;
+        }
+    }
+    output.flush();
+    std::cerr << "batch: " << scripts.size() << " scripts, " << runner.n_programs()
+              << " programs, " << failed << " failed, " << elapsed.count() << " s, "
+              << (elapsed.count() > 0 ? scripts.size() / elapsed.count() : 0)
+              << " scripts/s" << std::endl;
+    return 0;
+}
+
+/* Print precomputed result of a program: result of execute as first
+ * byte, program output after it. */
+static void run_residual(const std::string &residual)
+{
+    std::cout << "Running interpreter." << std::endl;
+    mpli::OutputBuffer output;
+    output.write(residual.data() + 1, residual.size() - 1);
+    output.flush();
+    if (residual[0] != '0') {
+        std::cout << "Errors in interpreter. Exiting." << std::endl;
+    }
+    std::cout << std::endl << "Done." << std::endl;
+}
 
 int main(int argc, char* argv[])
 {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " FILENAME" << std::endl;
+    using namespace mpli;
+
+    const char *filename_arg = NULL;
+    /* line buffered on a terminal, like stdio */
+    OutputBuffer::FLUSH_POLICY flush_policy = isatty(1) ?
+        OutputBuffer::FLUSH_ON_NEWLINE : OutputBuffer::FLUSH_ON_READ;
+    size_t flush_threshold = 0;
+    int threads = 1;
+    int vectorize = 1;
+    int closed_form = 1;
+    int hoist = 1;
+    int max_depth = Parser::DEFAULT_MAX_DEPTH;
+    int opt_report = 0;
+    /* -1: run the AST interpreter */
+    int opt_level = -1;
+    int time_passes = 0;
+    int dump_ir = 0;
+    /* 0: no precomputation */
+    unsigned long long precompute_steps = 0;
+    std::string cache_dir = ProgramCache::default_dir();
+    int use_cache = 1;
+    int batch = 0;
+    const char *serve_path = NULL;
+    const char *client_path = NULL;
+    int repeat = 1;
+    int profile = 0;
+    /* samples per second, 0 when not sampling */
+    int sample_hz = 0;
+    /* -1: no stats, 0: text, 1: JSON */
+    int stats_format = -1;
+    /* 0: no hardware counters, 1: per phase, 2: per top-level statement */
+    int perf = 0;
+    const char *profile_path = NULL;
+    for (int i=1; i < argc; ++i) {
+        if (strcmp(argv[i], "--no-vectorize") == 0) {
+            vectorize = 0;
+        } else if (strcmp(argv[i], "--no-closed-form") == 0) {
+            closed_form = 0;
+        } else if (strcmp(argv[i], "--no-hoist") == 0) {
+            hoist = 0;
+        } else if (strcmp(argv[i], "--opt-report") == 0) {
+            opt_report = 1;
+        } else if (argv[i][0] == '-' && argv[i][1] == 'O' && argv[i][2] >= '0' &&
+            argv[i][2] <= '0' + PassManager::MAX_LEVEL && argv[i][3] == '\0') {
+            opt_level = argv[i][2] - '0';
+        } else if (strcmp(argv[i], "--time-passes") == 0) {
+            time_passes = 1;
+        } else if (strcmp(argv[i], "--dump-ir") == 0) {
+            dump_ir = 1;
+        } else if (strcmp(argv[i], "--precompute") == 0) {
+            precompute_steps = DEFAULT_PRECOMPUTE_STEPS;
+        } else if (strncmp(argv[i], "--precompute=", 13) == 0) {
+            precompute_steps = strtoull(argv[i] + 13, NULL, 10);
+            if (precompute_steps == 0) {
+                std::cerr << "Invalid step budget: " << (argv[i] + 13) << std::endl;
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--cache-dir=", 12) == 0) {
+            cache_dir = argv[i] + 12;
+        } else if (strcmp(argv[i], "--no-cache") == 0) {
+            use_cache = 0;
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            batch = 1;
+        } else if ((strcmp(argv[i], "--serve") == 0 || strcmp(argv[i], "--client") == 0) &&
+            i + 1 < argc) {
+            if (argv[i][2] == 's') {
+                serve_path = argv[i + 1];
+            } else {
+                client_path = argv[i + 1];
+            }
+            ++i;
+        } else if (strcmp(argv[i], "--stats") == 0 || strcmp(argv[i], "--stats=text") == 0) {
+            stats_format = 0;
+        } else if (strcmp(argv[i], "--stats=json") == 0) {
+            stats_format = 1;
+        } else if (strcmp(argv[i], "--perf") == 0) {
+            perf = 1;
+        } else if (strcmp(argv[i], "--perf=statements") == 0) {
+            perf = 2;
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            profile = 1;
+        } else if (strncmp(argv[i], "--profile=", 10) == 0) {
+            profile = 1;
+            profile_path = argv[i] + 10;
+        } else if (strcmp(argv[i], "--sample") == 0) {
+            sample_hz = Sampler::DEFAULT_HZ;
+        } else if (strncmp(argv[i], "--sample=", 9) == 0) {
+            sample_hz = atoi(argv[i] + 9);
+            if (sample_hz < 1 || sample_hz > 1000000) {
+                std::cerr << "Invalid sampling rate: " << (argv[i] + 9) << std::endl;
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--repeat=", 9) == 0) {
+            repeat = atoi(argv[i] + 9);
+            if (repeat < 1) {
+                std::cerr << "Invalid repeat count: " << (argv[i] + 9) << std::endl;
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+            threads = atoi(argv[i] + 10);
+            if (threads < 1) {
+                std::cerr << "Invalid thread count: " << (argv[i] + 10) << std::endl;
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--max-depth=", 12) == 0) {
+            max_depth = atoi(argv[i] + 12);
+            if (max_depth < 1) {
+                std::cerr << "Invalid nesting depth: " << (argv[i] + 12) << std::endl;
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--flush=", 8) == 0) {
+            if (OutputBuffer::parse_policy(argv[i] + 8, &flush_policy, &flush_threshold)) {
+                std::cerr << "Invalid flush policy: " << (argv[i] + 8) << std::endl;
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            usage(argv[0]);
+            return 1;
+        } else if (filename_arg == NULL) {
+            filename_arg = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (profile) {
+        /* every statement runs on its own, where it can be timed */
+        vectorize = 0;
+        closed_form = 0;
+        threads = 1;
+        opt_level = -1;
+        precompute_steps = 0;
+    }
+    if (sample_hz > 0) {
+        /* statements have to run on the AST interpreter to be seen */
+        opt_level = -1;
+        precompute_steps = 0;
+    }
+    if (perf == 2) {
+        /* statements have to run to be measured */
+        precompute_steps = 0;
+    }
+    if (perf && stats_format < 0) {
+        stats_format = 0;
+    }
+    if (serve_path) {
+        Program::Options options;
+        options.hoist = hoist;
+        options.opt_level = opt_level;
+        options.max_depth = max_depth;
+        Server server(options, threads);
+        server.set_loop_batching(vectorize);
+        server.set_closed_form_loops(closed_form);
+        return server.serve(serve_path);
+    }
+    if (filename_arg == NULL) {
+        usage(argv[0]);
         return 1;
     }
+    if (client_path) {
+        return run_client(client_path, filename_arg, repeat, threads);
+    }
     
-    std::string filename(argv[1]);
+    if (batch) {
+        Program::Options options;
+        options.hoist = hoist;
+        options.opt_level = opt_level;
+        options.max_depth = max_depth;
+        return run_batch(filename_arg, options, threads, vectorize, closed_form);
+    }
+
+    std::string filename(filename_arg);
     std::cout << "Running mpl-interpreter for source file " << filename << std::endl;
-    
-    using namespace mpli;
 
-    Scanner scanner;
-    scanner.open_input_file(filename.c_str());
-    Parser parser;
-    parser.set_scanner(&scanner);
-    parser.start();
-	if (parser.number_of_errors() > 0) {
-		std::cout << "Parser found errors. Exiting." << std::endl;
-		return 0;
+    Stats collected;
+    Stats *stats = NULL;
+    if (stats_format >= 0) {
+        stats = &collected;
+        Stats::enable_allocation_counting();
+    }
+    PerfCounters counters;
+    if (perf) {
+        if (counters.open() == 0) {
+            std::cerr << "Hardware counters are not available (" << counters.error()
+                      << "), reporting without them." << std::endl;
+        }
+        Stats::use_perf_counters(&counters);
+    }
+    begin_phase(stats, "read");
+
+    ProgramCache cache(use_cache ? cache_dir : std::string());
+    std::string source;
+    if (Program::read_file(filename, source) != 0) {
+        std::cerr << "Cannot read " << filename << std::endl;
+        return 1;
+    }
+    /* output of programs without read statements depends only on source */
+    int precompute = precompute_steps > 0;
+    if (precompute) {
+        std::string residual;
+        if (cache.load(source, "output", residual) == 0 && !residual.empty()) {
+            begin_phase(stats, "replay");
+            run_residual(residual);
+            print_stats(stats, stats_format);
+            return 0;
+        }
+    }
+
+	Program::Options options;
+	options.hoist = hoist;
+	options.opt_level = opt_level;
+	options.max_depth = max_depth;
+	Program::Hooks hooks;
+	hooks.stats = stats;
+	if (use_cache) {
+		hooks.cache = &cache;
 	}
-	if (DEBUG_MPLI) 
-		parser.debug_print();
-	
-	AST ast;
-	parser.create_ast(&ast);
-	if (ast.number_of_errors() > 0 ) {
-		std::cout << "Errors when constructing AST. Exiting." << std::endl;
+	std::string pass_report;
+	if (time_passes) {
+		hooks.pass_report = &pass_report;
+	}
+	std::string errors;
+	Program *program = Program::compile(source, options, &errors, &hooks);
+	if (!program) {
+		std::cout << errors << (hooks.parse_failed ? "Parser found errors. Exiting." :
+			"Errors when constructing AST. Exiting.") << std::endl;
+		print_stats(stats, stats_format);
 		return 0;
 	}
+	const AST &ast = program->ast();
+	const IRFunction *ir = program->ir();
 	if (DEBUG_MPLI)
 		ast.debug_print();
 
 	Interpreter interpreter;
+	if (hoist) {
+		interpreter.set_expression_cache(program->optimizer());
+	}
+	if (opt_report) {
+		const std::vector<std::string> &report = program->optimizer().report();
+		for (size_t i=0; i < report.size(); ++i) {
+			std::cerr << "opt: " << report[i] << std::endl;
+		}
+	}
+	interpreter.set_flush_policy(flush_policy, flush_threshold);
+	interpreter.set_threads(threads);
+	interpreter.set_loop_batching(vectorize);
+	interpreter.set_closed_form_loops(closed_form);
+	if (precompute && !contains_type(ast.root(), ASTNode::READ)) {
+		/* evaluate ahead into a string, fall back to a normal run if the
+		 * budget runs out or evaluation throws */
+		Interpreter evaluator;
+		if (hoist) {
+			evaluator.set_expression_cache(program->optimizer());
+		}
+		evaluator.set_threads(threads);
+		evaluator.set_loop_batching(vectorize);
+		evaluator.set_closed_form_loops(closed_form);
+		evaluator.set_step_budget(precompute_steps);
+		begin_phase(stats, "precompute");
+		std::string residual("0");
+		evaluator.capture_output(&residual);
+		int r;
+		try {
+			r = evaluator.execute(&ast);
+		} catch (std::invalid_argument &e) {
+			r = Interpreter::BUDGET_EXCEEDED;
+		}
+		if (r != Interpreter::BUDGET_EXCEEDED) {
+			residual[0] = r == 0 ? '0' : '1';
+			cache.store(source, "output", residual);
+			run_residual(residual);
+			if (stats) {
+				stats->set_counter("statements", evaluator.steps());
+				stats->set_counter("loop_iterations", evaluator.loop_iterations());
+			}
+			delete program;
+			print_stats(stats, stats_format);
+			return 0;
+		}
+	}
+	if (opt_level >= 0) {
+		std::string text;
+		if (!ir && (time_passes || dump_ir)) {
+			std::cerr << "ir: not lowered, " << hooks.ir_error << std::endl;
+		}
+		if (ir && dump_ir) {
+			ir->dump(text);
+		}
+		if (ir && time_passes) {
+			text += pass_report;
+		}
+		std::cerr << text;
+	}
+
+	int counted = (ir == NULL);
+	if (stats && counted) {
+		interpreter.set_allocation_tags(1);
+	}
+	if (perf == 2 && counted) {
+		/* statements are phases of their own */
+		stats->end();
+		interpreter.set_statement_stats(stats);
+	} else {
+		begin_phase(stats, "execute");
+	}
 	std::cout << "Running interpreter." << std::endl;
-	int r = interpreter.execute(&ast);
+	int r;
+	if (ir) {
+		r = interpreter.execute_ir(*ir);
+	} else if (profile) {
+		Profiler profiler;
+		interpreter.set_profiler(&profiler);
+		profiler.start();
+		r = interpreter.execute(&ast);
+		profiler.stop();
+		interpreter.set_profiler(NULL);
+		std::string text;
+		profiler.report(text);
+		std::cerr << text;
+		if (profile_path) {
+			text.clear();
+			profiler.folded(text);
+			std::ofstream folded(profile_path);
+			folded << text;
+			if (!folded) {
+				std::cerr << "Cannot write " << profile_path << std::endl;
+			}
+		}
+	} else if (sample_hz > 0) {
+		Sampler sampler;
+		if (sampler.start(sample_hz) != 0) {
+			std::cerr << "Cannot start sampling." << std::endl;
+		}
+		interpreter.set_sampler(&sampler);
+		r = interpreter.execute(&ast);
+		sampler.stop();
+		interpreter.set_sampler(NULL);
+		std::string text;
+		sampler.report(text, &source);
+		std::cerr << text;
+	} else {
+		r = interpreter.execute(&ast);
+	}
 	if (r != 0) {
 		std::cout << "Errors in interpreter. Exiting." << std::endl;
 	}
+	if (stats) {
+		stats->end();
+	}
+	delete program;
+	/* IR programs are not counted statement by statement */
+	if (stats && counted) {
+		stats->set_counter("statements", interpreter.steps());
+		stats->set_counter("loop_iterations", interpreter.loop_iterations());
+		/* allocations of every kind of statement that made any */
+		for (int type=ASTNode::ROOT; type <= ASTNode::CONSTANT; ++type) {
+			unsigned long long bytes, count;
+			Stats::tagged_allocations(1 + type, &bytes, &count);
+			if (count > 0) {
+				std::string kind = type_name((ASTNode::TYPE)type);
+				stats->set_counter("allocations_" + kind, count);
+				stats->set_counter("allocated_bytes_" + kind, bytes);
+			}
+		}
+	}
 
     std::cout << std::endl << "Done." << std::endl;
+	print_stats(stats, stats_format);
     return 0;
 }
@@ -0,0 +1,22 @@
+#ifndef MPLI_MPLI_HPP_
+#define MPLI_MPLI_HPP_
+
+/*
+ * Embedding API of libmpli:
+ *
+ *   mpli::Program::Options options;
+ *   std::string errors;
+ *   mpli::Program *program = mpli::Program::compile(source, options, &errors);
+ *   mpli::Context context;
+ *   std::string output;
+ *   context.set_output_string(&output);
+ *   context.set_input_string("3 hello");
+ *   int r = context.run(*program);
+ *
+ * A program is compiled once and can be run by many contexts; a context
+ * can be reused for any number of runs.
+ */
+#include "program.hpp"
+#include "context.hpp"
+
+#endif // MPLI_MPLI_HPP_
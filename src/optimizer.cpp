@@ -0,0 +1,282 @@
+#include "optimizer.hpp"
+#include "int_conv.hpp"
+
+namespace mpli {
+
+Optimizer::Optimizer()
+{
+	_n_scopes = 0;
+}
+
+int Optimizer::n_scopes() const
+{
+	return _n_scopes;
+}
+
+const std::vector<int> &Optimizer::slot_scopes() const
+{
+	return _slot_scopes;
+}
+
+const std::vector<std::string> &Optimizer::report() const
+{
+	return _report;
+}
+
+void Optimizer::optimize(ASTNode *root)
+{
+	optimize_block(root);
+}
+
+void Optimizer::optimize_block(ASTNode *block)
+{
+	for (size_t i=0; i < block->children.size(); ++i) {
+		optimize_stmt(block->children[i]);
+	}
+}
+
+void Optimizer::optimize_stmt(ASTNode *stmt)
+{
+	if (stmt->type == ASTNode::FOR_LOOP) {
+		/* range is evaluated in the enclosing loops */
+		ASTNode *in_node = stmt->children[0];
+		if (in_node->height <= ASTNode::RECURSIVE_HEIGHT) {
+			for (size_t i=1; i < in_node->children.size(); ++i) {
+				hoist(in_node->children[i]);
+			}
+			share(in_node, stmt);
+		}
+
+		Loop loop;
+		loop.node = stmt;
+		collect_assigned(stmt, loop.assigned);
+		_loops.push_back(loop);
+		optimize_block(stmt->children[1]);
+		_loops.pop_back();
+		return;
+	}
+
+	/* expressions too deep to walk recursively are not cached */
+	if (stmt->height > ASTNode::RECURSIVE_HEIGHT) {
+		return;
+	}
+	for (size_t i=0; i < stmt->children.size(); ++i) {
+		hoist(stmt->children[i]);
+	}
+	share(stmt, stmt);
+}
+
+void Optimizer::collect_assigned(ASTNode *node, std::vector<std::string> &names)
+{
+	switch (node->type) {
+		case ASTNode::INSERT:
+		case ASTNode::READ:
+		case ASTNode::VAR_INIT:
+			names.push_back(node->children[0]->value);
+			break;
+		case ASTNode::FOR_LOOP:
+			names.push_back(node->children[0]->children[0]->value);
+			collect_assigned(node->children[1], names);
+			break;
+		case ASTNode::FOR_DO:
+			for (size_t i=0; i < node->children.size(); ++i) {
+				collect_assigned(node->children[i], names);
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+int Optimizer::scope_of(ASTNode *node)
+{
+	if (node->cache_scope < 0) {
+		node->cache_scope = _n_scopes++;
+	}
+	return node->cache_scope;
+}
+
+int Optimizer::new_slot(ASTNode *node, int scope)
+{
+	node->cache_slot = _slot_scopes.size();
+	_slot_scopes.push_back(scope);
+	return node->cache_slot;
+}
+
+void Optimizer::hoist(ASTNode *node)
+{
+	if (node->type != ASTNode::OPERATOR && node->type != ASTNode::UNARY_OP) {
+		return;
+	}
+
+	/* variables assigned in an inner loop are assigned in the outer ones
+	 * too, so the first loop the expression is invariant in is the
+	 * outermost one */
+	for (size_t l=0; l < _loops.size(); ++l) {
+		const std::vector<std::string> &assigned = _loops[l].assigned;
+		int invariant = 1;
+		for (size_t i=0; i < assigned.size() && invariant; ++i) {
+			invariant = !refers_to(node, assigned[i]);
+		}
+		if (invariant) {
+			/* same value as an identical expression hoisted before */
+			std::vector<ASTNode*> &hoisted = _loops[l].hoisted;
+			for (size_t i=0; i < hoisted.size(); ++i) {
+				if (same_expression(hoisted[i], node)) {
+					node->cache_slot = hoisted[i]->cache_slot;
+					return;
+				}
+			}
+			hoisted.push_back(node);
+			new_slot(node, scope_of(_loops[l].node));
+			std::string line = "hoisted ";
+			expression_string(node, line);
+			line.append(" out of loop over ");
+			line.append(_loops[l].node->children[0]->children[0]->value);
+			if (l + 1 < _loops.size()) {
+				line.append(" from loop over ");
+				line.append(_loops.back().node->children[0]->children[0]->value);
+			}
+			_report.push_back(line);
+			return;
+		}
+	}
+
+	for (size_t i=0; i < node->children.size(); ++i) {
+		hoist(node->children[i]);
+	}
+}
+
+void Optimizer::collect_expressions(ASTNode *node, std::vector<ASTNode*> &exprs)
+{
+	if (node->cache_slot >= 0) {
+		return;
+	}
+	if (node->type == ASTNode::OPERATOR || node->type == ASTNode::UNARY_OP) {
+		exprs.push_back(node);
+	}
+	if (node->type == ASTNode::FOR_LOOP) {
+		return;
+	}
+	for (size_t i=0; i < node->children.size(); ++i) {
+		collect_expressions(node->children[i], exprs);
+	}
+}
+
+int Optimizer::count_expressions(ASTNode *node)
+{
+	int n = (node->type == ASTNode::OPERATOR || node->type == ASTNode::UNARY_OP);
+	for (size_t i=0; i < node->children.size(); ++i) {
+		n += count_expressions(node->children[i]);
+	}
+	return n;
+}
+
+void Optimizer::share(ASTNode *stmt, ASTNode *scope_node)
+{
+	/* pre-order: larger duplicates are found before their subexpressions,
+	 * which follow them directly in the list */
+	std::vector<ASTNode*> exprs;
+	for (size_t i=0; i < stmt->children.size(); ++i) {
+		collect_expressions(stmt->children[i], exprs);
+	}
+
+	for (size_t i=0; i < exprs.size(); ++i) {
+		if (!exprs[i] || exprs[i]->cache_slot >= 0) {
+			continue;
+		}
+		int uses = 1;
+		for (size_t j=i+1; j < exprs.size(); ++j) {
+			if (!exprs[j] || exprs[j]->cache_slot >= 0 || !same_expression(exprs[i], exprs[j])) {
+				continue;
+			}
+			if (uses == 1) {
+				new_slot(exprs[i], scope_of(scope_node));
+			}
+			exprs[j]->cache_slot = exprs[i]->cache_slot;
+			++uses;
+			/* subexpressions of the copy are not evaluated any more */
+			int n = count_expressions(exprs[j]);
+			for (size_t k=j+1; k < j+n; ++k) {
+				exprs[k] = NULL;
+			}
+		}
+		if (uses == 1) {
+			continue;
+		}
+		std::string line = "shared ";
+		expression_string(exprs[i], line);
+		line.append(" in ");
+		line.append(stmt_name(stmt));
+		line.append(", ");
+		append_int(line, uses);
+		line.append(" uses");
+		_report.push_back(line);
+	}
+}
+
+int Optimizer::same_expression(ASTNode *a, ASTNode *b)
+{
+	if (a->type != b->type || a->value != b->value ||
+		a->children.size() != b->children.size()) {
+		return 0;
+	}
+	if (a->type == ASTNode::OPERATOR && a->operator_type != b->operator_type) {
+		return 0;
+	}
+	for (size_t i=0; i < a->children.size(); ++i) {
+		if (!same_expression(a->children[i], b->children[i])) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+void Optimizer::expression_string(ASTNode *node, std::string &out)
+{
+	const char *ops[] = { " + ", " - ", " * ", " / ", " < ", " = ", " & ", " ! " };
+	switch (node->type) {
+		case ASTNode::OPERATOR:
+			out.append("(");
+			expression_string(node->children[0], out);
+			out.append(ops[node->operator_type]);
+			expression_string(node->children[1], out);
+			out.append(")");
+			break;
+		case ASTNode::UNARY_OP:
+			out.append("!");
+			expression_string(node->children[0], out);
+			break;
+		case ASTNode::CONSTANT:
+			if (node->variable_type == ASTVariable::STRING) {
+				out.append("\"");
+				out.append(node->value);
+				out.append("\"");
+			} else {
+				out.append(node->value);
+			}
+			break;
+		default:
+			out.append(node->value);
+	}
+}
+
+const char *Optimizer::stmt_name(ASTNode *stmt)
+{
+	switch (stmt->type) {
+		case ASTNode::INSERT:
+			return "assignment";
+		case ASTNode::VAR_INIT:
+			return "declaration";
+		case ASTNode::FOR_IN:
+			return "loop range";
+		case ASTNode::PRINT:
+			return "print";
+		case ASTNode::ASSERT:
+			return "assert";
+		default:
+			return "statement";
+	}
+}
+
+} // namespace mpli
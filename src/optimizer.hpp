@@ -0,0 +1,62 @@
+#ifndef MPLI_OPTIMIZER_HPP_
+#define MPLI_OPTIMIZER_HPP_
+
+#include "ast.hpp"
+#include <vector>
+#include <string>
+
+namespace mpli {
+
+/*
+ * Expression caching pass over the AST.
+ *  - Loop-invariant code motion: an expression inside a FOR_DO block that
+ *    reads no variable assigned in the loop (loop variable, insert and read
+ *    targets, also in nested loops) gets a cache slot scoped to the
+ *    outermost such loop.
+ *  - Common-subexpression elimination: identical expressions within one
+ *    statement share a cache slot scoped to the statement.
+ * Slots are filled lazily by the interpreter on first evaluation and are
+ * invalidated whenever their scope node starts executing, so errors such
+ * as division by zero are raised on the same iteration as without caching.
+ */
+class Optimizer {
+private:
+	struct Loop {
+		ASTNode *node;
+		std::vector<std::string> assigned;
+		/* expressions with a slot scoped to this loop */
+		std::vector<ASTNode*> hoisted;
+	};
+
+	int _n_scopes;
+	std::vector<int> _slot_scopes;
+	std::vector<std::string> _report;
+	std::vector<Loop> _loops;
+
+	void optimize_block(ASTNode *block);
+	void optimize_stmt(ASTNode *stmt);
+	void hoist(ASTNode *node);
+	/* share identical expressions under stmt, valid while scope_node runs */
+	void share(ASTNode *stmt, ASTNode *scope_node);
+	void collect_assigned(ASTNode *node, std::vector<std::string> &names);
+	int scope_of(ASTNode *node);
+	int new_slot(ASTNode *node, int scope);
+	static void collect_expressions(ASTNode *node, std::vector<ASTNode*> &exprs);
+	static int count_expressions(ASTNode *node);
+	static int same_expression(ASTNode *a, ASTNode *b);
+	static void expression_string(ASTNode *node, std::string &out);
+	static const char *stmt_name(ASTNode *stmt);
+
+public:
+	Optimizer();
+	/* Annotate cache_slot and cache_scope of nodes under root. */
+	void optimize(ASTNode *root);
+	int n_scopes() const;
+	/* scope of every cache slot */
+	const std::vector<int> &slot_scopes() const;
+	/* one line for every hoisted or shared expression */
+	const std::vector<std::string> &report() const;
+};
+
+} // namespace mpli
+#endif // MPLI_OPTIMIZER_HPP_
@@ -0,0 +1,273 @@
+#include "output_buffer.hpp"
+#include "int_conv.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdarg>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/uio.h>
+
+namespace mpli {
+
+OutputBuffer::OutputBuffer(int fd)
+{
+	_fd = fd;
+	_policy = FLUSH_ON_READ;
+	_threshold = DEFAULT_CAPACITY;
+	_buffer.resize(DEFAULT_CAPACITY);
+	_capacity = DEFAULT_CAPACITY;
+	_used = 0;
+	_holding = 0;
+	_held = 0;
+	_capture = NULL;
+}
+
+OutputBuffer::~OutputBuffer()
+{
+	flush();
+}
+
+void OutputBuffer::set_policy(FLUSH_POLICY policy, size_t threshold)
+{
+	_policy = policy;
+	if (policy == FLUSH_ON_SIZE) {
+		if (threshold == 0) {
+			threshold = 1;
+		}
+		if (threshold > _buffer.size()) {
+			flush();
+			_buffer.resize(threshold < MAX_CAPACITY ? threshold : MAX_CAPACITY);
+			_capacity = _buffer.size();
+		}
+		_threshold = threshold;
+	}
+}
+
+OutputBuffer::FLUSH_POLICY OutputBuffer::policy()
+{
+	return _policy;
+}
+
+void OutputBuffer::capture(std::string *sink)
+{
+	flush();
+	_capture = sink;
+}
+
+void OutputBuffer::set_fd(int fd)
+{
+	flush();
+	_fd = fd;
+	_capture = NULL;
+}
+
+void OutputBuffer::write_through(const char *data, size_t len)
+{
+	if (_capture) {
+		/* pointer and length: an iterator range would be copied into a
+		 * temporary string first */
+		_capture->append(&_buffer[0], _used);
+		if (len > 0)
+			_capture->append(data, len);
+		_used = 0;
+		return;
+	}
+	struct iovec iov[2];
+	int n = 0;
+	if (_used > 0) {
+		iov[n].iov_base = &_buffer[0];
+		iov[n].iov_len = _used;
+		++n;
+	}
+	if (len > 0) {
+		iov[n].iov_base = const_cast<char*>(data);
+		iov[n].iov_len = len;
+		++n;
+	}
+	_used = 0;
+
+	/* loop until everything is written, writev may write partially */
+	struct iovec *v = iov;
+	while (n > 0) {
+		ssize_t w = writev(_fd, v, n);
+		if (w < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			/* output is gone (closed pipe etc.), drop it */
+			return;
+		}
+		while (n > 0 && (size_t)w >= v->iov_len) {
+			w -= v->iov_len;
+			++v;
+			--n;
+		}
+		if (n > 0) {
+			v->iov_base = (char*)v->iov_base + w;
+			v->iov_len -= w;
+		}
+	}
+}
+
+void OutputBuffer::after_write(const char *data, size_t len)
+{
+	switch (_policy) {
+		case FLUSH_ON_NEWLINE:
+			if (memchr(data, '\n', len) != NULL) {
+				flush();
+			}
+			break;
+		case FLUSH_ON_SIZE:
+			if (_used >= _threshold) {
+				flush();
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+void OutputBuffer::grow(size_t len)
+{
+	size_t size = _buffer.size() * 2;
+	if (size < _used + len) {
+		size = _used + len;
+	}
+	_buffer.resize(size);
+}
+
+void OutputBuffer::write(const char *data, size_t len)
+{
+	if (_holding) {
+		if (len > _buffer.size() - _used) {
+			grow(len);
+		}
+		memcpy(&_buffer[_used], data, len);
+		_used += len;
+		return;
+	}
+	if (len <= _buffer.size() - _used) {
+		memcpy(&_buffer[_used], data, len);
+		_used += len;
+	} else if (len < _buffer.size()) {
+		flush();
+		memcpy(&_buffer[0], data, len);
+		_used = len;
+	} else {
+		/* bigger than the whole buffer: one writev for both */
+		write_through(data, len);
+		return;
+	}
+	after_write(data, len);
+}
+
+void OutputBuffer::write(const std::string &str)
+{
+	write(str.data(), str.size());
+}
+
+void OutputBuffer::write_int(int val)
+{
+	if (_buffer.size() - _used < (size_t)INT_CONV_MAX_CHARS) {
+		if (_holding) {
+			grow(INT_CONV_MAX_CHARS);
+		} else {
+			flush();
+		}
+	}
+	char *start = &_buffer[_used];
+	char *end = format_int(val, start);
+	_used += end - start;
+	if (!_holding && _policy == FLUSH_ON_SIZE && _used >= _threshold) {
+		flush();
+	}
+}
+
+void OutputBuffer::write_format(const char *format, ...)
+{
+	char tmp[512];
+	va_list args;
+	va_start(args, format);
+	int n = vsnprintf(tmp, sizeof(tmp), format, args);
+	va_end(args);
+	if (n < 0) {
+		return;
+	}
+	if ((size_t)n < sizeof(tmp)) {
+		write(tmp, n);
+		return;
+	}
+	/* long message, format again into heap buffer */
+	std::vector<char> big(n + 1);
+	va_start(args, format);
+	vsnprintf(&big[0], big.size(), format, args);
+	va_end(args);
+	write(&big[0], n);
+}
+
+void OutputBuffer::hold()
+{
+	_holding = 1;
+	_held = _used;
+}
+
+void OutputBuffer::release()
+{
+	_holding = 0;
+	if (_buffer.size() > MAX_CAPACITY) {
+		/* a long held output does not keep its memory */
+		flush();
+		std::vector<char>(_capacity).swap(_buffer);
+		return;
+	}
+	if (_used == _buffer.size()) {
+		flush();
+		return;
+	}
+	after_write(&_buffer[_held], _used - _held);
+}
+
+void OutputBuffer::drop_held()
+{
+	_holding = 0;
+	_used = _held;
+}
+
+void OutputBuffer::before_read()
+{
+	if (_policy == FLUSH_ON_READ || _policy == FLUSH_ON_NEWLINE) {
+		flush();
+	}
+}
+
+void OutputBuffer::flush()
+{
+	if (_used > 0) {
+		write_through(NULL, 0);
+	}
+}
+
+int OutputBuffer::parse_policy(const char *str, FLUSH_POLICY *policy, size_t *threshold)
+{
+	*threshold = 0;
+	if (strcmp(str, "exit") == 0) {
+		*policy = FLUSH_ON_EXIT;
+	} else if (strcmp(str, "read") == 0) {
+		*policy = FLUSH_ON_READ;
+	} else if (strcmp(str, "newline") == 0) {
+		*policy = FLUSH_ON_NEWLINE;
+	} else {
+		char *end = NULL;
+		unsigned long n = strtoul(str, &end, 10);
+		if (*str < '0' || *str > '9' || *end != '\0' || n == 0) {
+			return 1;
+		}
+		*policy = FLUSH_ON_SIZE;
+		*threshold = n;
+	}
+	return 0;
+}
+
+} // namespace mpli
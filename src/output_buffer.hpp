@@ -0,0 +1,91 @@
+#ifndef MPLI_OUTPUT_BUFFER_HPP_
+#define MPLI_OUTPUT_BUFFER_HPP_
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace mpli {
+
+/*
+ * Buffered output sink that writes into a file descriptor with large
+ * write/writev calls instead of one stdio call per print.
+ */
+class OutputBuffer {
+public:
+	/* when pending output is written out, in addition to buffer full and
+	 * explicit flush() */
+	enum FLUSH_POLICY {
+		FLUSH_ON_EXIT,		/* only when buffer is full or on exit */
+		FLUSH_ON_READ,		/* before every read statement */
+		FLUSH_ON_NEWLINE,	/* after output containing newline, and before read */
+		FLUSH_ON_SIZE		/* when pending output reaches threshold */
+	};
+
+	/* default capacity of the buffer in bytes */
+	static const size_t DEFAULT_CAPACITY = 64 * 1024;
+	/* buffer never grows above this, larger thresholds flush when full */
+	static const size_t MAX_CAPACITY = 16 * 1024 * 1024;
+
+private:
+	int _fd;
+	FLUSH_POLICY _policy;
+	size_t _threshold;
+
+	std::vector<char> _buffer;
+	/* size of the buffer, unless held output made it grow */
+	size_t _capacity;
+	size_t _used;
+	/* while held, output from this offset on stays in the buffer */
+	int _holding;
+	size_t _held;
+	/* if set, output is appended here instead of written into fd */
+	std::string *_capture;
+
+	/* write all of data straight into fd, pending buffer first */
+	void write_through(const char *data, size_t len);
+	/* apply flush policy after len bytes of data were added */
+	void after_write(const char *data, size_t len);
+	/* make room for len more bytes while output is held */
+	void grow(size_t len);
+
+public:
+	OutputBuffer(int fd = 1);
+	/* flushes pending output */
+	~OutputBuffer();
+
+	/* set flush policy, threshold is used only with FLUSH_ON_SIZE */
+	void set_policy(FLUSH_POLICY policy, size_t threshold = 0);
+	FLUSH_POLICY policy();
+	/* Append output into sink instead of writing it into fd, NULL writes
+	 * into fd again. */
+	void capture(std::string *sink);
+	/* write into fd from now on, pending output goes to the old one */
+	void set_fd(int fd);
+
+	void write(const char *data, size_t len);
+	void write(const std::string &str);
+	void write_int(int val);
+	/* printf-style formatted write, used for diagnostics */
+	void write_format(const char *format, ...);
+
+	/* Keep output written from now on in the buffer, e.g. of a print
+	 * statement that may fail halfway, until release() applies the flush
+	 * policy to it or drop_held() removes it. */
+	void hold();
+	void release();
+	void drop_held();
+
+	/* notify that program is about to read input */
+	void before_read();
+	/* write out all pending output */
+	void flush();
+
+	/* Parse flush policy given as "exit", "read", "newline" or a byte
+	 * count. Returns 0 on success, 1 on invalid policy string.
+	 */
+	static int parse_policy(const char *str, FLUSH_POLICY *policy, size_t *threshold);
+};
+
+} // namespace mpli
+#endif // MPLI_OUTPUT_BUFFER_HPP_
@@ -7,28 +7,33 @@ Parser::Parser()
 {
     _root_node = NULL;
     _n_errors = 0;
+    _n_nodes = 0;
+    _loop_depth = 0;
+    _max_depth = DEFAULT_MAX_DEPTH;
+    _stopped = 0;
 }
 
 Parser::~Parser()
 {
     if (_root_node) {
-        /* delete parse tree recursively */
-        delete_node_r(_root_node);
+        /* delete parse tree, nodes still to delete are kept on a stack */
+        std::vector<Node*> stack(1, _root_node);
+        while (!stack.empty()) {
+            Node *node = stack.back();
+            stack.pop_back();
+            for (size_t i=0; i < node->children.size(); ++i) {
+                stack.push_back(node->children[i]);
+            }
+            delete node;
+        }
     }
 }
 
-void Parser::delete_node_r(Node *node)
-{
-    for(int i=(node->children.size()-1); i >= 0; --i) {
-        delete_node_r(node->children[i]);
-    }
-    delete node;
-}
-
 Node *Parser::new_node(Node::TYPE type)
 {
     Node *node = new Node;
     node->type = type;
+    ++_n_nodes;
     return node;
 }
 
@@ -37,6 +42,7 @@ Node *Parser::new_token_node(Token token)
     Node *node = new Node;
     node->type = Node::TOKEN;
     node->token = token;
+    ++_n_nodes;
     return node;
 }
 
@@ -62,30 +68,61 @@ void Parser::parse_child_node(Token::TYPE expected, Node *parent)
 
 void Parser::token_error()
 {
+    if (_stopped) {
+        return;
+    }
     _n_errors++;
     if (_curr_token.type == Token::ERROR) {
-        printf("ERROR: Parser - cannot resolve token type for token '%s' %s\n",
-               _curr_token.str.c_str(), _curr_token.type_str().c_str());
+        _errors += "ERROR: Parser - cannot resolve token type for token '" + _curr_token.str +
+            "' " + _curr_token.type_str() + "\n";
     } else {
-        printf("ERROR: Parser - '%s' %s is not a valid token for this location.\n", 
-               _curr_token.str.c_str(), _curr_token.type_str().c_str());
+        _errors += "ERROR: Parser - '" + _curr_token.str + "' " + _curr_token.type_str() +
+            " is not a valid token for this location.\n";
     }
 }
 
+void Parser::nesting_error(const char *what, int limit, const Token &at)
+{
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%s nested deeper than %d levels at line %d, column %d.\n",
+        what, limit, at.line, at.column);
+    _n_errors++;
+    _errors += "ERROR: Parser - ";
+    _errors += buf;
+    /* the rest of the input is skipped */
+    _stopped = 1;
+    _curr_token = Token(Token::END_OF_FILE, "");
+}
+
 int Parser::number_of_errors()
 {
     return _n_errors;
 }
 
+const std::string &Parser::errors()
+{
+    return _errors;
+}
+
+unsigned long long Parser::number_of_nodes()
+{
+    return _n_nodes;
+}
+
 void Parser::set_scanner(Scanner *scanner)
 {
 	_scanner = scanner;
 }
 
+void Parser::set_max_depth(int depth)
+{
+	_max_depth = depth;
+}
+
 void Parser::create_ast(AST *ast)
 {
 	if (_n_errors != 0 || !_root_node) {
-		printf("ERROR: Parser::create_ast - Cannot create AST when there are errors.\n");
+		_errors += "ERROR: Parser::create_ast - Cannot create AST when there are errors.\n";
 		return;
 	}
 	ast->create(_root_node);
@@ -93,25 +130,29 @@ void Parser::create_ast(AST *ast)
 
 void Parser::debug_print()
 {
-	debug_print_r(_root_node, 1);
-}
-
-void Parser::debug_print_r(Node *node, int level)
-{
-	if (node->type == Node::TOKEN) {
-    	printf("DEBUG: Node level %d: %s %s %s\n", level, node->type_str().c_str(), node->token.type_str().c_str(), node->token.str.c_str());
-	} else {
-		printf("DEBUG: Node level %d: %s\n", level, node->type_str().c_str());
-	}
-	for (int i=0; i < node->children.size(); ++i) {
-		debug_print_r(node->children[i], level+1);
+	/* nodes still to print with their levels, the next one last */
+	std::vector<std::pair<Node*, int> > stack;
+	stack.push_back(std::make_pair(_root_node, 1));
+	while (!stack.empty()) {
+		Node *node = stack.back().first;
+		int level = stack.back().second;
+		stack.pop_back();
+		if (node->type == Node::TOKEN) {
+			printf("DEBUG: Node level %d: %s %s %s\n", level, node->type_str().c_str(), node->token.type_str().c_str(), node->token.str.c_str());
+		} else {
+			printf("DEBUG: Node level %d: %s\n", level, node->type_str().c_str());
+		}
+		for (int i=(int)node->children.size()-1; i >= 0; --i) {
+			stack.push_back(std::make_pair(node->children[i], level+1));
+		}
 	}
-
 }
 
 void Parser::start()
 {
     _n_errors = 0;
+    _loop_depth = 0;
+    _stopped = 0;
 	_curr_token = _scanner->next_token();
 	parse_prog();
 }
@@ -185,7 +226,13 @@ void Parser::parse_stmt(Node *parent)
 			parse_child_node(Token::DOUBLEDOT, stmt_node);
 			parse_expr(stmt_node);
 			parse_child_node(Token::KW_DO, stmt_node);
+			if (_loop_depth >= MAX_LOOP_DEPTH || _loop_depth >= _max_depth) {
+				nesting_error("loops", _loop_depth, stmt_node->children[0]->token);
+				break;
+			}
+			++_loop_depth;
 			parse_stmts(stmt_node);
+			--_loop_depth;
 			parse_child_node(Token::KW_END, stmt_node);
 			parse_child_node(Token::KW_FOR, stmt_node);
 			break;
@@ -214,39 +261,74 @@ void Parser::parse_stmt(Node *parent)
 
 void Parser::parse_expr(Node *parent)
 {
-    Node *expr_node = new_node(Node::EXPR);
-    parent->children.push_back(expr_node);
+	/* An operand in parentheses opens a new expression on _open_exprs
+	 * instead of recursing, so nesting is limited by _max_depth only. */
+	_open_exprs.clear();
+	Node *bracket_node = NULL;
+	Node *expr_parent = parent;
+	for (;;) {
+		if (expr_parent) {
+			if (_loop_depth + (int)_open_exprs.size() >= _max_depth) {
+				nesting_error("parentheses and loops", _max_depth, _curr_token);
+				return;
+			}
+			OpenExpr e;
+			e.expr_node = new_node(Node::EXPR);
+			e.bracket_node = bracket_node;
+			e.binary = 0;
+			expr_parent->children.push_back(e.expr_node);
+			expr_parent = NULL;
 
-	switch (_curr_token.type) {
-		/* <opnd> <op> <opnd> | <opnd> */
-		case Token::INTEGER:
-		case Token::STRING:
-		case Token::IDENTIFIER:
-		case Token::BRACKET_LEFT:
-			parse_opnd(expr_node);
-			if (_curr_token.type == Token::OP_ADD || 
-			    _curr_token.type == Token::OP_SUBT ||
-				_curr_token.type == Token::OP_DIVIS ||
-				_curr_token.type == Token::OP_NOT ||
-				_curr_token.type == Token::OP_MULT ||
-				_curr_token.type == Token::OP_AND ||
-				_curr_token.type == Token::OP_LT ||
-				_curr_token.type == Token::OP_EQ) {
-				parse_op(expr_node);
-				parse_opnd(expr_node);
+			switch (_curr_token.type) {
+				/* <opnd> <op> <opnd> | <opnd> */
+				case Token::INTEGER:
+				case Token::STRING:
+				case Token::IDENTIFIER:
+				case Token::BRACKET_LEFT:
+					e.binary = 1;
+					_open_exprs.push_back(e);
+					expr_parent = bracket_node = parse_opnd(e.expr_node);
+					break;
+				/* [ <unary_op> ] <opnd> */
+				case Token::OP_NOT:
+					parse_child_node(Token::OP_NOT, e.expr_node);
+					_open_exprs.push_back(e);
+					expr_parent = bracket_node = parse_opnd(e.expr_node);
+					break;
+				default:
+					token_error();
+					_open_exprs.push_back(e);
 			}
-			break;
-		/* [ <unary_op> ] <opnd> */
-		case Token::OP_NOT:
-			parse_child_node(Token::OP_NOT, expr_node);
-			parse_opnd(expr_node);
-			break;
-		default:
-			token_error();
+			if (expr_parent) {
+				continue;
+			}
+		}
+
+		/* last parsed operand of innermost expression is complete */
+		OpenExpr &e = _open_exprs.back();
+		if (e.binary && (_curr_token.type == Token::OP_ADD ||
+			_curr_token.type == Token::OP_SUBT ||
+			_curr_token.type == Token::OP_DIVIS ||
+			_curr_token.type == Token::OP_NOT ||
+			_curr_token.type == Token::OP_MULT ||
+			_curr_token.type == Token::OP_AND ||
+			_curr_token.type == Token::OP_LT ||
+			_curr_token.type == Token::OP_EQ)) {
+			e.binary = 0;
+			parse_op(e.expr_node);
+			expr_parent = bracket_node = parse_opnd(e.expr_node);
+			continue;
+		}
+		Node *closed = e.bracket_node;
+		_open_exprs.pop_back();
+		if (!closed) {
+			return;
+		}
+		parse_child_node(Token::BRACKET_RIGHT, closed);
 	}
 }
 
-void Parser::parse_opnd(Node *parent)
+Node *Parser::parse_opnd(Node *parent)
 {
     Node *opnd_node = new_node(Node::OPND);
     parent->children.push_back(opnd_node);
@@ -264,15 +346,14 @@ void Parser::parse_opnd(Node *parent)
 		case Token::IDENTIFIER:
 			parse_child_node(Token::IDENTIFIER, opnd_node);
 			break;
-		/* "(" expr ")" */
+		/* "(" expr ")", the caller parses expr */
 		case Token::BRACKET_LEFT:
 			parse_child_node(Token::BRACKET_LEFT, opnd_node);
-			parse_expr(opnd_node);
-			parse_child_node(Token::BRACKET_RIGHT, opnd_node);
-			break;
+			return opnd_node;
 		default:
 			token_error();
 	}
+	return NULL;
 }
 
 void Parser::parse_type(Node *parent)
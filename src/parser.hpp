@@ -12,6 +12,13 @@ namespace mpli {
  * Parser to parse token stream into parse tree and later creating AST.
  */
 class Parser {
+    public:
+		/* default limit of nested parentheses and loops, see set_max_depth */
+		static const int DEFAULT_MAX_DEPTH = 1000000;
+		/* Loops are walked recursively by every pass, they may be nested
+		 * at most this deep whatever the limit is. */
+		static const int MAX_LOOP_DEPTH = 1000;
+
     private:
 		Scanner *_scanner;
 
@@ -20,6 +27,24 @@ class Parser {
 		Token _curr_token;
 
         int _n_errors;
+		/* parse tree nodes created */
+		unsigned long long _n_nodes;
+		/* error messages, one per line */
+		std::string _errors;
+
+		/* expressions being parsed, innermost last, with the operand in
+		 * parentheses each one is in, NULL for the outermost */
+		struct OpenExpr {
+			Node *expr_node;
+			Node *bracket_node;
+			/* first operand is parsed, an operator may follow */
+			int binary;
+		};
+		std::vector<OpenExpr> _open_exprs;
+		int _loop_depth;
+		int _max_depth;
+		/* parsing stopped at a nesting error, later errors are not reported */
+		int _stopped;
 
 		/* utility functions */
         Node *new_node(Node::TYPE type);
@@ -27,15 +52,17 @@ class Parser {
         int match(Token::TYPE expected);
 		void parse_child_node(Token::TYPE expected, Node *parent);
         void token_error();
-        void delete_node_r(Node *node);
-		void debug_print_r(Node *node, int level);
+		/* report nesting deeper than limit at token and stop parsing */
+		void nesting_error(const char *what, int limit, const Token &at);
 
 		/* black magic and ugly code */
 		void parse_prog();
 		void parse_stmts(Node *parent);
 		void parse_stmt(Node *parent);
 		void parse_expr(Node *parent);
-		void parse_opnd(Node *parent);
+		/* returns operand if it is "(" <expr> ")", its expression is
+		 * parsed next */
+		Node *parse_opnd(Node *parent);
 		void parse_type(Node *parent);
 		void parse_op(Node *parent);
 
@@ -44,10 +71,17 @@ class Parser {
         ~Parser();
 		/* set scanner that is used */
 		void set_scanner(Scanner *scanner);
+		/* Report an error for parentheses and loops nested deeper than
+		 * given levels together, DEFAULT_MAX_DEPTH by default. */
+		void set_max_depth(int depth);
 		/* start the token stream parsing into parse tree*/
 		void start();
 		/* returns number of errors reported */
         int number_of_errors();
+		/* returns messages of reported errors */
+		const std::string &errors();
+		/* returns number of parse tree nodes created */
+		unsigned long long number_of_nodes();
 		/* create AST into given AST pointer */
 		void create_ast(AST *ast);
 		/* prints debug parse tree with level information */
@@ -0,0 +1,156 @@
+#include "perf_counters.hpp"
+
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+#endif
+
+namespace mpli {
+
+PerfCounters::PerfCounters()
+{
+	for (int i=0; i < N_EVENTS; ++i) {
+		_fds[i] = -1;
+		_slots[i] = -1;
+	}
+	_leader = -1;
+	_n_open = 0;
+}
+
+PerfCounters::~PerfCounters()
+{
+	close();
+}
+
+#ifdef __linux__
+
+static const unsigned long long EVENT_CONFIGS[PerfCounters::N_EVENTS] = {
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_BRANCH_MISSES,
+	PERF_COUNT_HW_CACHE_MISSES
+};
+
+int PerfCounters::open()
+{
+	close();
+	_error.clear();
+	for (int i=0; i < N_EVENTS; ++i) {
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = EVENT_CONFIGS[i];
+		/* user space only, allowed with perf_event_paranoid up to 2 */
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+			PERF_FORMAT_TOTAL_TIME_RUNNING;
+		attr.disabled = (_leader < 0);
+		int fd = syscall(SYS_perf_event_open, &attr, 0, -1, _leader, 0);
+		if (fd < 0) {
+			if (_error.empty()) {
+				_error = std::string(name((EVENT)i)) + ": " + strerror(errno);
+			}
+			continue;
+		}
+		if (_leader < 0) {
+			_leader = fd;
+		}
+		_fds[i] = fd;
+		_slots[i] = _n_open++;
+	}
+	if (_leader < 0) {
+		return 0;
+	}
+	ioctl(_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	return _n_open;
+}
+
+void PerfCounters::read(unsigned long long values[N_EVENTS]) const
+{
+	for (int i=0; i < N_EVENTS; ++i) {
+		values[i] = 0;
+	}
+	if (_leader < 0) {
+		return;
+	}
+	/* nr, time enabled, time running, one value per counter */
+	unsigned long long buf[3 + N_EVENTS];
+	ssize_t n = ::read(_leader, buf, sizeof(buf));
+	if (n < (ssize_t)(3 * sizeof(buf[0])) || buf[0] != (unsigned long long)_n_open) {
+		return;
+	}
+	double scale = 1.0;
+	if (buf[2] > 0 && buf[2] < buf[1]) {
+		scale = (double)buf[1] / buf[2];
+	}
+	for (int i=0; i < N_EVENTS; ++i) {
+		if (_slots[i] >= 0) {
+			values[i] = (unsigned long long)(buf[3 + _slots[i]] * scale);
+		}
+	}
+}
+
+#else
+
+int PerfCounters::open()
+{
+	_error = "not supported on this system";
+	return 0;
+}
+
+void PerfCounters::read(unsigned long long values[N_EVENTS]) const
+{
+	for (int i=0; i < N_EVENTS; ++i) {
+		values[i] = 0;
+	}
+}
+
+#endif
+
+void PerfCounters::close()
+{
+	for (int i=0; i < N_EVENTS; ++i) {
+		if (_fds[i] >= 0) {
+			::close(_fds[i]);
+		}
+		_fds[i] = -1;
+		_slots[i] = -1;
+	}
+	_leader = -1;
+	_n_open = 0;
+}
+
+int PerfCounters::available(EVENT event) const
+{
+	return _fds[event] >= 0;
+}
+
+const std::string &PerfCounters::error() const
+{
+	return _error;
+}
+
+const char *PerfCounters::name(EVENT event)
+{
+	switch (event) {
+	case INSTRUCTIONS:
+		return "instructions";
+	case CYCLES:
+		return "cycles";
+	case BRANCH_MISSES:
+		return "branch_misses";
+	case CACHE_MISSES:
+		return "cache_misses";
+	default:
+		return "unknown";
+	}
+}
+
+} // namespace mpli
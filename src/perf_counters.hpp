@@ -0,0 +1,53 @@
+#ifndef MPLI_PERF_COUNTERS_HPP_
+#define MPLI_PERF_COUNTERS_HPP_
+
+#include <string>
+
+namespace mpli {
+
+/*
+ * Hardware performance counters of the calling thread, user space only,
+ * read with Linux perf_event_open. Counters that cannot be opened, e.g. in
+ * containers or virtual machines without a PMU, are left out and read as 0.
+ */
+class PerfCounters {
+public:
+	enum EVENT {
+		INSTRUCTIONS,
+		CYCLES,
+		BRANCH_MISSES,
+		CACHE_MISSES,
+		N_EVENTS
+	};
+
+private:
+	/* descriptor of every event, -1 if not open, first open one leads
+	 * the group */
+	int _fds[N_EVENTS];
+	int _leader;
+	/* position of event in a group read */
+	int _slots[N_EVENTS];
+	int _n_open;
+	/* why counters are unavailable */
+	std::string _error;
+
+public:
+	PerfCounters();
+	~PerfCounters();
+
+	/* Open all counters and start counting. Returns number of counters
+	 * opened, 0 if there are none, see error(). */
+	int open();
+	void close();
+	int available(EVENT event) const;
+	/* Read counts so far into values, scaled if the kernel multiplexed
+	 * the counters. Unavailable counters read as 0. */
+	void read(unsigned long long values[N_EVENTS]) const;
+	const std::string &error() const;
+
+	/* name of event in reports, e.g. "branch_misses" */
+	static const char *name(EVENT event);
+};
+
+} // namespace mpli
+#endif // MPLI_PERF_COUNTERS_HPP_
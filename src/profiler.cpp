@@ -0,0 +1,202 @@
+#include "profiler.hpp"
+
+#include <cstdio>
+#include <map>
+#include <algorithm>
+
+namespace mpli {
+
+Profiler::Profiler()
+{
+	Frame root;
+	root.node = NULL;
+	root.parent = -1;
+	root.count = 0;
+	root.total_ticks = 0;
+	root.self_ticks = 0;
+	_frames.push_back(root);
+	_start_ticks = 0;
+	_end_ticks = 0;
+}
+
+void Profiler::start()
+{
+	_start_time = std::chrono::steady_clock::now();
+	_start_ticks = ticks();
+	Active a;
+	a.frame = 0;
+	a.start = _start_ticks;
+	a.child_ticks = 0;
+	_stack.push_back(a);
+}
+
+void Profiler::stop()
+{
+	_end_ticks = ticks();
+	_end_time = std::chrono::steady_clock::now();
+	/* frames left open by an exception, and the program */
+	while (!_stack.empty()) {
+		leave();
+	}
+}
+
+void Profiler::enter(ASTNode *node)
+{
+	int parent = _stack.back().frame;
+	int frame = -1;
+	std::vector<std::pair<ASTNode*, int> > &children = _frames[parent].children;
+	for (size_t i=0; i < children.size(); ++i) {
+		if (children[i].first == node) {
+			frame = children[i].second;
+			break;
+		}
+	}
+	if (frame < 0) {
+		frame = _frames.size();
+		Frame f;
+		f.node = node;
+		f.parent = parent;
+		f.count = 0;
+		f.total_ticks = 0;
+		f.self_ticks = 0;
+		_frames[parent].children.push_back(std::make_pair(node, frame));
+		_frames.push_back(f);
+	}
+	Active a;
+	a.frame = frame;
+	a.child_ticks = 0;
+	a.start = ticks();
+	_stack.push_back(a);
+}
+
+void Profiler::leave()
+{
+	unsigned long long now = ticks();
+	Active a = _stack.back();
+	_stack.pop_back();
+	unsigned long long elapsed = now - a.start;
+	Frame &f = _frames[a.frame];
+	f.count++;
+	f.total_ticks += elapsed;
+	f.self_ticks += elapsed > a.child_ticks ? elapsed - a.child_ticks : 0;
+	if (!_stack.empty()) {
+		_stack.back().child_ticks += elapsed;
+	}
+}
+
+double Profiler::ns_per_tick() const
+{
+	double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(_end_time - _start_time).count();
+	if (_end_ticks <= _start_ticks) {
+		return 1;
+	}
+	return ns / (_end_ticks - _start_ticks);
+}
+
+std::string Profiler::label(ASTNode *node)
+{
+	switch (node->type) {
+		case ASTNode::VAR_INIT:
+			return "var " + node->children[0]->value;
+		case ASTNode::INSERT:
+			return node->children[0]->value + " :=";
+		case ASTNode::FOR_LOOP:
+			return "for " + node->children[0]->children[0]->value;
+		case ASTNode::READ:
+			return "read " + node->children[0]->value;
+		case ASTNode::PRINT:
+			return "print";
+		case ASTNode::ASSERT:
+			return "assert";
+		case ASTNode::UNARY_OP:
+			return "!";
+		case ASTNode::OPERATOR: {
+			const char *ops[] = { "+", "-", "*", "/", "<", "=", "&", "!" };
+			return ops[node->operator_type];
+		}
+		default:
+			return node->value;
+	}
+}
+
+void Profiler::frame_path(int frame, std::string &out) const
+{
+	if (frame == 0) {
+		out.append("program");
+		return;
+	}
+	frame_path(_frames[frame].parent, out);
+	char position[32];
+	snprintf(position, sizeof(position), " %d:%d", _frames[frame].node->line,
+		_frames[frame].node->column);
+	out.append(";");
+	out.append(label(_frames[frame].node));
+	out.append(position);
+}
+
+/* per node totals of report */
+struct NodeTotal {
+	ASTNode *node;
+	unsigned long long count;
+	unsigned long long total_ticks;
+	unsigned long long self_ticks;
+};
+
+static bool by_self_ticks(const NodeTotal &a, const NodeTotal &b)
+{
+	return a.self_ticks > b.self_ticks;
+}
+
+void Profiler::report(std::string &out) const
+{
+	std::map<ASTNode*, NodeTotal> by_node;
+	for (size_t i=1; i < _frames.size(); ++i) {
+		const Frame &f = _frames[i];
+		NodeTotal &t = by_node[f.node];
+		t.node = f.node;
+		t.count += f.count;
+		t.total_ticks += f.total_ticks;
+		t.self_ticks += f.self_ticks;
+	}
+	std::vector<NodeTotal> totals;
+	std::map<ASTNode*, NodeTotal>::iterator it;
+	for (it = by_node.begin(); it != by_node.end(); ++it) {
+		totals.push_back(it->second);
+	}
+	std::sort(totals.begin(), totals.end(), by_self_ticks);
+
+	double scale = ns_per_tick() / 1e6;
+	double run_ms = _frames[0].total_ticks * scale;
+	char line[256];
+	snprintf(line, sizeof(line), "profile: %.3f ms, %.3f ns per tick\n", run_ms, ns_per_tick());
+	out.append(line);
+	snprintf(line, sizeof(line), "%10s  %-16s %12s %12s %12s %6s\n", "line:col", "node",
+		"count", "total ms", "self ms", "self%");
+	out.append(line);
+	for (size_t i=0; i < totals.size(); ++i) {
+		const NodeTotal &t = totals[i];
+		char position[32];
+		snprintf(position, sizeof(position), "%d:%d", t.node->line, t.node->column);
+		snprintf(line, sizeof(line), "%10s  %-16.16s %12llu %12.3f %12.3f %6.1f\n", position,
+			label(t.node).c_str(), t.count, t.total_ticks * scale, t.self_ticks * scale,
+			run_ms > 0 ? 100.0 * t.self_ticks * scale / run_ms : 0.0);
+		out.append(line);
+	}
+}
+
+void Profiler::folded(std::string &out) const
+{
+	double scale = ns_per_tick();
+	for (size_t i=0; i < _frames.size(); ++i) {
+		unsigned long long ns = (unsigned long long)(_frames[i].self_ticks * scale);
+		if (ns == 0) {
+			continue;
+		}
+		frame_path(i, out);
+		char value[32];
+		snprintf(value, sizeof(value), " %llu\n", ns);
+		out.append(value);
+	}
+}
+
+} // namespace mpli
@@ -0,0 +1,85 @@
+#ifndef MPLI_PROFILER_HPP_
+#define MPLI_PROFILER_HPP_
+
+#include "ast.hpp"
+#include <vector>
+#include <string>
+#include <utility>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace mpli {
+
+/*
+ * Execution profiler of the interpreter. Counts executions and time of
+ * statement and operator nodes in a call tree, which follows the nesting
+ * of statements and expressions. Time is read from the TSC where there is
+ * one.
+ */
+class Profiler {
+private:
+	struct Frame {
+		ASTNode *node;
+		int parent;
+		/* node and frame index of children */
+		std::vector<std::pair<ASTNode*, int> > children;
+		unsigned long long count;
+		unsigned long long total_ticks;
+		unsigned long long self_ticks;
+	};
+	/* frame being executed */
+	struct Active {
+		int frame;
+		unsigned long long start;
+		unsigned long long child_ticks;
+	};
+
+	/* frame 0 is the program */
+	std::vector<Frame> _frames;
+	std::vector<Active> _stack;
+
+	unsigned long long _start_ticks;
+	unsigned long long _end_ticks;
+	std::chrono::steady_clock::time_point _start_time;
+	std::chrono::steady_clock::time_point _end_time;
+
+	/* nanoseconds per tick, measured between start() and stop() */
+	double ns_per_tick() const;
+	/* frame names from program down to frame, separated by ';' */
+	void frame_path(int frame, std::string &out) const;
+
+public:
+	Profiler();
+
+	static inline unsigned long long ticks()
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	/* call around the profiled run */
+	void start();
+	void stop();
+
+	/* node starts and finishes executing */
+	void enter(ASTNode *node);
+	void leave();
+
+	/* Write nodes sorted by their own time, with counts and times. */
+	void report(std::string &out) const;
+	/* Write folded stacks, one line of "frame;frame;... nanoseconds" per
+	 * call tree node, as read by flamegraph.pl. */
+	void folded(std::string &out) const;
+
+	/* short description of node, e.g. "for i" or "+" */
+	static std::string label(ASTNode *node);
+};
+
+} // namespace mpli
+#endif // MPLI_PROFILER_HPP_
@@ -0,0 +1,177 @@
+#include "program.hpp"
+#include "scanner.hpp"
+#include "parser.hpp"
+#include "ir_builder.hpp"
+#include "ir_passes.hpp"
+#include "program_cache.hpp"
+#include "stats.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <chrono>
+
+namespace mpli {
+
+Program::Options::Options()
+{
+	hoist = 1;
+	opt_level = -1;
+	max_depth = Parser::DEFAULT_MAX_DEPTH;
+}
+
+Program::Hooks::Hooks()
+{
+	stats = NULL;
+	cache = NULL;
+	pass_report = NULL;
+	parse_failed = 0;
+}
+
+Program::Program()
+{
+	_ir = NULL;
+}
+
+Program::~Program()
+{
+	delete _ir;
+}
+
+/* start phase of stats, if they are collected */
+static void begin_phase(Stats *stats, const char *name)
+{
+	if (stats) {
+		stats->begin(name);
+	}
+}
+
+/* Scan and parse source into ast, returns 0 on success. */
+static int parse_source(const std::string &source, int max_depth, AST &ast,
+	std::string *errors, Program::Hooks *hooks)
+{
+	Stats *stats = hooks ? hooks->stats : NULL;
+	begin_phase(stats, "parse");
+	Scanner scanner;
+	scanner.open_input_string(source);
+	Stats::Sample scanning;
+	if (stats) {
+		scanner.set_timing(&scanning);
+	}
+	Parser parser;
+	parser.set_scanner(&scanner);
+	parser.set_max_depth(max_depth);
+	parser.start();
+	if (stats) {
+		stats->end();
+		stats->split("parse", "scan", scanning);
+		stats->set_counter("tokens", scanner.n_tokens());
+		stats->set_counter("parse_nodes", parser.number_of_nodes());
+	}
+	if (parser.number_of_errors() > 0) {
+		if (errors) {
+			errors->append(parser.errors());
+		}
+		if (hooks) {
+			hooks->parse_failed = 1;
+		}
+		return 1;
+	}
+
+	begin_phase(stats, "ast");
+	parser.create_ast(&ast);
+	if (stats) {
+		stats->end();
+	}
+	if (ast.number_of_errors() > 0 || !ast.root()) {
+		if (errors) {
+			errors->append(ast.errors());
+		}
+		return 1;
+	}
+	return 0;
+}
+
+Program *Program::compile(const std::string &source, const Options &options,
+	std::string *errors, Hooks *hooks)
+{
+	Stats *stats = hooks ? hooks->stats : NULL;
+	const ProgramCache *cache = hooks ? hooks->cache : NULL;
+	Program *program = new Program;
+
+	/* checked program from an earlier run, or parse and cache it */
+	begin_phase(stats, "load");
+	ProgramCache::Entry image;
+	if (!cache || cache->map(source, "ast", image) != 0 ||
+		program->_ast.load(image.data(), image.size()) != 0) {
+		if (parse_source(source, options.max_depth, program->_ast, errors, hooks) != 0) {
+			delete program;
+			return NULL;
+		}
+		if (cache) {
+			begin_phase(stats, "store");
+			std::string flat;
+			program->_ast.serialize(flat);
+			cache->store(source, "ast", flat);
+		}
+	}
+	if (stats) {
+		stats->set_counter("ast_nodes", count_nodes(program->_ast.root()));
+	}
+
+	begin_phase(stats, "optimize");
+	if (options.hoist) {
+		program->_optimizer.optimize(program->_ast.root());
+	}
+	if (options.opt_level >= 0) {
+		/* programs the IR does not cover stay on the AST interpreter */
+		begin_phase(stats, "lower");
+		IRBuilder builder;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		program->_ir = builder.build(program->_ast.root());
+		std::chrono::duration<double> lowering = std::chrono::steady_clock::now() - start;
+		if (program->_ir) {
+			PassManager passes;
+			passes.record("lowering", lowering.count(), program->_ir->n_insns());
+			passes.add_level(options.opt_level);
+			passes.run(*program->_ir);
+			if (hooks && hooks->pass_report) {
+				passes.report(*hooks->pass_report);
+			}
+		} else if (hooks) {
+			hooks->ir_error = builder.error();
+		}
+	}
+	if (stats) {
+		stats->end();
+	}
+	return program;
+}
+
+int Program::read_file(const std::string &filename, std::string &source)
+{
+	std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+	if (!in) {
+		return 1;
+	}
+	std::ostringstream text;
+	text << in.rdbuf();
+	source = text.str();
+	return 0;
+}
+
+const AST &Program::ast() const
+{
+	return _ast;
+}
+
+const Optimizer &Program::optimizer() const
+{
+	return _optimizer;
+}
+
+const IRFunction *Program::ir() const
+{
+	return _ir;
+}
+
+} // namespace mpli
@@ -0,0 +1,84 @@
+#ifndef MPLI_PROGRAM_HPP_
+#define MPLI_PROGRAM_HPP_
+
+#include "ast.hpp"
+#include "optimizer.hpp"
+#include "ir.hpp"
+#include <string>
+
+namespace mpli {
+
+class Context;
+class Stats;
+class ProgramCache;
+
+/*
+ * Compiled program: checked AST with optimizer annotations, and IR when
+ * requested. A program is never changed after compile(), so it can be run
+ * by any number of contexts, also on different threads at the same time.
+ */
+class Program {
+public:
+	struct Options {
+		/* cache loop-invariant and repeated expressions, see Optimizer */
+		int hoist;
+		/* -1: run on the AST interpreter, otherwise lower into IR and
+		 * optimize it at this level, see PassManager */
+		int opt_level;
+		/* limit of nested parentheses and loops, see Parser::set_max_depth */
+		int max_depth;
+
+		Options();
+	};
+
+	/* Optional hooks into compile() for tools around it, such as the
+	 * command line interpreter. */
+	struct Hooks {
+		/* phases load, parse (with scan split out), ast, store, optimize
+		 * and lower are recorded here, with token and node counters */
+		Stats *stats;
+		/* checked ASTs are looked up here by source, and stored after
+		 * parsing */
+		const ProgramCache *cache;
+		/* time of lowering and of every IR pass is reported here */
+		std::string *pass_report;
+
+		/* set when errors come from the parser, not from building the AST */
+		int parse_failed;
+		/* why the program was not lowered into IR */
+		std::string ir_error;
+
+		Hooks();
+	};
+
+private:
+	AST _ast;
+	Optimizer _optimizer;
+	/* NULL when program runs on the AST interpreter */
+	IRFunction *_ir;
+
+	Program();
+	Program(const Program&);
+	Program &operator=(const Program&);
+	friend class Context;
+
+public:
+	~Program();
+
+	/* Compile source. Returns NULL if it has errors, their messages are
+	 * appended into errors when it is given. */
+	static Program *compile(const std::string &source, const Options &options,
+		std::string *errors = NULL, Hooks *hooks = NULL);
+
+	/* Read whole file into source. Returns 0 on success, 1 if it cannot
+	 * be read. */
+	static int read_file(const std::string &filename, std::string &source);
+
+	const AST &ast() const;
+	const Optimizer &optimizer() const;
+	/* NULL if program is not run on the IR backend */
+	const IRFunction *ir() const;
+};
+
+} // namespace mpli
+#endif // MPLI_PROGRAM_HPP_
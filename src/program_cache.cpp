@@ -0,0 +1,206 @@
+#include "program_cache.hpp"
+#include "build_id.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+namespace mpli {
+
+/* write all of data into fd, returns 0 on success */
+static int write_all(int fd, const char *data, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = write(fd, data, len);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n < 0) {
+			return 1;
+		}
+		data += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/* mkdir -p, returns 0 if dir exists afterwards */
+static int make_dirs(const std::string &dir)
+{
+	for (size_t i=1; i <= dir.size(); ++i) {
+		if (i == dir.size() || dir[i] == '/') {
+			std::string part = dir.substr(0, i);
+			if (mkdir(part.c_str(), 0755) != 0 && errno != EEXIST) {
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+ProgramCache::Entry::Entry()
+{
+	_map = NULL;
+	_map_size = 0;
+	_data = NULL;
+	_size = 0;
+}
+
+ProgramCache::Entry::~Entry()
+{
+	if (_map) {
+		munmap(_map, _map_size);
+	}
+}
+
+const char *ProgramCache::Entry::data() const
+{
+	return _data;
+}
+
+size_t ProgramCache::Entry::size() const
+{
+	return _size;
+}
+
+ProgramCache::ProgramCache(const std::string &dir)
+{
+	_dir = dir;
+}
+
+std::string ProgramCache::default_dir()
+{
+	const char *xdg = getenv("XDG_CACHE_HOME");
+	if (xdg && xdg[0] == '/') {
+		return std::string(xdg) + "/mpli";
+	}
+	const char *home = getenv("HOME");
+	if (home && home[0] != '\0') {
+		return std::string(home) + "/.cache/mpli";
+	}
+	return std::string();
+}
+
+const char *ProgramCache::build_id()
+{
+	return MPLI_BUILD_ID;
+}
+
+unsigned long long ProgramCache::hash(const std::string &data)
+{
+	unsigned long long h = 14695981039346656037ULL;
+	for (size_t i=0; i < data.size(); ++i) {
+		h ^= (unsigned char)data[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+std::string ProgramCache::path(const std::string &source, const char *kind) const
+{
+	char name[64];
+	snprintf(name, sizeof(name), "/%016llx-%016llx.%s", hash(source), hash(build_id()), kind);
+	return _dir + name;
+}
+
+int ProgramCache::map(const std::string &source, const char *kind, Entry &entry) const
+{
+	if (_dir.empty() || entry._map) {
+		return 1;
+	}
+	int fd = open(path(source, kind).c_str(), O_RDONLY);
+	if (fd < 0) {
+		return 1;
+	}
+	struct stat st;
+	void *m = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+		m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+	if (m == MAP_FAILED) {
+		return 1;
+	}
+	entry._map = m;
+	entry._map_size = st.st_size;
+	const char *begin = (const char*)m;
+	size_t size = st.st_size;
+
+	/* header line, then source and data */
+	const char *newline = (const char*)memchr(begin, '\n', size < 128 ? size : 128);
+	if (!newline) {
+		return 1;
+	}
+	std::string header(begin, newline + 1);
+	int version = 0;
+	char entry_build[64];
+	char entry_kind[32];
+	unsigned long long source_len = 0, data_len = 0;
+	if (sscanf(header.c_str(), "mpli-cache %d %63s %31s %llu %llu\n", &version, entry_build,
+		entry_kind, &source_len, &data_len) != 5) {
+		return 1;
+	}
+	size_t header_len = header.size();
+	if (version != VERSION || strcmp(entry_build, build_id()) != 0 ||
+		strcmp(entry_kind, kind) != 0 ||
+		source_len != source.size() || size - header_len < source_len ||
+		size - header_len - source_len != data_len ||
+		memcmp(begin + header_len, source.data(), source_len) != 0) {
+		return 1;
+	}
+	entry._data = begin + header_len + source_len;
+	entry._size = data_len;
+	return 0;
+}
+
+int ProgramCache::load(const std::string &source, const char *kind, std::string &data) const
+{
+	Entry entry;
+	if (map(source, kind, entry) != 0) {
+		return 1;
+	}
+	data.assign(entry.data(), entry.size());
+	return 0;
+}
+
+int ProgramCache::store(const std::string &source, const char *kind, const std::string &data) const
+{
+	if (_dir.empty() || make_dirs(_dir) != 0) {
+		return 1;
+	}
+	std::string final_path = path(source, kind);
+	char suffix[32];
+	snprintf(suffix, sizeof(suffix), ".tmp%ld", (long)getpid());
+	std::string tmp_path = final_path + suffix;
+	int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		return 1;
+	}
+	char header[128];
+	int header_len = snprintf(header, sizeof(header), "mpli-cache %d %s %s %llu %llu\n", VERSION,
+		build_id(), kind, (unsigned long long)source.size(), (unsigned long long)data.size());
+	int r = write_all(fd, header, header_len);
+	if (r == 0) {
+		r = write_all(fd, source.data(), source.size());
+	}
+	if (r == 0) {
+		r = write_all(fd, data.data(), data.size());
+	}
+	if (close(fd) != 0) {
+		r = 1;
+	}
+	if (r == 0 && rename(tmp_path.c_str(), final_path.c_str()) != 0) {
+		r = 1;
+	}
+	if (r != 0) {
+		unlink(tmp_path.c_str());
+	}
+	return r;
+}
+
+} // namespace mpli
@@ -0,0 +1,69 @@
+#ifndef MPLI_PROGRAM_CACHE_HPP_
+#define MPLI_PROGRAM_CACHE_HPP_
+
+#include <string>
+#include <cstddef>
+
+namespace mpli {
+
+/*
+ * On-disk cache of results derived from a program source, such as its
+ * precomputed output. Entries are files named by a hash of the source and
+ * the kind of result. An entry stores the whole source too, and is used
+ * only if it matches exactly. Entries are written into a temporary file
+ * and renamed into place, so concurrent runs never see partial entries.
+ */
+class ProgramCache {
+public:
+	/* Version of the entry layout, bumped whenever it changes. Entries
+	 * are also keyed by build_id(), so data cached by another build of
+	 * the interpreter is never used. */
+	static const int VERSION = 4;
+
+	/* read-only mapping of the data of an entry, unmapped on destruction */
+	class Entry {
+	private:
+		void *_map;
+		size_t _map_size;
+		const char *_data;
+		size_t _size;
+
+		Entry(const Entry&);
+		Entry &operator=(const Entry&);
+		friend class ProgramCache;
+	public:
+		Entry();
+		~Entry();
+		const char *data() const;
+		size_t size() const;
+	};
+
+private:
+	std::string _dir;
+
+	/* path of entry for source and kind */
+	std::string path(const std::string &source, const char *kind) const;
+
+public:
+	/* cache in directory dir, created on first store */
+	ProgramCache(const std::string &dir);
+
+	/* $XDG_CACHE_HOME/mpli or ~/.cache/mpli, empty if neither is set */
+	static std::string default_dir();
+	/* project version, git commit and hash of the sources of this build */
+	static const char *build_id();
+	/* 64-bit FNV-1a hash of data */
+	static unsigned long long hash(const std::string &data);
+
+	/* Map data of kind cached for source into entry. Returns 0 on
+	 * success, 1 if there is no valid entry. */
+	int map(const std::string &source, const char *kind, Entry &entry) const;
+	/* Load a copy of data of kind cached for source, as map(). */
+	int load(const std::string &source, const char *kind, std::string &data) const;
+	/* Store data of kind for source. Returns 0 on success, 1 if entry
+	 * could not be written. */
+	int store(const std::string &source, const char *kind, const std::string &data) const;
+};
+
+} // namespace mpli
+#endif // MPLI_PROGRAM_CACHE_HPP_
@@ -0,0 +1,195 @@
+#include "sampler.hpp"
+#include "profiler.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <csignal>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <ctime>
+#include <sys/time.h>
+
+namespace mpli {
+
+/* sampler the signal handler records into */
+static std::atomic<Sampler*> active(NULL);
+
+static double cpu_seconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+Sampler::Sampler()
+{
+	_current.store(NULL);
+	for (int i=0; i < CAPACITY; ++i) {
+		_nodes[i].store(NULL);
+		_counts[i].store(0);
+	}
+	_idle.store(0);
+	_dropped.store(0);
+	_hz = 0;
+	_cpu_start = 0;
+	_cpu_seconds = 0;
+}
+
+Sampler::~Sampler()
+{
+	stop();
+}
+
+void Sampler::handle_signal(int)
+{
+	Sampler *sampler = active.load(std::memory_order_relaxed);
+	if (sampler) {
+		sampler->record();
+	}
+}
+
+void Sampler::record()
+{
+	/* runs in the signal handler: only lock-free atomics */
+	ASTNode *node = _current.load(std::memory_order_relaxed);
+	if (!node) {
+		_idle.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	unsigned long slot = ((unsigned long)node >> 4) % CAPACITY;
+	for (int i=0; i < CAPACITY; ++i) {
+		ASTNode *key = _nodes[slot].load(std::memory_order_relaxed);
+		if (key == NULL) {
+			if (_nodes[slot].compare_exchange_strong(key, node)) {
+				key = node;
+			}
+		}
+		if (key == node) {
+			_counts[slot].fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		slot = (slot + 1) % CAPACITY;
+	}
+	_dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+int Sampler::start(int hz)
+{
+	if (hz <= 0 || hz > 1000000) {
+		return 1;
+	}
+	Sampler *expected = NULL;
+	if (!active.compare_exchange_strong(expected, this)) {
+		return 1;
+	}
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = handle_signal;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	struct itimerval timer;
+	timer.it_interval.tv_sec = 0;
+	timer.it_interval.tv_usec = 1000000 / hz;
+	timer.it_value = timer.it_interval;
+	if (sigaction(SIGPROF, &action, NULL) != 0 || setitimer(ITIMER_PROF, &timer, NULL) != 0) {
+		active.store(NULL);
+		return 1;
+	}
+	_hz = hz;
+	_cpu_start = cpu_seconds();
+	return 0;
+}
+
+void Sampler::stop()
+{
+	if (active.load() != this) {
+		return;
+	}
+	struct itimerval timer;
+	memset(&timer, 0, sizeof(timer));
+	setitimer(ITIMER_PROF, &timer, NULL);
+	_cpu_seconds += cpu_seconds() - _cpu_start;
+	/* The handler stays installed: a signal still pending finds no
+	 * active sampler, where the default action would end the process. */
+	active.store(NULL);
+}
+
+void Sampler::report(std::string &out, const std::string *source) const
+{
+	/* samples and statements of every line */
+	std::map<int, std::pair<unsigned long, std::vector<ASTNode*> > > lines;
+	unsigned long total = _idle.load() + _dropped.load();
+	for (int i=0; i < CAPACITY; ++i) {
+		ASTNode *node = _nodes[i].load();
+		if (node) {
+			std::pair<unsigned long, std::vector<ASTNode*> > &line = lines[node->line];
+			line.first += _counts[i].load();
+			line.second.push_back(node);
+			total += _counts[i].load();
+		}
+	}
+	/* start offset of every source line */
+	std::vector<size_t> starts;
+	if (source) {
+		starts.push_back(0);
+		for (size_t i=0; i < source->size(); ++i) {
+			if ((*source)[i] == '\n') {
+				starts.push_back(i + 1);
+			}
+		}
+	}
+
+	std::vector<std::pair<unsigned long, int> > order;
+	for (std::map<int, std::pair<unsigned long, std::vector<ASTNode*> > >::const_iterator it =
+		lines.begin(); it != lines.end(); ++it) {
+		order.push_back(std::make_pair(it->second.first, it->first));
+	}
+	std::sort(order.begin(), order.end());
+	std::reverse(order.begin(), order.end());
+
+	char buf[256];
+	/* the kernel may deliver fewer signals than asked for, e.g. at most
+	 * one per scheduler tick */
+	snprintf(buf, sizeof(buf), "%lu samples in %.3f s of CPU time (%.0f Hz, %d Hz asked)\n",
+		total, _cpu_seconds, _cpu_seconds > 0 ? total / _cpu_seconds : 0.0, _hz);
+	out.append(buf);
+	snprintf(buf, sizeof(buf), "%10s %7s %6s  %s\n", "samples", "%", "line", "source");
+	out.append(buf);
+	for (size_t i=0; i < order.size(); ++i) {
+		int line = order[i].second;
+		const std::vector<ASTNode*> &nodes = lines[line].second;
+		snprintf(buf, sizeof(buf), "%10lu %6.2f%% %6d  ", order[i].first,
+			total > 0 ? 100.0 * order[i].first / total : 0.0, line);
+		out.append(buf);
+		if (line >= 1 && line <= (int)starts.size()) {
+			size_t begin = starts[line - 1];
+			size_t end = source->find('\n', begin);
+			if (end == std::string::npos) {
+				end = source->size();
+			}
+			while (begin < end && ((*source)[begin] == ' ' || (*source)[begin] == '\t')) {
+				++begin;
+			}
+			out.append(*source, begin, std::min(end - begin, (size_t)60));
+		} else {
+			for (size_t j=0; j < nodes.size(); ++j) {
+				out.append(j > 0 ? ", " : "");
+				out.append(Profiler::label(nodes[j]));
+			}
+		}
+		out.append("\n");
+	}
+	if (_idle.load() > 0) {
+		snprintf(buf, sizeof(buf), "%10lu %6.2f%% %6s  outside statements\n", _idle.load(),
+			total > 0 ? 100.0 * _idle.load() / total : 0.0, "-");
+		out.append(buf);
+	}
+	if (_dropped.load() > 0) {
+		snprintf(buf, sizeof(buf), "%10lu %6.2f%% %6s  more than %d statements, not recorded\n",
+			_dropped.load(), total > 0 ? 100.0 * _dropped.load() / total : 0.0, "-", CAPACITY);
+		out.append(buf);
+	}
+}
+
+} // namespace mpli
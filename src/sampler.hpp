@@ -0,0 +1,71 @@
+#ifndef MPLI_SAMPLER_HPP_
+#define MPLI_SAMPLER_HPP_
+
+#include "ast.hpp"
+#include <atomic>
+#include <string>
+
+namespace mpli {
+
+/*
+ * Statistical profiler: SIGPROF fires at a fixed rate of process CPU time
+ * and the handler counts the statement the interpreter published as
+ * executing. Unlike Profiler, the run is not instrumented, loops keep
+ * running as kernels and are attributed to their loop statement.
+ * One sampler can be running in the process at a time.
+ */
+class Sampler {
+public:
+	/* default rate of samples per second of CPU time */
+	static const int DEFAULT_HZ = 1000;
+	/* distinct statements that can be counted */
+	static const int CAPACITY = 4096;
+
+private:
+	/* statement being executed, written by the interpreter */
+	std::atomic<ASTNode*> _current;
+	/* open addressing table of statement counts, filled by the handler */
+	std::atomic<ASTNode*> _nodes[CAPACITY];
+	std::atomic<unsigned long> _counts[CAPACITY];
+	/* samples outside statements, and those that did not fit */
+	std::atomic<unsigned long> _idle;
+	std::atomic<unsigned long> _dropped;
+	int _hz;
+	/* CPU time of the process at start(), and sampled until stop() */
+	double _cpu_start;
+	double _cpu_seconds;
+
+	static void handle_signal(int signal);
+	void record();
+
+public:
+	Sampler();
+	~Sampler();
+
+	/* Start sampling hz times per second of CPU time. Returns 0 on
+	 * success, 1 if the timer or handler could not be set up or another
+	 * sampler is running. */
+	int start(int hz = DEFAULT_HZ);
+	void stop();
+
+	/* Publish statement starting to execute, returns the one it replaces.
+	 * Only the interpreter thread writes, so no read-modify-write. */
+	inline ASTNode *enter(ASTNode *node)
+	{
+		ASTNode *previous = _current.load(std::memory_order_relaxed);
+		_current.store(node, std::memory_order_relaxed);
+		return previous;
+	}
+	/* restore statement returned by enter() */
+	inline void leave(ASTNode *previous)
+	{
+		_current.store(previous, std::memory_order_relaxed);
+	}
+
+	/* Write samples per source line, most sampled first, with the text of
+	 * the line taken from source if it is given. */
+	void report(std::string &out, const std::string *source) const;
+};
+
+} // namespace mpli
+#endif // MPLI_SAMPLER_HPP_
@@ -1,4 +1,5 @@
 #include "scanner.hpp"
+#include "symbol_table.hpp"
 #include <cstring>
 #include <cstdio>
 
@@ -6,6 +7,14 @@ namespace mpli {
 
 Scanner::Scanner()
 {
+    _input = &_input_file;
+    _line = 1;
+    _column = 1;
+    _token_line = 0;
+    _token_column = 0;
+    _n_tokens = 0;
+    _timing = NULL;
+
     /* Constructing states table:
        Must be constructed in a priority order high-low.*/
     /* 0: initial state */
@@ -171,7 +180,7 @@ int Scanner::get_next_state(char next_char, int curr_state)
     std::vector<StateRow> vec = _states_map[curr_state];
     CHARTYPE nc_type = get_char_type(next_char), ns_char_type = OTHER;
     int ns_not_flag = 0;
-    for (int i=0; i < vec.size(); ++i) {
+    for (size_t i=0; i < vec.size(); ++i) {
         ns_char_type = vec[i].next_char;
         ns_not_flag = vec[i].not_flag;
         if ((nc_type == ns_char_type && !ns_not_flag) |
@@ -183,44 +192,59 @@ int Scanner::get_next_state(char next_char, int curr_state)
     return _TOKEN_ERROR_STATE;
 }
 
+void Scanner::get_char(char &c)
+{
+    _input->get(c);
+    if (c == '\n') {
+        ++_line;
+        _column = 1;
+    } else {
+        ++_column;
+    }
+}
+
 Token Scanner::run_automaton(std::string *strbuffer)
 {
     int curr_state = 0;
     char curr_c = 0, peek_c = 0;
-    peek_c = _input_file.peek();
+    peek_c = _input->peek();
     /* get rid of whitespace */
-    while(is_whitespace(peek_c) && strbuffer->size() == 0 && _input_file.good()) {
-        _input_file.get(curr_c);
-        peek_c = _input_file.peek();
+    while(is_whitespace(peek_c) && strbuffer->size() == 0 && _input->good()) {
+        get_char(curr_c);
+        peek_c = _input->peek();
     }
     
-    if (!_input_file.good()) {
+    _token_line = _line;
+    _token_column = _column;
+    if (!_input->good()) {
         return create_token(*strbuffer);
     }
 
     /* run state machine defined by states table */
-    while (curr_state >= 0 && _input_file.good()) {
-        peek_c = _input_file.peek();
+    while (curr_state >= 0 && _input->good()) {
+        peek_c = _input->peek();
         curr_state = get_next_state(peek_c, curr_state);
         if (curr_state >= 0 || curr_state == _TOKEN_END_STATE) {
-            _input_file.get(curr_c);
+            get_char(curr_c);
             strbuffer->push_back(curr_c);
         } else if (curr_state == _TOKEN_SKIP_STATE) {
 			/* skip token -> clear buffer, set state to 0, get rid of possible whitespace */
-			_input_file.get(curr_c);
-			peek_c = _input_file.peek();
+			get_char(curr_c);
+			peek_c = _input->peek();
 			strbuffer->clear();
 			curr_state = 0;
-			while(is_whitespace(peek_c) && _input_file.good()) {
-				_input_file.get(curr_c);
-				peek_c = _input_file.peek();
+			while(is_whitespace(peek_c) && _input->good()) {
+				get_char(curr_c);
+				peek_c = _input->peek();
 			}
+			_token_line = _line;
+			_token_column = _column;
 		}
     }    
     
     /* if buffer is empty, it means first char is invalid token */
     if (strbuffer->size() == 0) {
-        _input_file.get(curr_c);
+        get_char(curr_c);
         strbuffer->push_back(curr_c);
         return create_error_token(*strbuffer);
     }
@@ -248,7 +272,7 @@ Token::TYPE Scanner::get_token_type(std::string str)
 
     /* check for integer */
     int is_int = 1;
-    for (int i=0; i < str.size(); ++i) {
+    for (size_t i=0; i < str.size(); ++i) {
         if (!is_digit(str[i])) {
             is_int = 0;
             break;
@@ -265,7 +289,7 @@ Token::TYPE Scanner::get_token_type(std::string str)
     /* check for identifier */
     if (is_alpha(str[0])) {
         int is_ident = 1;
-        for (int i=0; i < str.size(); ++i) {
+        for (size_t i=0; i < str.size(); ++i) {
             if (!(is_alpha(str[i]) || is_digit(str[i]) || str[i] == '_' )) {
                 is_ident = 0;
                 break;
@@ -282,7 +306,7 @@ Token::TYPE Scanner::get_token_type(std::string str)
 Token Scanner::create_token(std::string str)
 {
     if (str.size() == 0) {
-        if (_input_file.eof())
+        if (_input->eof())
             return Token(Token::END_OF_FILE, str);
         return Token(Token::ERROR, str);
     }
@@ -294,7 +318,12 @@ Token Scanner::create_token(std::string str)
         str.erase(0, 1);
     }
 
-    return Token(type, str);
+    Token token(type, str);
+    /* hashed here once, AST interns identifiers by it */
+    if (type == Token::IDENTIFIER) {
+        token.hash = Identifiers::hash(str.data(), str.size());
+    }
+    return token;
 }
 
 Token Scanner::create_error_token(std::string str)
@@ -307,16 +336,52 @@ void Scanner::open_input_file(const char *filename)
     if (_input_file.is_open())
         _input_file.close();
     _input_file.open(filename);     
+    _input = &_input_file;
+    _line = 1;
+    _column = 1;
+}
+
+void Scanner::open_input_string(const std::string &source)
+{
+    _input_string.str(source);
+    _input_string.clear();
+    _input = &_input_string;
+    _line = 1;
+    _column = 1;
+}
+
+unsigned long long Scanner::n_tokens()
+{
+    return _n_tokens;
+}
+
+void Scanner::set_timing(Stats::Sample *timing)
+{
+    _timing = timing;
 }
 
 Token Scanner::next_token()
 {
-    if (_input_file.good()) {
+    ++_n_tokens;
+    if (_timing) {
+        Stats::Sample start = Stats::now();
+        Token t = scan_token();
+        *_timing += Stats::now() - start;
+        return t;
+    }
+    return scan_token();
+}
+
+Token Scanner::scan_token()
+{
+    if (_input->good()) {
         /* run automaton with string buffer */
         std::string *strbuffer;
         strbuffer = new std::string();
         Token t = run_automaton(strbuffer);
         delete strbuffer;
+        t.line = _token_line;
+        t.column = _token_column;
         return t;
     } else {
         /* create error token */
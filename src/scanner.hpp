@@ -2,8 +2,10 @@
 #define MPLI_SCANNER_HPP_
 
 #include "token.hpp"
+#include "stats.hpp"
 #include <string>
 #include <fstream>
+#include <sstream>
 #include <vector>
 #include <map>
 
@@ -37,8 +39,24 @@ private:
 	/* the state automaton map */
     std::map<int, std::vector<StateRow> > _states_map;
 
-	/* input file */
+	/* input file, or source given as string */
     std::ifstream _input_file;
+    std::istringstream _input_string;
+    /* the one of them that is read */
+    std::istream *_input;
+    /* position of next character, and of first character of token */
+    int _line;
+    int _column;
+    int _token_line;
+    int _token_column;
+
+    /* tokens returned so far */
+    unsigned long long _n_tokens;
+    /* time spent in next_token() is added here, if set */
+    Stats::Sample *_timing;
+
+	/* read next character, keeping track of position */
+    void get_char(char &c);
 
 	/* returns true if character is space, tab or linebreak */
     int is_whitespace(char c);
@@ -59,13 +77,21 @@ private:
 	Token create_token(std::string str);
     /* create error token */
 	Token create_error_token(std::string str);
+	/* next_token() without timing */
+    Token scan_token();
 public:
     Scanner();
     ~Scanner();
 	/* open given input file, must be called before next_token() */
     void open_input_file(const char *filename);
+	/* scan given source instead of a file */
+    void open_input_string(const std::string &source);
 	/* returns next token of token stream */
     Token next_token();
+	/* number of tokens returned by next_token() */
+    unsigned long long n_tokens();
+	/* add time and allocations of next_token() into timing, NULL to stop */
+    void set_timing(Stats::Sample *timing);
 };
 
 } // namespace mpli
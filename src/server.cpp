@@ -0,0 +1,604 @@
+#include "server.hpp"
+#include "context.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <stdexcept>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+namespace mpli {
+
+/* requests larger than this are refused */
+static const unsigned long long MAX_REQUEST_SIZE = 64ULL * 1024 * 1024;
+/* longest header line of a request */
+static const size_t MAX_HEADER = 256;
+/* a client that does not take a response for this many seconds is
+ * dropped, so it cannot hold a worker */
+static const int SEND_TIMEOUT_S = 10;
+/* a worker keeps a connection whose next request arrives within this
+ * many milliseconds, if no other connection waits for a worker */
+static const int LINGER_MS = 5;
+
+static volatile sig_atomic_t stop_requested = 0;
+/* write end of the pipe the main thread polls, woken by stop signals and
+ * by workers handing back connections */
+static int wake_fd = -1;
+
+static void wake_main()
+{
+	/* a full pipe wakes the main thread as well */
+	ssize_t n = write(wake_fd, "w", 1);
+	(void)n;
+}
+
+static void request_stop(int)
+{
+	int saved = errno;
+	stop_requested = 1;
+	wake_main();
+	errno = saved;
+}
+
+static int set_nonblocking(int fd)
+{
+	int flags = fcntl(fd, F_GETFL);
+	return flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0;
+}
+
+/* Read from fd until buffer holds a line, move it into line without the
+ * newline. Returns 0 on success, 1 on end of connection or error. */
+static int read_line(int fd, std::string &buffer, std::string &line)
+{
+	size_t newline;
+	while ((newline = buffer.find('\n')) == std::string::npos) {
+		if (buffer.size() > 256) {
+			return 1;
+		}
+		char block[4096];
+		ssize_t n = read(fd, block, sizeof(block));
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return 1;
+		}
+		buffer.append(block, n);
+	}
+	line.assign(buffer, 0, newline);
+	buffer.erase(0, newline + 1);
+	return 0;
+}
+
+/* Read len bytes from buffer and fd into out. Returns 0 on success. */
+static int read_bytes(int fd, std::string &buffer, size_t len, std::string &out)
+{
+	if (buffer.size() >= len) {
+		out.assign(buffer, 0, len);
+		buffer.erase(0, len);
+		return 0;
+	}
+	out.swap(buffer);
+	buffer.clear();
+	size_t have = out.size();
+	out.resize(len);
+	while (have < len) {
+		ssize_t n = read(fd, &out[have], len - have);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return 1;
+		}
+		have += n;
+	}
+	return 0;
+}
+
+/* header of a request, see the protocol in server.hpp */
+struct Request {
+	char kind[16];
+	size_t header_len;
+	unsigned long long payload_len;
+	unsigned long long input_len;
+};
+
+/* Parse the request at the start of buffer. Returns 1 if it is complete,
+ * 0 if more bytes are needed and -1 if it is malformed or too large. */
+static int parse_request(const std::string &buffer, Request *request)
+{
+	size_t newline = buffer.find('\n');
+	if (newline == std::string::npos) {
+		return buffer.size() > MAX_HEADER ? -1 : 0;
+	}
+	if (newline > MAX_HEADER) {
+		return -1;
+	}
+	char line[MAX_HEADER + 1];
+	memcpy(line, buffer.data(), newline);
+	line[newline] = '\0';
+	int version = 0;
+	if (sscanf(line, "mpli %d %15s %llu %llu", &version, request->kind,
+		&request->payload_len, &request->input_len) != 4 || version != 1 ||
+		request->payload_len > MAX_REQUEST_SIZE || request->input_len > MAX_REQUEST_SIZE ||
+		request->payload_len + request->input_len > MAX_REQUEST_SIZE ||
+		strcmp(request->kind, "source") != 0) {
+		return -1;
+	}
+	request->header_len = newline + 1;
+	return buffer.size() - request->header_len >=
+		request->payload_len + request->input_len;
+}
+
+/* Append the bytes fd has available to buffer, without blocking. Returns
+ * 0 on success, 1 on end of connection or error. */
+static int receive(int fd, std::string &buffer)
+{
+	char block[16384];
+	for (;;) {
+		ssize_t n = recv(fd, block, sizeof(block), MSG_DONTWAIT);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			return 0;
+		}
+		if (n <= 0) {
+			return 1;
+		}
+		buffer.append(block, n);
+		if (n < (ssize_t)sizeof(block)) {
+			return 0;
+		}
+	}
+}
+
+/* write header and data into fd with one call where possible */
+static int send_message(int fd, const std::string &header, const std::string &data)
+{
+	std::string message;
+	message.reserve(header.size() + data.size());
+	message.append(header);
+	message.append(data);
+	const char *p = message.data();
+	size_t len = message.size();
+	while (len > 0) {
+		ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n < 0) {
+			return 1;
+		}
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int socket_address(const std::string &path, struct sockaddr_un *addr)
+{
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	if (path.size() >= sizeof(addr->sun_path)) {
+		return 1;
+	}
+	memcpy(addr->sun_path, path.c_str(), path.size() + 1);
+	return 0;
+}
+
+Server::Server(const Program::Options &options, int workers)
+{
+	_options = options;
+	_batch_loops = 1;
+	_closed_form_loops = 1;
+	_n_workers = workers < 1 ? 1 : workers;
+	_listen_fd = -1;
+	_stop = 0;
+}
+
+Server::~Server()
+{
+	std::map<std::string, Program*>::iterator it;
+	for (it = _programs.begin(); it != _programs.end(); ++it) {
+		delete it->second;
+	}
+}
+
+void Server::set_loop_batching(int enabled)
+{
+	_batch_loops = enabled;
+}
+
+void Server::set_closed_form_loops(int enabled)
+{
+	_closed_form_loops = enabled;
+}
+
+Program *Server::program(const std::string &source, std::string &errors, int *owned)
+{
+	*owned = 0;
+	{
+		std::unique_lock<std::mutex> l(_programs_lock);
+		std::map<std::string, Program*>::iterator it = _programs.find(source);
+		if (it != _programs.end()) {
+			return it->second;
+		}
+	}
+	/* compile outside the lock, another worker may compile it too */
+	Program *p = Program::compile(source, _options, &errors);
+	if (!p) {
+		return NULL;
+	}
+	std::unique_lock<std::mutex> l(_programs_lock);
+	std::map<std::string, Program*>::iterator it = _programs.find(source);
+	if (it != _programs.end()) {
+		delete p;
+		return it->second;
+	}
+	if (_programs.size() >= MAX_PROGRAMS) {
+		*owned = 1;
+		return p;
+	}
+	_programs[source] = p;
+	return p;
+}
+
+int Server::serve_request(Connection &connection, Context &context)
+{
+	std::string &buffer = connection.buffer;
+	std::string payload, input, output, errors;
+	Request request;
+	if (parse_request(buffer, &request) != 1) {
+		return 1;
+	}
+	payload.assign(buffer, request.header_len, request.payload_len);
+	input.assign(buffer, request.header_len + request.payload_len, request.input_len);
+	buffer.erase(0, request.header_len + request.payload_len + request.input_len);
+
+	int status = BatchRunner::OK;
+	int owned = 0;
+	Program *p = program(payload, errors, &owned);
+	if (!p) {
+		output.swap(errors);
+		status = BatchRunner::COMPILE_ERROR;
+	} else {
+		context.set_output_string(&output);
+		context.set_input_string(input);
+		try {
+			status = context.run(*p) == 0 ? BatchRunner::OK : BatchRunner::RUN_ERROR;
+		} catch (std::exception &e) {
+			status = BatchRunner::EXCEPTION;
+		}
+		context.set_output_string(NULL);
+		if (owned) {
+			delete p;
+		}
+	}
+
+	char header[64];
+	snprintf(header, sizeof(header), "mpli 1 %d %llu\n", status,
+		(unsigned long long)output.size());
+	if (send_message(connection.fd, header, output) != 0) {
+		return 1;
+	}
+	return 0;
+}
+
+int Server::serve_one(Connection &connection, Context &context)
+{
+	/* a request the server cannot handle, e.g. out of memory, costs
+	 * only its connection */
+	try {
+		return serve_request(connection, context);
+	} catch (std::exception &e) {
+		fprintf(stderr, "request failed: %s\n", e.what());
+		return 1;
+	}
+}
+
+void Server::worker_main()
+{
+	Context context;
+	context.set_loop_batching(_batch_loops);
+	context.set_closed_form_loops(_closed_form_loops);
+	for (;;) {
+		Connection *connection;
+		{
+			std::unique_lock<std::mutex> l(_lock);
+			while (_pending.empty() && !_stop) {
+				_wake.wait(l);
+			}
+			if (_stop) {
+				return;
+			}
+			connection = _pending.front();
+			_pending.pop_front();
+			_active.insert(connection->fd);
+		}
+		int closed = serve_one(*connection, context);
+		while (!closed) {
+			{
+				std::unique_lock<std::mutex> l(_lock);
+				if (_stop || !_pending.empty()) {
+					break;
+				}
+			}
+			/* the rest of a request is waited for by the main thread */
+			Request request;
+			int complete = parse_request(connection->buffer, &request);
+			if (complete == 0) {
+				struct pollfd next;
+				next.fd = connection->fd;
+				next.events = POLLIN;
+				if (poll(&next, 1, LINGER_MS) <= 0) {
+					break;
+				}
+				if (receive(connection->fd, connection->buffer) != 0) {
+					closed = 1;
+					break;
+				}
+				complete = parse_request(connection->buffer, &request);
+			}
+			if (complete == 0) {
+				break;
+			}
+			closed = serve_one(*connection, context);
+		}
+		{
+			std::unique_lock<std::mutex> l(_lock);
+			_active.erase(connection->fd);
+			if (!closed && !_stop) {
+				_returned.push_back(connection);
+				connection = NULL;
+			}
+		}
+		if (connection) {
+			close(connection->fd);
+			delete connection;
+		} else {
+			wake_main();
+		}
+	}
+}
+
+int Server::serve(const std::string &path)
+{
+	struct sockaddr_un addr;
+	if (socket_address(path, &addr) != 0) {
+		fprintf(stderr, "Socket path too long: %s\n", path.c_str());
+		return 1;
+	}
+	/* only a socket left behind by an earlier server is replaced */
+	struct stat st;
+	if (lstat(path.c_str(), &st) == 0) {
+		if (!S_ISSOCK(st.st_mode)) {
+			fprintf(stderr, "%s exists and is not a socket\n", path.c_str());
+			return 1;
+		}
+		unlink(path.c_str());
+	}
+	_listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (_listen_fd < 0) {
+		perror("socket");
+		return 1;
+	}
+	/* the socket is created with mode 0600, no other user may connect;
+	 * workers are not started yet, so no thread creates files meanwhile */
+	mode_t old_umask = umask(0177);
+	int bound = bind(_listen_fd, (struct sockaddr*)&addr, sizeof(addr));
+	umask(old_umask);
+	if (bound != 0 || listen(_listen_fd, 128) != 0 || set_nonblocking(_listen_fd) != 0) {
+		perror(path.c_str());
+		close(_listen_fd);
+		return 1;
+	}
+	int wake_pipe[2];
+	if (pipe(wake_pipe) != 0 || set_nonblocking(wake_pipe[0]) != 0 ||
+		set_nonblocking(wake_pipe[1]) != 0) {
+		perror("pipe");
+		close(_listen_fd);
+		unlink(path.c_str());
+		return 1;
+	}
+	wake_fd = wake_pipe[1];
+
+	/* workers never see the stop signals, the main thread polls for them */
+	sigset_t stop_signals, old_mask;
+	sigemptyset(&stop_signals);
+	sigaddset(&stop_signals, SIGINT);
+	sigaddset(&stop_signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &stop_signals, &old_mask);
+	std::vector<std::thread> workers;
+	for (int i=0; i < _n_workers; ++i) {
+		workers.push_back(std::thread(&Server::worker_main, this));
+	}
+	struct sigaction action, old_int, old_term;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = request_stop;
+	sigaction(SIGINT, &action, &old_int);
+	sigaction(SIGTERM, &action, &old_term);
+	stop_requested = 0;
+	pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+
+	/* connections waiting for their next request */
+	std::vector<Connection*> idle, still_idle;
+	std::vector<struct pollfd> fds;
+	/* a signal after this check writes into the pipe, poll() sees it */
+	while (!stop_requested) {
+		fds.resize(2 + idle.size());
+		fds[0].fd = _listen_fd;
+		fds[1].fd = wake_pipe[0];
+		for (size_t i=0; i < idle.size(); ++i) {
+			fds[2 + i].fd = idle[i]->fd;
+		}
+		for (size_t i=0; i < fds.size(); ++i) {
+			fds[i].events = POLLIN;
+			fds[i].revents = 0;
+		}
+		if (poll(&fds[0], fds.size(), -1) < 0) {
+			if (errno != EINTR) {
+				perror("poll");
+				break;
+			}
+			continue;
+		}
+		if (fds[1].revents) {
+			char drain[64];
+			while (read(wake_pipe[0], drain, sizeof(drain)) > 0) {
+			}
+		}
+
+		/* connections go to a worker only with a complete request, so
+		 * a client that stops in the middle of one holds no worker */
+		Request request;
+		std::unique_lock<std::mutex> l(_lock);
+		still_idle.clear();
+		for (size_t i=0; i < idle.size(); ++i) {
+			Connection *connection = idle[i];
+			int ended = fds[2 + i].revents && receive(connection->fd, connection->buffer) != 0;
+			int complete = parse_request(connection->buffer, &request);
+			if (complete == 1) {
+				_pending.push_back(connection);
+				_wake.notify_one();
+			} else if (ended || complete < 0) {
+				close(connection->fd);
+				delete connection;
+			} else {
+				still_idle.push_back(connection);
+			}
+		}
+		idle.swap(still_idle);
+		for (size_t i=0; i < _returned.size(); ++i) {
+			/* a pipelined request is already buffered, poll() would
+			 * not report it */
+			int complete = parse_request(_returned[i]->buffer, &request);
+			if (complete == 1) {
+				_pending.push_back(_returned[i]);
+				_wake.notify_one();
+			} else if (complete < 0) {
+				close(_returned[i]->fd);
+				delete _returned[i];
+			} else {
+				idle.push_back(_returned[i]);
+			}
+		}
+		_returned.clear();
+		l.unlock();
+
+		if (fds[0].revents) {
+			int fd = accept(_listen_fd, NULL, NULL);
+			if (fd >= 0) {
+				struct timeval timeout;
+				timeout.tv_sec = SEND_TIMEOUT_S;
+				timeout.tv_usec = 0;
+				setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+				Connection *connection = new Connection;
+				connection->fd = fd;
+				idle.push_back(connection);
+			} else if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK &&
+				errno != ECONNABORTED) {
+				perror("accept");
+				break;
+			}
+		}
+	}
+
+	{
+		std::unique_lock<std::mutex> l(_lock);
+		_stop = 1;
+		std::set<int>::iterator it;
+		for (it = _active.begin(); it != _active.end(); ++it) {
+			shutdown(*it, SHUT_RDWR);
+		}
+	}
+	_wake.notify_all();
+	for (size_t i=0; i < workers.size(); ++i) {
+		workers[i].join();
+	}
+	/* workers are done, the remaining connections are not served */
+	idle.insert(idle.end(), _pending.begin(), _pending.end());
+	idle.insert(idle.end(), _returned.begin(), _returned.end());
+	_pending.clear();
+	_returned.clear();
+	for (size_t i=0; i < idle.size(); ++i) {
+		close(idle[i]->fd);
+		delete idle[i];
+	}
+	sigaction(SIGINT, &old_int, NULL);
+	sigaction(SIGTERM, &old_term, NULL);
+	wake_fd = -1;
+	close(wake_pipe[0]);
+	close(wake_pipe[1]);
+	close(_listen_fd);
+	unlink(path.c_str());
+	return 0;
+}
+
+Client::Client()
+{
+	_fd = -1;
+}
+
+Client::~Client()
+{
+	if (_fd >= 0) {
+		close(_fd);
+	}
+}
+
+int Client::connect(const std::string &path)
+{
+	struct sockaddr_un addr;
+	if (_fd >= 0 || socket_address(path, &addr) != 0) {
+		return 1;
+	}
+	_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (_fd < 0) {
+		return 1;
+	}
+	if (::connect(_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+		close(_fd);
+		_fd = -1;
+		return 1;
+	}
+	return 0;
+}
+
+int Client::run(const std::string &source, const std::string &input, std::string &output)
+{
+	if (_fd < 0) {
+		return -1;
+	}
+	char header[96];
+	snprintf(header, sizeof(header), "mpli 1 source %llu %llu\n",
+		(unsigned long long)source.size(), (unsigned long long)input.size());
+	std::string data;
+	data.reserve(source.size() + input.size());
+	data.append(source);
+	data.append(input);
+	if (send_message(_fd, header, data) != 0) {
+		return -1;
+	}
+
+	std::string line;
+	int version = 0, status = 0;
+	unsigned long long output_len = 0;
+	if (read_line(_fd, _buffer, line) != 0 ||
+		sscanf(line.c_str(), "mpli %d %d %llu", &version, &status, &output_len) != 3 ||
+		version != 1 || output_len > MAX_REQUEST_SIZE ||
+		read_bytes(_fd, _buffer, output_len, output) != 0) {
+		return -1;
+	}
+	return status;
+}
+
+} // namespace mpli
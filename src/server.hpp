@@ -0,0 +1,125 @@
+#ifndef MPLI_SERVER_HPP_
+#define MPLI_SERVER_HPP_
+
+#include "program.hpp"
+#include "batch_runner.hpp"
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace mpli {
+
+/*
+ * Protocol of --serve, over a Unix domain stream socket. A connection
+ * carries any number of requests, each answered before the next is read:
+ *
+ *   request:  "mpli 1 source <length> <input length>\n" followed by the
+ *             source and then the input of read statements
+ *   response: "mpli 1 <status> <output length>\n" followed by output
+ *
+ * Status is one of BatchRunner::STATUS.
+ *
+ * Trust model: whoever can connect runs programs as the server user, with
+ * its CPU and memory. The socket is created with mode 0600, so only that
+ * user may connect, unless its permissions are changed afterwards. Programs
+ * come with the request and are never read from files on the server side,
+ * and Mini-PL programs have no access to files.
+ */
+
+/*
+ * Server keeping compiled programs warm. Requests are served by a fixed
+ * number of worker threads, each with a reusable Context. The main thread
+ * polls connections and receives requests; a connection goes to a worker
+ * only once a whole request has arrived, and is handed back after it is
+ * answered. Idle connections and partly sent requests hold no worker, and
+ * a client that does not take its response is dropped after a timeout.
+ */
+class Server {
+public:
+	/* at most this many compiled programs are kept */
+	static const int MAX_PROGRAMS = 1024;
+
+private:
+	struct Connection {
+		int fd;
+		/* received bytes of the next requests */
+		std::string buffer;
+	};
+
+	Program::Options _options;
+	int _batch_loops;
+	int _closed_form_loops;
+	int _n_workers;
+	int _listen_fd;
+
+	/* connections with a request waiting for a worker */
+	std::mutex _lock;
+	std::condition_variable _wake;
+	std::deque<Connection*> _pending;
+	/* connections handed back by workers, polled again by the main thread */
+	std::vector<Connection*> _returned;
+	/* connections being served, shut down on stop */
+	std::set<int> _active;
+	int _stop;
+
+	/* programs by source, never deleted before the server */
+	std::mutex _programs_lock;
+	std::map<std::string, Program*> _programs;
+
+	void worker_main();
+	/* Serve one request of connection. Returns 0 if the connection stays
+	 * open for more requests, 1 if it is closed or broken. */
+	int serve_request(Connection &connection, Context &context);
+	/* serve_request(), closing the connection if it throws */
+	int serve_one(Connection &connection, Context &context);
+	/* compiled program for source, NULL with errors if it does not
+	 * compile; *owned is set when caller must delete the program */
+	Program *program(const std::string &source, std::string &errors, int *owned);
+
+	Server(const Server&);
+	Server &operator=(const Server&);
+
+public:
+	Server(const Program::Options &options, int workers);
+	~Server();
+
+	/* see Interpreter */
+	void set_loop_batching(int enabled);
+	void set_closed_form_loops(int enabled);
+
+	/* Listen on socket path until SIGINT or SIGTERM. A socket left at
+	 * path by an earlier server is replaced, any other file is not.
+	 * Returns 0 on normal stop, 1 if socket cannot be set up. */
+	int serve(const std::string &path);
+};
+
+/*
+ * Client side of the protocol.
+ */
+class Client {
+private:
+	int _fd;
+	/* received bytes not consumed yet */
+	std::string _buffer;
+
+	Client(const Client&);
+	Client &operator=(const Client&);
+
+public:
+	Client();
+	~Client();
+
+	/* Connect to server socket path. Returns 0 on success. */
+	int connect(const std::string &path);
+	/* Run source with given input. Returns status of BatchRunner::STATUS,
+	 * -1 if the connection failed. */
+	int run(const std::string &source, const std::string &input, std::string &output);
+};
+
+} // namespace mpli
+#endif // MPLI_SERVER_HPP_
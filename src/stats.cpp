@@ -0,0 +1,249 @@
+#include "stats.hpp"
+
+#include <cstdio>
+#include <ctime>
+#include <atomic>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+namespace mpli {
+
+static std::atomic<bool> counting_allocations(false);
+static std::atomic<unsigned long long> allocated_bytes(0);
+static std::atomic<unsigned long long> allocations(0);
+static const PerfCounters *perf_counters = NULL;
+static std::atomic<int> current_tag(0);
+static std::atomic<unsigned long long> tag_bytes[Stats::MAX_ALLOCATION_TAGS];
+static std::atomic<unsigned long long> tag_allocations[Stats::MAX_ALLOCATION_TAGS];
+
+Stats::Sample::Sample()
+{
+	wall_ms = 0;
+	cpu_ms = 0;
+	allocated_bytes = 0;
+	allocations = 0;
+	for (int i=0; i < PerfCounters::N_EVENTS; ++i) {
+		events[i] = 0;
+	}
+}
+
+Stats::Sample &Stats::Sample::operator+=(const Sample &other)
+{
+	wall_ms += other.wall_ms;
+	cpu_ms += other.cpu_ms;
+	allocated_bytes += other.allocated_bytes;
+	allocations += other.allocations;
+	for (int i=0; i < PerfCounters::N_EVENTS; ++i) {
+		events[i] += other.events[i];
+	}
+	return *this;
+}
+
+Stats::Sample Stats::Sample::operator-(const Sample &other) const
+{
+	Sample s;
+	s.wall_ms = wall_ms - other.wall_ms;
+	s.cpu_ms = cpu_ms - other.cpu_ms;
+	s.allocated_bytes = allocated_bytes - other.allocated_bytes;
+	s.allocations = allocations - other.allocations;
+	for (int i=0; i < PerfCounters::N_EVENTS; ++i) {
+		s.events[i] = events[i] - other.events[i];
+	}
+	return s;
+}
+
+static double clock_ms(clockid_t clock)
+{
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static long peak_rss_kb()
+{
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return 0;
+	}
+	/* kilobytes on Linux */
+	return usage.ru_maxrss;
+}
+
+Stats::Sample Stats::now()
+{
+	Sample s;
+	s.wall_ms = clock_ms(CLOCK_MONOTONIC);
+	s.cpu_ms = clock_ms(CLOCK_PROCESS_CPUTIME_ID);
+	s.allocated_bytes = mpli::allocated_bytes.load(std::memory_order_relaxed);
+	s.allocations = mpli::allocations.load(std::memory_order_relaxed);
+	if (perf_counters) {
+		perf_counters->read(s.events);
+	}
+	return s;
+}
+
+void Stats::use_perf_counters(const PerfCounters *counters)
+{
+	perf_counters = counters;
+}
+
+/* is event reported */
+static int reported(int event)
+{
+	return perf_counters && perf_counters->available((PerfCounters::EVENT)event);
+}
+
+void Stats::begin(const std::string &name)
+{
+	end();
+	_current = name;
+	_start = now();
+}
+
+void Stats::end()
+{
+	if (_current.empty()) {
+		return;
+	}
+	Phase p;
+	p.name = _current;
+	p.sample = now() - _start;
+	p.peak_rss_kb = peak_rss_kb();
+	_phases.push_back(p);
+	_current.clear();
+}
+
+void Stats::split(const std::string &phase, const std::string &part, const Sample &part_sample)
+{
+	for (size_t i=0; i < _phases.size(); ++i) {
+		if (_phases[i].name == phase) {
+			Phase p = _phases[i];
+			p.name = part;
+			p.sample = part_sample;
+			_phases[i].sample = _phases[i].sample - part_sample;
+			_phases.insert(_phases.begin() + i, p);
+			return;
+		}
+	}
+}
+
+void Stats::set_counter(const std::string &name, unsigned long long value)
+{
+	for (size_t i=0; i < _counters.size(); ++i) {
+		if (_counters[i].first == name) {
+			_counters[i].second = value;
+			return;
+		}
+	}
+	_counters.push_back(std::make_pair(name, value));
+}
+
+void Stats::report_text(std::string &out) const
+{
+	char line[256];
+	snprintf(line, sizeof(line), "%-12s %12s %12s %16s %12s %12s", "phase", "wall ms",
+		"cpu ms", "allocated", "allocs", "peak rss kB");
+	out.append(line);
+	for (int e=0; e < PerfCounters::N_EVENTS; ++e) {
+		if (reported(e)) {
+			snprintf(line, sizeof(line), " %16s", PerfCounters::name((PerfCounters::EVENT)e));
+			out.append(line);
+		}
+	}
+	out.append("\n");
+	Sample total;
+	for (size_t i=0; i <= _phases.size(); ++i) {
+		if (i < _phases.size()) {
+			const Phase &p = _phases[i];
+			snprintf(line, sizeof(line), "%-12s %12.3f %12.3f %16llu %12llu %12ld",
+				p.name.c_str(), p.sample.wall_ms, p.sample.cpu_ms, p.sample.allocated_bytes,
+				p.sample.allocations, p.peak_rss_kb);
+			total += p.sample;
+		} else {
+			snprintf(line, sizeof(line), "%-12s %12.3f %12.3f %16llu %12llu %12s", "total",
+				total.wall_ms, total.cpu_ms, total.allocated_bytes, total.allocations, "");
+		}
+		out.append(line);
+		const Sample &s = (i < _phases.size() ? _phases[i].sample : total);
+		for (int e=0; e < PerfCounters::N_EVENTS; ++e) {
+			if (reported(e)) {
+				snprintf(line, sizeof(line), " %16llu", s.events[e]);
+				out.append(line);
+			}
+		}
+		out.append("\n");
+	}
+	for (size_t i=0; i < _counters.size(); ++i) {
+		snprintf(line, sizeof(line), "%-24s %llu\n", _counters[i].first.c_str(),
+			_counters[i].second);
+		out.append(line);
+	}
+}
+
+void Stats::report_json(std::string &out) const
+{
+	char buf[512];
+	snprintf(buf, sizeof(buf), "{\"schema\": \"mpli-stats\", \"version\": %d,\n \"phases\": [",
+		SCHEMA_VERSION);
+	out.append(buf);
+	for (size_t i=0; i < _phases.size(); ++i) {
+		const Phase &p = _phases[i];
+		/* phase and counter names are plain identifiers, no escaping */
+		snprintf(buf, sizeof(buf), "%s\n  {\"name\": \"%s\", \"wall_ms\": %.3f, \"cpu_ms\": %.3f, "
+			"\"allocated_bytes\": %llu, \"allocations\": %llu, \"peak_rss_kb\": %ld",
+			i > 0 ? "," : "", p.name.c_str(), p.sample.wall_ms, p.sample.cpu_ms,
+			p.sample.allocated_bytes, p.sample.allocations, p.peak_rss_kb);
+		out.append(buf);
+		for (int e=0; e < PerfCounters::N_EVENTS; ++e) {
+			if (reported(e)) {
+				snprintf(buf, sizeof(buf), ", \"%s\": %llu",
+					PerfCounters::name((PerfCounters::EVENT)e), p.sample.events[e]);
+				out.append(buf);
+			}
+		}
+		out.append("}");
+	}
+	out.append("],\n \"counters\": {");
+	for (size_t i=0; i < _counters.size(); ++i) {
+		snprintf(buf, sizeof(buf), "%s\"%s\": %llu", i > 0 ? ", " : "",
+			_counters[i].first.c_str(), _counters[i].second);
+		out.append(buf);
+	}
+	out.append("}}\n");
+}
+
+void Stats::enable_allocation_counting()
+{
+	counting_allocations.store(true, std::memory_order_relaxed);
+}
+
+void Stats::count_allocation(size_t size)
+{
+	if (counting_allocations.load(std::memory_order_relaxed)) {
+		allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		int tag = current_tag.load(std::memory_order_relaxed);
+		tag_bytes[tag].fetch_add(size, std::memory_order_relaxed);
+		tag_allocations[tag].fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void Stats::set_allocation_tag(int tag)
+{
+	if (tag >= 0 && tag < MAX_ALLOCATION_TAGS) {
+		current_tag.store(tag, std::memory_order_relaxed);
+	}
+}
+
+int Stats::allocation_tag()
+{
+	return current_tag.load(std::memory_order_relaxed);
+}
+
+void Stats::tagged_allocations(int tag, unsigned long long *bytes, unsigned long long *count)
+{
+	*bytes = tag_bytes[tag].load(std::memory_order_relaxed);
+	*count = tag_allocations[tag].load(std::memory_order_relaxed);
+}
+
+} // namespace mpli
@@ -0,0 +1,93 @@
+#ifndef MPLI_STATS_HPP_
+#define MPLI_STATS_HPP_
+
+#include "perf_counters.hpp"
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+namespace mpli {
+
+/*
+ * Per phase statistics of a run: wall and CPU time, allocations and peak
+ * RSS, hardware counters if enabled, plus named counters. Reported as text
+ * or as JSON:
+ *
+ *   {"schema": "mpli-stats", "version": 1,
+ *    "phases": [{"name": ..., "wall_ms": ..., "cpu_ms": ...,
+ *                "allocated_bytes": ..., "allocations": ...,
+ *                "peak_rss_kb": ..., "instructions": ..., ...}, ...],
+ *    "counters": {"tokens": ..., ...}}
+ *
+ * Fields are only ever added, any other change bumps version.
+ */
+class Stats {
+public:
+	static const int SCHEMA_VERSION = 1;
+
+	/* point in time, or difference of two */
+	struct Sample {
+		double wall_ms;
+		double cpu_ms;
+		unsigned long long allocated_bytes;
+		unsigned long long allocations;
+		/* by PerfCounters::EVENT, 0 without hardware counters */
+		unsigned long long events[PerfCounters::N_EVENTS];
+
+		Sample();
+		Sample &operator+=(const Sample &other);
+		Sample operator-(const Sample &other) const;
+	};
+
+	struct Phase {
+		std::string name;
+		Sample sample;
+		/* peak RSS of the process at the end of phase */
+		long peak_rss_kb;
+	};
+
+private:
+	std::vector<Phase> _phases;
+	std::vector<std::pair<std::string, unsigned long long> > _counters;
+	/* phase started by begin(), if any */
+	std::string _current;
+	Sample _start;
+
+public:
+	/* current wall and CPU time of process, allocations and hardware
+	 * counters so far */
+	static Sample now();
+	/* Read hardware counters into samples, NULL to stop. Counters are
+	 * reported if at least one of them is available. */
+	static void use_perf_counters(const PerfCounters *counters);
+
+	/* start phase, ending the current one */
+	void begin(const std::string &name);
+	/* end current phase */
+	void end();
+	/* Move part of phase, measured separately, into a phase of its own
+	 * before it. */
+	void split(const std::string &phase, const std::string &part, const Sample &part_sample);
+	/* set counter, adding it if it is not there yet */
+	void set_counter(const std::string &name, unsigned long long value);
+
+	void report_text(std::string &out) const;
+	void report_json(std::string &out) const;
+
+	/* Allocation accounting, fed by operator new of alloc_hooks.cpp.
+	 * Counting is off until enabled. */
+	static void enable_allocation_counting();
+	static void count_allocation(size_t size);
+
+	/* Allocations are also counted per tag, e.g. per kind of statement
+	 * being executed. Tag 0 means untagged. */
+	static const int MAX_ALLOCATION_TAGS = 16;
+	static void set_allocation_tag(int tag);
+	static int allocation_tag();
+	/* allocations counted under tag so far */
+	static void tagged_allocations(int tag, unsigned long long *bytes, unsigned long long *count);
+};
+
+} // namespace mpli
+#endif // MPLI_STATS_HPP_
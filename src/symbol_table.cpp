@@ -2,27 +2,113 @@
 
 namespace mpli {
 
-void SymbolTable::push(std::string key, Symbol symbol)
+unsigned int Identifiers::hash(const char *name, size_t length)
 {
-	_symbols[key] = symbol;
+	/* FNV-1a */
+	unsigned int h = 2166136261u;
+	for (size_t i=0; i < length; ++i) {
+		h ^= (unsigned char)name[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+void Identifiers::grow()
+{
+	size_t capacity = _slots.empty() ? 64 : 2 * _slots.size();
+	_slots.assign(capacity, -1);
+	for (size_t id=0; id < _names.size(); ++id) {
+		size_t slot = _hashes[id] & (capacity - 1);
+		while (_slots[slot] >= 0) {
+			slot = (slot + 1) & (capacity - 1);
+		}
+		_slots[slot] = id;
+	}
+}
+
+int Identifiers::intern(const std::string &name, unsigned int hash)
+{
+	int id = find(name, hash);
+	if (id >= 0) {
+		return id;
+	}
+	if (2 * (_names.size() + 1) > _slots.size()) {
+		grow();
+	}
+	id = _names.size();
+	_names.push_back(name);
+	_hashes.push_back(hash);
+	size_t slot = hash & (_slots.size() - 1);
+	while (_slots[slot] >= 0) {
+		slot = (slot + 1) & (_slots.size() - 1);
+	}
+	_slots[slot] = id;
+	return id;
+}
+
+int Identifiers::intern(const std::string &name)
+{
+	return intern(name, hash(name.data(), name.size()));
+}
+
+int Identifiers::find(const std::string &name, unsigned int hash) const
+{
+	if (_slots.empty()) {
+		return -1;
+	}
+	size_t slot = hash & (_slots.size() - 1);
+	for (int id = _slots[slot]; id >= 0; id = _slots[slot]) {
+		if (_hashes[id] == hash && _names[id] == name) {
+			return id;
+		}
+		slot = (slot + 1) & (_slots.size() - 1);
+	}
+	return -1;
+}
+
+const std::string &Identifiers::name(int id) const
+{
+	return _names[id];
 }
 
-void SymbolTable::pop(std::string key)
+int Identifiers::size() const
 {
-	_symbols.erase(key);
+	return _names.size();
 }
 
-Symbol SymbolTable::find(std::string key)
+void Identifiers::clear()
 {
-	std::map<std::string, Symbol>::iterator it;
-	it = _symbols.find(key);
-	if (it == _symbols.end()) {
+	_names.clear();
+	_hashes.clear();
+	_slots.clear();
+}
+
+void SymbolTable::push(int id, const Symbol &symbol)
+{
+	if (id < 0) {
+		return;
+	}
+	if (id >= (int)_symbols.size()) {
 		Symbol s;
 		s.type = Symbol::UNDEFINED;
-		return s;
+		s.location = 0;
+		_symbols.resize(id + 1, s);
+	}
+	_symbols[id] = symbol;
+}
+
+void SymbolTable::pop(int id)
+{
+	if (id >= 0 && id < (int)_symbols.size()) {
+		_symbols[id].type = Symbol::UNDEFINED;
+	}
+}
+
+void SymbolTable::clear()
+{
+	for (size_t i=0; i < _symbols.size(); ++i) {
+		_symbols[i].type = Symbol::UNDEFINED;
 	}
-	Symbol s = (*it).second;
-	return s;
 }
 
 } // namespace mpli
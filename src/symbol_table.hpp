@@ -1,8 +1,9 @@
 #ifndef MPLI_SYMBOL_TABLE_HPP_
 #define MPLI_SYMBOL_TABLE_HPP_
 
-#include <map>
+#include <vector>
 #include <string>
+#include <cstddef>
 
 namespace mpli {
 
@@ -16,24 +17,67 @@ struct Symbol {
 
 	TYPE type;
 	/* location in interpreter's <type>_values vector */
-	int location;	
+	int location;
 };
 
-/* 
- * Symbol table that is used by AST and Interpreter.
+/*
+ * Interned identifiers: every distinct name gets a small id, 0, 1, 2...
+ * in order of first appearance. Names are found in an open addressing
+ * table by their hash, which the scanner computes once per token.
+ */
+class Identifiers {
+private:
+	std::vector<std::string> _names;
+	std::vector<unsigned int> _hashes;
+	/* ids by hash, -1 if empty, size is a power of two at most half full */
+	std::vector<int> _slots;
+
+	void grow();
+public:
+	/* hash of name, as stored in Token::hash */
+	static unsigned int hash(const char *name, size_t length);
+
+	/* id of name, a new one if it was not seen before */
+	int intern(const std::string &name, unsigned int hash);
+	int intern(const std::string &name);
+	/* id of name, -1 if it was not interned */
+	int find(const std::string &name, unsigned int hash) const;
+	/* name of given id */
+	const std::string &name(int id) const;
+	/* number of ids */
+	int size() const;
+	void clear();
+};
+
+/*
+ * Symbol table that is used by AST and Interpreter. Symbols are looked up
+ * by interned identifier id (ASTNode::symbol); ids are dense, so the table
+ * is indexed by them directly and lookups neither hash nor allocate.
  */
 class SymbolTable {
 private:
-	std::map<std::string, Symbol> _symbols;
+	/* symbol of every id, UNDEFINED if not pushed */
+	std::vector<Symbol> _symbols;
 public:
 	/* push symbol into symbol table */
-	void push(std::string key, Symbol symbol);
+	void push(int id, const Symbol &symbol);
 	/* remove symbol from symbol table */
-	void pop(std::string key);
+	void pop(int id);
 	/* Find symbol from symbol table.
 	 * Returns a symbol with type UNDEFINED if not found.
 	 */
-	Symbol find(std::string key);
+	inline Symbol find(int id) const
+	{
+		if (id >= 0 && id < (int)_symbols.size()) {
+			return _symbols[id];
+		}
+		Symbol s;
+		s.type = Symbol::UNDEFINED;
+		s.location = 0;
+		return s;
+	}
+	/* remove all symbols, keeping the memory for the next run */
+	void clear();
 };
 
 } // namespace mpli
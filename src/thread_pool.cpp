@@ -0,0 +1,133 @@
+#include "thread_pool.hpp"
+
+namespace mpli {
+
+ThreadPool::ThreadPool(int size)
+{
+	_size = size < 1 ? 1 : size;
+	_generation = 0;
+	_busy = 0;
+	_stop = 0;
+	_function = NULL;
+	_context = NULL;
+	for (int i=0; i < _size; ++i) {
+		_queues.push_back(new WorkerQueue);
+		_queues.back()->head = 0;
+	}
+	for (int i=1; i < _size; ++i) {
+		_threads.push_back(std::thread(&ThreadPool::worker_main, this, i));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::unique_lock<std::mutex> l(_lock);
+		_stop = 1;
+	}
+	_wake.notify_all();
+	for (size_t i=0; i < _threads.size(); ++i) {
+		_threads[i].join();
+	}
+	for (size_t i=0; i < _queues.size(); ++i) {
+		delete _queues[i];
+	}
+}
+
+int ThreadPool::size()
+{
+	return _size;
+}
+
+void ThreadPool::run(int n_tasks, TaskFunction function, void *context)
+{
+	if (n_tasks <= 0) {
+		return;
+	}
+
+	/* contiguous blocks keep neighbouring tasks on one worker */
+	for (int w=0; w < _size; ++w) {
+		int first = (int)((long long)n_tasks * w / _size);
+		int last = (int)((long long)n_tasks * (w + 1) / _size);
+		std::unique_lock<std::mutex> ql(_queues[w]->lock);
+		_queues[w]->tasks.clear();
+		_queues[w]->head = 0;
+		for (int t=first; t < last; ++t) {
+			_queues[w]->tasks.push_back(t);
+		}
+	}
+
+	{
+		std::unique_lock<std::mutex> l(_lock);
+		_function = function;
+		_context = context;
+		_busy = _size;
+		++_generation;
+	}
+	_wake.notify_all();
+
+	work(0);
+
+	std::unique_lock<std::mutex> l(_lock);
+	--_busy;
+	while (_busy > 0) {
+		_done.wait(l);
+	}
+}
+
+void ThreadPool::worker_main(int worker)
+{
+	unsigned int seen = 0;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> l(_lock);
+			while (!_stop && _generation == seen) {
+				_wake.wait(l);
+			}
+			if (_stop) {
+				return;
+			}
+			seen = _generation;
+		}
+
+		work(worker);
+
+		std::unique_lock<std::mutex> l(_lock);
+		if (--_busy == 0) {
+			_done.notify_all();
+		}
+	}
+}
+
+void ThreadPool::work(int worker)
+{
+	int task;
+	while (next_task(worker, &task)) {
+		_function(_context, task, worker);
+	}
+}
+
+int ThreadPool::next_task(int worker, int *task)
+{
+	{
+		WorkerQueue *own = _queues[worker];
+		std::unique_lock<std::mutex> ql(own->lock);
+		if (own->head < own->tasks.size()) {
+			*task = own->tasks[own->head++];
+			return 1;
+		}
+	}
+	/* steal from the back of the others, starting from the next worker */
+	for (int i=1; i < _size; ++i) {
+		WorkerQueue *victim = _queues[(worker + i) % _size];
+		std::unique_lock<std::mutex> ql(victim->lock);
+		if (victim->head < victim->tasks.size()) {
+			*task = victim->tasks.back();
+			victim->tasks.pop_back();
+			return 1;
+		}
+	}
+	return 0;
+}
+
+} // namespace mpli
@@ -0,0 +1,66 @@
+#ifndef MPLI_THREAD_POOL_HPP_
+#define MPLI_THREAD_POOL_HPP_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace mpli {
+
+/*
+ * Work-stealing thread pool. Tasks of one run() are spread over per-worker
+ * queues in contiguous blocks, a worker takes tasks from the front of its
+ * own queue and steals from the back of the others when it runs out.
+ * The calling thread works as worker 0.
+ */
+class ThreadPool {
+public:
+	/* task function: context given to run(), task index, worker index */
+	typedef void (*TaskFunction)(void *context, int task, int worker);
+
+private:
+	/* Tasks are only added by run() before workers start, so a vector
+	 * taken from both ends keeps its capacity and run() does not
+	 * allocate once it has seen its largest task count. */
+	struct WorkerQueue {
+		std::mutex lock;
+		std::vector<int> tasks;
+		/* tasks before head are taken */
+		size_t head;
+	};
+
+	int _size;
+	std::vector<WorkerQueue*> _queues;
+	std::vector<std::thread> _threads;
+
+	std::mutex _lock;
+	std::condition_variable _wake;
+	std::condition_variable _done;
+	/* incremented for every run(), workers wait for a new generation */
+	unsigned int _generation;
+	/* workers still taking part in current run */
+	int _busy;
+	int _stop;
+
+	TaskFunction _function;
+	void *_context;
+
+	void worker_main(int worker);
+	/* run tasks until all queues are empty */
+	void work(int worker);
+	/* take own task or steal one, returns 0 when there is nothing left */
+	int next_task(int worker, int *task);
+
+public:
+	/* size is the total number of workers, including the calling thread */
+	ThreadPool(int size);
+	~ThreadPool();
+
+	int size();
+	/* Run tasks 0..n_tasks-1 and wait until all of them are done. */
+	void run(int n_tasks, TaskFunction function, void *context);
+};
+
+} // namespace mpli
+#endif // MPLI_THREAD_POOL_HPP_
@@ -17,9 +17,14 @@ struct Token {
 
     TYPE type;
     std::string str;
+    /* position of first character in source, from 1, 0 if unknown */
+    int line;
+    int column;
+    /* if type == IDENTIFIER: Identifiers::hash of str, 0 otherwise */
+    unsigned int hash;
 
-    Token(TYPE t, std::string s) : type(t), str(s) { }
-    Token() { type = ERROR; str = ""; }
+    Token(TYPE t, std::string s) : type(t), str(s) { line = 0; column = 0; hash = 0; }
+    Token() { type = ERROR; str = ""; line = 0; column = 0; hash = 0; }
 
 	std::string type_str()
 	{
@@ -0,0 +1,90 @@
+/*
+ * Checks of statements that report errors, run through the embedding API
+ * on the AST interpreter and on the IR backend, which must agree. A
+ * reported error stops the program, also in its last statement and in the
+ * last statement of a loop's last iteration.
+ *
+ *   errors_test
+ *
+ * Exits with 1 and names the failed check on stderr.
+ */
+#include "mpli.hpp"
+
+#include <cstdio>
+#include <string>
+
+/* Run source with input on the AST interpreter, or on the IR backend at
+ * opt_level. Returns the result of Context::run, -1 if it does not
+ * compile. */
+static int run(const std::string &source, const std::string &input, int opt_level,
+	std::string &output)
+{
+	mpli::Program::Options options;
+	options.opt_level = opt_level;
+	std::string errors;
+	mpli::Program *program = mpli::Program::compile(source, options, &errors);
+	if (!program) {
+		fprintf(stderr, "compile errors:\n%s", errors.c_str());
+		return -1;
+	}
+	mpli::Context context;
+	context.set_output_string(&output);
+	context.set_input_string(input);
+	int r = context.run(*program);
+	delete program;
+	return r;
+}
+
+/* Check that source stops with an error, and that its output ends with
+ * expect_end, on both backends. */
+static int check(const char *name, const std::string &source, const std::string &input,
+	const std::string &expect_end)
+{
+	int opt_levels[] = { -1, 2 };
+	int failed = 0;
+	for (size_t i=0; i < sizeof(opt_levels) / sizeof(opt_levels[0]); ++i) {
+		std::string output;
+		int r = run(source, input, opt_levels[i], output);
+		if (r != 1 || output.size() < expect_end.size() ||
+			output.compare(output.size() - expect_end.size(), expect_end.size(), expect_end) != 0) {
+			fprintf(stderr, "%s at opt level %d: returned %d, output \"%s\"\n", name,
+				opt_levels[i], r, output.c_str());
+			failed = 1;
+		}
+	}
+	return failed;
+}
+
+int main()
+{
+	int failed = 0;
+	failed |= check("error in last statement",
+		"var n : int;\n"
+		"print \"start\";\n"
+		"read n;\n",
+		"x", "Invalid integer input 'x' for n.\n");
+	/* the message of the read is the last output, "after" must not follow */
+	failed |= check("error in last iteration",
+		"var i : int;\n"
+		"var n : int;\n"
+		"for i in 1..2 do\n"
+		"  read n;\n"
+		"end for;\n"
+		"print \"after\";\n",
+		"1 x", "Invalid integer input 'x' for n.\n");
+	failed |= check("error in nested loop",
+		"var i : int;\n"
+		"var j : int;\n"
+		"var n : int;\n"
+		"for i in 1..2 do\n"
+		"  for j in 1..2 do\n"
+		"    read n;\n"
+		"  end for;\n"
+		"  print i;\n"
+		"end for;\n",
+		"1 x", "Invalid integer input 'x' for n.\n");
+	if (!failed) {
+		printf("ok\n");
+	}
+	return failed;
+}
@@ -0,0 +1,72 @@
+/*
+ * Checks of print statements, run through the embedding API. A print
+ * statement whose expression fails must not output any part of it.
+ *
+ *   print_test
+ *
+ * Exits with 1 and names the failed check on stderr.
+ */
+#include "mpli.hpp"
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+/* Run source with every write flushed at once, into output. Returns 0 if
+ * it ran, 1 if it threw. */
+static int run(const std::string &source, std::string &output)
+{
+	mpli::Program::Options options;
+	std::string errors;
+	mpli::Program *program = mpli::Program::compile(source, options, &errors);
+	if (!program) {
+		fprintf(stderr, "compile errors:\n%s", errors.c_str());
+		return 2;
+	}
+	mpli::Context context;
+	context.set_output_string(&output);
+	context.set_flush_policy(mpli::OutputBuffer::FLUSH_ON_SIZE, 1);
+	int r = 0;
+	try {
+		context.run(*program);
+	} catch (std::invalid_argument &e) {
+		r = 1;
+	}
+	delete program;
+	return r;
+}
+
+static int check(const char *name, const std::string &source, int throws,
+	const std::string &expect)
+{
+	std::string output;
+	int r = run(source, output);
+	if (r != throws || output != expect) {
+		fprintf(stderr, "%s: %s, output \"%s\", expected \"%s\"\n", name,
+			r == 2 ? "does not compile" : r ? "threw" : "did not throw",
+			output.c_str(), expect.c_str());
+		return 1;
+	}
+	return 0;
+}
+
+int main()
+{
+	const char *declarations =
+		"var a : int := 2;\n"
+		"var s : string := \"x\";\n";
+	int failed = 0;
+	failed |= check("concatenation",
+		std::string(declarations) + "print (\"abc\" + s) + a;\n", 0, "abcx2");
+	/* (a - 1) is not valid in a string expression and throws after
+	 * "abc" and s are evaluated */
+	failed |= check("failing operand",
+		std::string(declarations) + "print \"before\";\n"
+		"print (\"abc\" + s) + (a - 1);\n", 1, "before");
+	failed |= check("failing operand first",
+		std::string(declarations) + "print ((a - 1) + \"abc\") + s;\n", 1, "");
+	if (!failed) {
+		printf("ok\n");
+	}
+	return failed;
+}